@@ -0,0 +1,122 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// benchmarks/crossfeed_benchmark.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/utility.hpp>
+#include <amp/numeric.hpp>
+#include <amp/range.hpp>
+#include <amp/stddef.hpp>
+
+#include "filter/crossfeed_kernel.hpp"
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+
+using namespace ::amp;
+
+
+namespace {
+
+constexpr auto frames = 4096_sz;
+constexpr uint32 rate = 44100;
+
+// The crossfeed as it was: one frame at a time, in double precision.
+class scalar_crossfeed
+{
+public:
+    scalar_crossfeed()
+    {
+        auto const level = 4.5;
+        auto const GB_lo = level * -5.0 / 6.0 - 3.0;
+        auto const GB_hi = level        / 6.0 - 3.0;
+        auto const G_lo  =       audio::to_amplitude(GB_lo);
+        auto const G_hi  = 1.0 - audio::to_amplitude(GB_hi);
+        auto const Fc_lo = 700.0;
+        auto const Fc_hi = Fc_lo * std::exp2((GB_lo - audio::to_decibels(G_hi))
+                                             / 12.0);
+        auto const x_lo = std::exp(-2.0 * pi<double> * Fc_lo / rate);
+        auto const x_hi = std::exp(-2.0 * pi<double> * Fc_hi / rate);
+
+        a0_lo = G_lo * (1.0 - x_lo);
+        b1_lo = x_lo;
+        a0_hi = 1.0 - G_hi * (1.0 - x_hi);
+        b1_hi = x_hi;
+        gain  = 1.0 / (1.0 - G_hi + G_lo);
+    }
+
+    void process(float* const p, std::size_t const n) noexcept
+    {
+        for (auto i = 0_sz; i != n * 2; i += 2) {
+            auto const L = static_cast<double>(p[i]);
+            auto const R = static_cast<double>(p[i + 1]);
+
+            lo[0] = (a0_lo * L) + (b1_lo * lo[0]);
+            lo[1] = (a0_lo * R) + (b1_lo * lo[1]);
+            hi[0] = (a0_hi * L) + (b1_hi * hi[0]) - (b1_hi * asis[0]);
+            hi[1] = (a0_hi * R) + (b1_hi * hi[1]) - (b1_hi * asis[1]);
+            asis[0] = L;
+            asis[1] = R;
+
+            p[i+0] = static_cast<float>((hi[0] + lo[1]) * gain);
+            p[i+1] = static_cast<float>((hi[1] + lo[0]) * gain);
+        }
+    }
+
+private:
+    double a0_lo, b1_lo, a0_hi, b1_hi, gain;
+    std::array<double, 2> asis{}, lo{}, hi{};
+};
+
+std::vector<float> make_signal()
+{
+    std::vector<float> x(frames * 2);
+    for (auto const i : xrange(x.size())) {
+        x[i] = std::sin(static_cast<float>(i) * 0.01f) * 0.5f;
+    }
+    return x;
+}
+
+void crossfeed_scalar(benchmark::State& state)
+{
+    auto const src = make_signal();
+    auto buf = src;
+    scalar_crossfeed xf;
+
+    for (auto _ : state) {
+        std::copy(src.begin(), src.end(), buf.begin());
+        xf.process(buf.data(), frames);
+        benchmark::DoNotOptimize(buf.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * int64(src.size()));
+}
+
+void crossfeed_block(benchmark::State& state)
+{
+    auto const src = make_signal();
+    auto buf = src;
+    audio::crossfeed_kernel xf;
+    xf.calibrate(rate, 700, 45);
+
+    for (auto _ : state) {
+        std::copy(src.begin(), src.end(), buf.begin());
+        xf.process(buf.data(), frames);
+        benchmark::DoNotOptimize(buf.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * int64(src.size()));
+}
+
+}     // namespace <unnamed>
+
+
+BENCHMARK(crossfeed_scalar);
+BENCHMARK(crossfeed_block);
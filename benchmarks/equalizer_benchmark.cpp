@@ -0,0 +1,72 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// benchmarks/equalizer_benchmark.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/numeric.hpp>
+#include <amp/range.hpp>
+#include <amp/stddef.hpp>
+
+#include "filter/equalizer.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+
+using namespace ::amp;
+
+
+namespace {
+
+constexpr auto frames = 4096_sz;
+
+// Ten bands, none of them flat, so that all ten are run.
+void equalizer_10_band(benchmark::State& state)
+{
+    auto const rate = static_cast<uint32>(state.range(0));
+    auto const channels = static_cast<uint32>(state.range(1));
+
+    audio::eq_band bands[10];
+    auto f = 31.f;
+    for (auto& b : bands) {
+        b = {audio::eq_band_type::peaking, f, (f < 1000.f) ? 3.f : -3.f, 1.41f};
+        f *= 2;
+    }
+
+    audio::equalizer_kernel eq;
+    eq.calibrate(rate, channels);
+    eq.set_bands(bands, 10);
+
+    std::vector<float> src(frames * channels);
+    for (auto const i : xrange(src.size())) {
+        src[i] = std::sin(static_cast<float>(i) * 0.01f) * 0.5f;
+    }
+    auto buf = src;
+
+    for (auto _ : state) {
+        std::copy(src.begin(), src.end(), buf.begin());
+        eq.process(buf.data(), frames);
+        benchmark::DoNotOptimize(buf.data());
+        benchmark::ClobberMemory();
+    }
+
+    // How many times faster than real time a single core runs the stream.
+    state.SetItemsProcessed(state.iterations() * int64(src.size()));
+    state.counters["realtime"] = benchmark::Counter(
+        static_cast<double>(state.iterations() * frames) / rate,
+        benchmark::Counter::kIsRate);
+}
+
+}     // namespace <unnamed>
+
+
+BENCHMARK(equalizer_10_band)
+    ->Args({44100, 2})
+    ->Args({192000, 2})
+    ->Args({192000, 6})
+    ->Args({192000, 8});
@@ -0,0 +1,129 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// benchmarks/event_benchmark.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/stddef.hpp>
+
+#include "core/event.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <benchmark/benchmark.h>
+
+
+using namespace ::amp;
+
+
+namespace {
+
+// The textbook alternative: an event built from a mutex and a condition
+// variable, which takes a lock on every post() and wait().
+class condvar_event
+{
+public:
+    void post()
+    {
+        {
+            std::lock_guard<std::mutex> const lk{mtx_};
+            signaled_ = true;
+        }
+        cv_.notify_one();
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lk{mtx_};
+        cv_.wait(lk, [&]{ return signaled_; });
+        signaled_ = false;
+    }
+
+private:
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool signaled_{false};
+};
+
+
+// Round trip between two threads, each blocking until the other posts. This
+// is dominated by the wake-up latency of the blocking path.
+template<typename Event>
+void event_ping_pong(benchmark::State& state)
+{
+    Event ping, pong;
+    std::atomic<bool> done{false};
+
+    std::thread peer{[&]{
+        for (;;) {
+            ping.wait();
+            if (done.load(std::memory_order_relaxed)) {
+                return;
+            }
+            pong.post();
+        }
+    }};
+
+    for (auto _ : state) {
+        ping.post();
+        pong.wait();
+    }
+
+    done.store(true, std::memory_order_relaxed);
+    ping.post();
+    peer.join();
+}
+
+// A producer posting as fast as it can while a consumer drains it. Most
+// posts should hit the lock-free fast path, since the event coalesces.
+template<typename Event>
+void event_throughput(benchmark::State& state)
+{
+    Event ev;
+    std::atomic<bool> done{false};
+
+    std::thread consumer{[&]{
+        while (!done.load(std::memory_order_relaxed)) {
+            ev.wait();
+        }
+    }};
+
+    for (auto _ : state) {
+        ev.post();
+    }
+
+    done.store(true, std::memory_order_relaxed);
+    ev.post();
+    consumer.join();
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Post and wait on the same thread; never blocks.
+template<typename Event>
+void event_uncontended(benchmark::State& state)
+{
+    Event ev;
+    for (auto _ : state) {
+        ev.post();
+        ev.wait();
+    }
+}
+
+}     // namespace <unnamed>
+
+
+#define AMP_EVENT_BENCHMARKS(Event) \
+    BENCHMARK_TEMPLATE(event_ping_pong, Event)->UseRealTime(); \
+    BENCHMARK_TEMPLATE(event_throughput, Event)->UseRealTime(); \
+    BENCHMARK_TEMPLATE(event_uncontended, Event)
+
+AMP_EVENT_BENCHMARKS(auto_reset_event);
+AMP_EVENT_BENCHMARKS(condvar_event);
+
+#if defined(__linux__)
+AMP_EVENT_BENCHMARKS(basic_auto_reset_event<aux::posix_semaphore>);
+#endif
@@ -0,0 +1,132 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// benchmarks/filter_chain_benchmark.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/filter.hpp>
+#include <amp/audio/format.hpp>
+#include <amp/audio/packet.hpp>
+#include <amp/range.hpp>
+#include <amp/ref_ptr.hpp>
+#include <amp/stddef.hpp>
+
+#include "audio/channel_mixer.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+
+using namespace ::amp;
+
+
+namespace {
+
+constexpr auto frames = 4096_sz;
+
+// A channel swap, an upmix to 5.1 and a gain: three per-frame stages, as a
+// chain of three filters or as the single matrix the filter chain folds
+// them into.
+struct stages
+{
+    stages()
+    {
+        float const swap[2][2] {
+            { 0.f, 1.f },
+            { 1.f, 0.f },
+        };
+        float gain[6][6]{};
+        for (auto const i : xrange(6)) {
+            gain[i][i] = .5f;
+        }
+
+        audio::build_plan(audio::frame_matrix{2, 2, &swap[0][0], 2}, plans[0]);
+        audio::build_plan(audio::channel_layout_stereo,
+                          audio::channel_layout_5_1, plans[1]);
+        audio::build_plan(audio::frame_matrix{6, 6, &gain[0][0], 6}, plans[2]);
+
+        audio::mix_plan tmp;
+        audio::compose_plan(plans[0], plans[1], tmp);
+        audio::compose_plan(tmp, plans[2], fused);
+    }
+
+    audio::mix_plan plans[3];
+    audio::mix_plan fused;
+};
+
+audio::packet make_packet(uint32 const layout, uint32 const channels)
+{
+    audio::packet pkt;
+    pkt.set_channel_layout(layout, channels);
+    pkt.resize(frames * channels);
+    for (auto const i : xrange(pkt.size())) {
+        pkt[i] = std::sin(static_cast<float>(i) * 0.01f) * 0.5f;
+    }
+    return pkt;
+}
+
+void run(benchmark::State& state,
+         std::vector<ref_ptr<audio::filter>> const& filters,
+         uint32 const layout, uint32 const channels)
+{
+    auto const src = make_packet(layout, channels);
+    audio::packet pkt;
+    pkt.reserve(frames * audio::max_channels);
+
+    for (auto _ : state) {
+        pkt.set_channel_layout(layout, channels);
+        pkt.assign(src.data(), src.size());
+        for (auto&& f : filters) {
+            f->process(pkt);
+        }
+        benchmark::DoNotOptimize(pkt.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * int64(frames));
+}
+
+// Each stage on its own, for the breakdown.
+void filter_chain_stage(benchmark::State& state)
+{
+    stages s;
+    auto const i = static_cast<std::size_t>(state.range(0));
+    auto const& plan = s.plans[i];
+    auto const src_layout = (plan.src_channels == 2)
+                          ? audio::channel_layout_stereo
+                          : audio::channel_layout_5_1;
+    auto const dst_layout = (plan.dst_channels == 2)
+                          ? audio::channel_layout_stereo
+                          : audio::channel_layout_5_1;
+    run(state, {audio::channel_mixer::make(plan, dst_layout)},
+        src_layout, plan.src_channels);
+}
+
+void filter_chain_unfused(benchmark::State& state)
+{
+    stages s;
+    run(state, {
+            audio::channel_mixer::make(s.plans[0],
+                                       audio::channel_layout_stereo),
+            audio::channel_mixer::make(s.plans[1], audio::channel_layout_5_1),
+            audio::channel_mixer::make(s.plans[2], audio::channel_layout_5_1),
+        }, audio::channel_layout_stereo, 2);
+}
+
+void filter_chain_fused(benchmark::State& state)
+{
+    stages s;
+    run(state, {audio::channel_mixer::make(s.fused,
+                                           audio::channel_layout_5_1)},
+        audio::channel_layout_stereo, 2);
+}
+
+}     // namespace <unnamed>
+
+
+BENCHMARK(filter_chain_stage)->DenseRange(0, 2);
+BENCHMARK(filter_chain_unfused);
+BENCHMARK(filter_chain_fused);
@@ -0,0 +1,62 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// benchmarks/loudness_agc_benchmark.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/format.hpp>
+#include <amp/range.hpp>
+#include <amp/stddef.hpp>
+
+#include "filter/loudness_agc.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+
+using namespace ::amp;
+
+
+namespace {
+
+constexpr auto frames = 4096_sz;
+
+void loudness_agc(benchmark::State& state)
+{
+    auto const rate = static_cast<uint32>(state.range(0));
+    auto const channels = static_cast<uint32>(state.range(1));
+
+    audio::loudness_agc_kernel agc;
+    agc.calibrate(rate, channels, audio::guess_channel_layout(channels));
+
+    // Loud enough that the limiter is ramping most of the time.
+    std::vector<float> src(frames * channels);
+    for (auto const i : xrange(src.size())) {
+        src[i] = std::sin(static_cast<float>(i) * 0.01f) * 0.99f;
+    }
+
+    std::vector<float> buf(src.size());
+    for (auto _ : state) {
+        buf = src;
+        agc.process(buf.data(), frames);
+        benchmark::DoNotOptimize(buf.data());
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * int64(src.size()));
+    state.counters["realtime"] = benchmark::Counter(
+        static_cast<double>(state.iterations() * frames) / rate,
+        benchmark::Counter::kIsRate);
+}
+
+}     // namespace <unnamed>
+
+
+BENCHMARK(loudness_agc)
+    ->Args({44100, 2})
+    ->Args({48000, 6})
+    ->Args({192000, 8});
@@ -0,0 +1,64 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// benchmarks/loudness_benchmark.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/format.hpp>
+#include <amp/range.hpp>
+#include <amp/stddef.hpp>
+
+#include "audio/loudness.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+
+using namespace ::amp;
+
+
+namespace {
+
+constexpr auto frames = 4096_sz;
+
+// Measures a packet at a time, as the scanner does while decoding.
+void measure(benchmark::State& state)
+{
+    auto const rate = static_cast<uint32>(state.range(0));
+    auto const channels = static_cast<uint32>(state.range(1));
+
+    audio::format fmt{};
+    fmt.sample_rate = rate;
+    fmt.channels = channels;
+    fmt.channel_layout = audio::guess_channel_layout(channels);
+    audio::loudness_meter meter{fmt};
+
+    std::vector<float> src(frames * channels);
+    for (auto const i : xrange(src.size())) {
+        src[i] = std::sin(static_cast<float>(i) * 0.01f) * 0.5f;
+    }
+
+    for (auto _ : state) {
+        meter.process(src.data(), frames);
+        benchmark::ClobberMemory();
+    }
+    benchmark::DoNotOptimize(meter.integrated());
+
+    state.SetItemsProcessed(state.iterations() * int64(src.size()));
+    state.counters["realtime"] = benchmark::Counter(
+        static_cast<double>(state.iterations() * frames) / rate,
+        benchmark::Counter::kIsRate);
+}
+
+}     // namespace <unnamed>
+
+
+BENCHMARK(measure)
+    ->Args({44100, 2})
+    ->Args({48000, 6})
+    ->Args({96000, 2})
+    ->Args({192000, 8});
@@ -0,0 +1,102 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// benchmarks/output_stage_benchmark.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/format.hpp>
+#include <amp/range.hpp>
+#include <amp/stddef.hpp>
+
+#include "audio/output_stage.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+
+using namespace ::amp;
+
+
+namespace {
+
+constexpr auto frames = 4096_sz;
+constexpr auto channels = 2_sz;
+
+std::vector<float> make_signal()
+{
+    std::vector<float> x(frames * channels);
+    for (auto const i : xrange(x.size())) {
+        x[i] = static_cast<float>(i % 199) / 99.f - 1.f;
+    }
+    return x;
+}
+
+audio::format make_format()
+{
+    audio::format fmt{};
+    fmt.sample_rate = 48000;
+    fmt.channels = channels;
+    return fmt;
+}
+
+
+// The path this replaced: the player thread scales and clips each sample
+// as it renders into the ring, and the output applies the volume in another
+// pass, without smoothing.
+void previous_path(benchmark::State& state)
+{
+    auto const src = make_signal();
+    std::vector<float> dst(src.size());
+
+    auto const gain = 0.8f;
+    auto const volume = 0.5f;
+    for (auto _ : state) {
+        for (auto const i : xrange(src.size())) {
+            auto const x = src[i] * gain;
+            dst[i] = (x < -1.f) ? -1.f : (x > 1.f) ? 1.f : x;
+        }
+        for (auto&& x : dst) {
+            x *= volume;
+        }
+        benchmark::DoNotOptimize(dst.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * int64(src.size()));
+}
+
+// ReplayGain on render, then the fused stage on the output callback. The
+// volume is moved back and forth every iteration so that it is always
+// ramping.
+void output_stage(benchmark::State& state)
+{
+    auto const src = make_signal();
+    std::vector<float> dst(src.size());
+
+    audio::output_stage_policy policy;
+    policy.limiter = static_cast<audio::limiter_mode>(state.range(0));
+    policy.dither_bits = static_cast<uint8>(state.range(1));
+    audio::output_stage stage{make_format(), policy};
+
+    auto flip = false;
+    for (auto _ : state) {
+        stage.set_volume((flip = !flip) ? 0.5f : 0.6f);
+        audio::output_stage::scale(0.8f, src.data(), dst.data(), dst.size());
+        stage.process(dst.data(), dst.data(), dst.size());
+        benchmark::DoNotOptimize(dst.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * int64(src.size()));
+}
+
+}     // namespace <unnamed>
+
+
+BENCHMARK(previous_path);
+BENCHMARK(output_stage)
+    ->Args({int(audio::limiter_mode::clip), 0})
+    ->Args({int(audio::limiter_mode::soft), 0})
+    ->Args({int(audio::limiter_mode::soft), 16});
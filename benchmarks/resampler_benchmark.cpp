@@ -0,0 +1,238 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// benchmarks/resampler_benchmark.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/filter.hpp>
+#include <amp/audio/format.hpp>
+#include <amp/audio/packet.hpp>
+#include <amp/numeric.hpp>
+#include <amp/range.hpp>
+#include <amp/stddef.hpp>
+
+#include "audio/resampler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#if defined(AMP_BENCHMARK_SOXR)
+# include <soxr.h>
+#endif
+
+
+using namespace ::amp;
+
+
+namespace {
+
+constexpr auto frames = 4096_sz;
+
+class builtin
+{
+public:
+    builtin(uint32 const irate, uint32 const orate, uint32 const channels,
+            uint8 const quality)
+    {
+        audio::format fmt{};
+        fmt.sample_rate = irate;
+        fmt.channels = channels;
+        fmt.channel_layout = audio::guess_channel_layout(channels);
+        rs_.set_sample_rate(orate);
+        rs_.set_quality(quality);
+        rs_.calibrate(fmt);
+    }
+
+    void process(audio::packet& pkt)
+    { rs_.process(pkt); }
+
+private:
+    audio::polyphase_resampler rs_;
+};
+
+#if defined(AMP_BENCHMARK_SOXR)
+
+class sox
+{
+public:
+    sox(uint32 const irate, uint32 const orate, uint32 const channels,
+        uint8 const quality) :
+        irate_{irate},
+        orate_{orate},
+        channels_{channels}
+    {
+        static constexpr unsigned long recipes[] {
+            SOXR_QQ, SOXR_LQ, SOXR_MQ, SOXR_HQ, SOXR_VHQ,
+        };
+        auto const q = ::soxr_quality_spec(recipes[quality - 1],
+                                           SOXR_ROLLOFF_NONE);
+        auto const io = ::soxr_io_spec(SOXR_FLOAT32_I, SOXR_FLOAT32_I);
+        handle_.reset(::soxr_create(irate, orate, channels, nullptr,
+                                    &io, &q, nullptr));
+    }
+
+    void process(audio::packet& pkt)
+    {
+        auto const ilen = pkt.frames();
+        in_.assign(pkt.cbegin(), pkt.cend());
+
+        auto const olen = muldiv(ilen, orate_, irate_) + 1;
+        pkt.resize(olen * channels_, uninitialized);
+
+        std::size_t odone;
+        ::soxr_process(handle_.get(), in_.data(), ilen, nullptr,
+                       pkt.data(), olen, &odone);
+        pkt.resize(odone * channels_);
+    }
+
+private:
+    struct deleter
+    {
+        void operator()(::soxr* const p) const noexcept
+        { ::soxr_delete(p); }
+    };
+
+    std::unique_ptr<::soxr, deleter> handle_;
+    audio::packet in_;
+    uint32 irate_, orate_, channels_;
+};
+
+#endif  // AMP_BENCHMARK_SOXR
+
+
+// Resamples one second of a tone, and returns the output from the point
+// where the filter has filled.
+template<typename Resampler>
+std::vector<double> resample_tone(uint32 const irate, uint32 const orate,
+                                  uint8 const quality, double const freq)
+{
+    Resampler rs{irate, orate, 1, quality};
+    std::vector<double> out;
+    audio::packet pkt;
+
+    for (auto i = 0_sz; i < irate; i += frames) {
+        pkt.set_channel_layout(audio::channel_layout_mono, 1);
+        pkt.resize(frames);
+        for (auto const t : xrange(frames)) {
+            auto const n = static_cast<double>(i + t);
+            pkt[t] = static_cast<float>(
+                std::sin(2. * pi<double> * freq * n / irate) * .5);
+        }
+        rs.process(pkt);
+        out.insert(out.end(), pkt.begin(), pkt.end());
+    }
+    out.erase(out.begin(), out.begin() + std::min<std::size_t>(
+                  out.size(), orate / 10));
+    return out;
+}
+
+struct tone_fit
+{
+    double amplitude;
+    double residual;        // RMS of what is not the tone
+};
+
+// Least-squares fit of a tone of known frequency.
+tone_fit fit(std::vector<double> const& y, double const freq,
+             double const rate)
+{
+    auto ss = 0., sc = 0., cc = 0., ys = 0., yc = 0.;
+    for (auto const t : xrange(y.size())) {
+        auto const w = 2. * pi<double> * freq * static_cast<double>(t) / rate;
+        auto const s = std::sin(w);
+        auto const c = std::cos(w);
+        ss += s * s; sc += s * c; cc += c * c;
+        ys += y[t] * s; yc += y[t] * c;
+    }
+    auto const det = ss * cc - sc * sc;
+    auto const a = (ys * cc - yc * sc) / det;
+    auto const b = (yc * ss - ys * sc) / det;
+
+    auto err = 0.;
+    for (auto const t : xrange(y.size())) {
+        auto const w = 2. * pi<double> * freq * static_cast<double>(t) / rate;
+        auto const e = y[t] - (a * std::sin(w) + b * std::cos(w));
+        err += e * e;
+    }
+    return {std::hypot(a, b), std::sqrt(err / static_cast<double>(y.size()))};
+}
+
+template<typename Resampler>
+void report_quality(benchmark::State& state, uint32 const irate,
+                    uint32 const orate, uint8 const quality)
+{
+    // THD+N of a 1 kHz tone at -6 dBFS.
+    auto const tone = fit(resample_tone<Resampler>(irate, orate, quality,
+                                                   1000.), 1000., orate);
+    state.counters["thd+n_db"] = 20. * std::log10(
+        tone.residual / (tone.amplitude / std::sqrt(2.)));
+
+    // Peak-to-peak gain variation up to 16 kHz.
+    auto lo = tone.amplitude;
+    auto hi = tone.amplitude;
+    for (auto const f : {50., 5000., 10000., 14000., 16000.}) {
+        auto const x = fit(resample_tone<Resampler>(irate, orate, quality, f),
+                           f, orate);
+        lo = std::min(lo, x.amplitude);
+        hi = std::max(hi, x.amplitude);
+    }
+    state.counters["ripple_db"] = 20. * std::log10(hi / lo);
+}
+
+template<typename Resampler>
+void resample(benchmark::State& state)
+{
+    auto const irate = static_cast<uint32>(state.range(0));
+    auto const orate = static_cast<uint32>(state.range(1));
+    auto const channels = static_cast<uint32>(state.range(2));
+    auto const quality = static_cast<uint8>(state.range(3));
+
+    Resampler rs{irate, orate, channels, quality};
+    std::vector<float> src(frames * channels);
+    for (auto const i : xrange(src.size())) {
+        src[i] = std::sin(static_cast<float>(i) * 0.01f) * 0.5f;
+    }
+
+    audio::packet pkt;
+    for (auto _ : state) {
+        pkt.set_channel_layout(audio::guess_channel_layout(channels),
+                               channels);
+        pkt.assign(src.data(), src.size());
+        rs.process(pkt);
+        benchmark::DoNotOptimize(pkt.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * int64(src.size()));
+    state.counters["realtime"] = benchmark::Counter(
+        static_cast<double>(state.iterations() * frames) / irate,
+        benchmark::Counter::kIsRate);
+
+    if (channels == 1) {
+        report_quality<Resampler>(state, irate, orate, quality);
+    }
+}
+
+void arguments(benchmark::internal::Benchmark* const b)
+{
+    for (auto q = int64{audio::quality_minimum};
+         q <= int64{audio::quality_maximum}; ++q) {
+        b->Args({44100, 48000, 1, q});
+    }
+    b->Args({44100, 48000, 2, audio::quality_medium});
+    b->Args({96000, 44100, 2, audio::quality_medium});
+    b->Args({384000, 48000, 8, audio::quality_medium});
+}
+
+}     // namespace <unnamed>
+
+
+BENCHMARK_TEMPLATE(resample, builtin)->Apply(arguments);
+#if defined(AMP_BENCHMARK_SOXR)
+BENCHMARK_TEMPLATE(resample, sox)->Apply(arguments);
+#endif
@@ -16,6 +16,7 @@
 #include <amp/stddef.hpp>
 #include <amp/type_traits.hpp>
 
+#include <cstddef>
 #include <string_view>
 #include <utility>
 
@@ -36,6 +37,19 @@ struct format;
 class packet;
 
 
+// A filter whose output frame is a fixed linear combination of its input
+// frame's channels (a channel swap, a downmix, a gain) can describe itself
+// as a matrix, so that the filter chain can fold it together with its
+// neighbours into a single pass.
+struct frame_matrix
+{
+    uint32 src_channels;
+    uint32 dst_channels;
+    float const* coeffs;        // [dst_channels][stride]
+    std::size_t stride;
+};
+
+
 class filter
 {
 public:
@@ -46,8 +60,14 @@ public:
     virtual void process(audio::packet&) = 0;
     virtual void drain(audio::packet&) = 0;
     virtual void flush() = 0;
+
+    // In frames, at the filter's output sample rate.
     virtual uint64 get_latency() = 0;
 
+    // Valid from calibration until the next one. Returns false for filters
+    // that are not a per-frame matrix (i.e. nearly all of them).
+    virtual bool get_matrix(audio::frame_matrix&) = 0;
+
 protected:
     filter() = default;
     ~filter() = default;
@@ -146,7 +166,19 @@ public:
     uint64 get_latency() override
     { return base_.get_latency(); }
 
+    bool get_matrix(audio::frame_matrix& m) override
+    { return get_matrix_(base_, m, 0); }
+
 private:
+    template<typename U>
+    static auto get_matrix_(U& x, audio::frame_matrix& m, int)
+        -> decltype(x.get_matrix(m))
+    { return x.get_matrix(m); }
+
+    template<typename U>
+    static bool get_matrix_(U&, audio::frame_matrix&, long) noexcept
+    { return false; }
+
     T base_;
 };
 
@@ -184,6 +216,9 @@ public:
     void set_quality(uint8 const quality) override
     { base_.set_quality(quality); }
 
+    bool get_matrix(audio::frame_matrix&) noexcept override
+    { return false; }
+
 private:
     T base_;
 };
@@ -0,0 +1,108 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// amp/audio/kweighting.hpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef AMP_INCLUDED_F7F60249_D45B_4BFF_8A32_541F7780336D
+#define AMP_INCLUDED_F7F60249_D45B_4BFF_8A32_541F7780336D
+
+
+#include <amp/audio/format.hpp>
+#include <amp/numeric.hpp>
+#include <amp/stddef.hpp>
+
+#include <cmath>
+
+
+namespace amp {
+namespace audio {
+
+// -- Overview --
+//
+// The pre-filter of ITU-R BS.1770: a high shelf, then a high pass. The
+// standard only gives its coefficients at 48 kHz; design() starts from the
+// analog prototypes they were derived from instead, so as to match them at
+// any rate. The coefficients are those of a direct form II transposed
+// biquad, (b0, b1, b2, a1, a2).
+
+template<typename T>
+struct kweighting
+{
+    T shelf[5];
+    T pass[5];
+
+    void design(double const rate) noexcept
+    {
+        {
+            auto const f0 = 1681.974450955533;
+            auto const G  = 3.999843853973347;
+            auto const Q  = 0.7071752369554196;
+
+            auto const K  = std::tan(pi<double> * f0 / rate);
+            auto const Vh = std::pow(10., G / 20.);
+            auto const Vb = std::pow(Vh, 0.4996667741545416);
+            auto const a0 = 1. + K / Q + K * K;
+
+            shelf[0] = static_cast<T>((Vh + Vb * K / Q + K * K) / a0);
+            shelf[1] = static_cast<T>(2. * (K * K - Vh) / a0);
+            shelf[2] = static_cast<T>((Vh - Vb * K / Q + K * K) / a0);
+            shelf[3] = static_cast<T>(2. * (K * K - 1.) / a0);
+            shelf[4] = static_cast<T>((1. - K / Q + K * K) / a0);
+        }
+        {
+            auto const f0 = 38.13547087602444;
+            auto const Q  = 0.5003270373238773;
+
+            auto const K  = std::tan(pi<double> * f0 / rate);
+            auto const a0 = 1. + K / Q + K * K;
+
+            pass[0] = T(1);
+            pass[1] = T(-2);
+            pass[2] = T(1);
+            pass[3] = static_cast<T>(2. * (K * K - 1.) / a0);
+            pass[4] = static_cast<T>((1. - K / Q + K * K) / a0);
+        }
+    }
+
+    // Filters one sample, given the states of the shelf (s1, s2) and of the
+    // high pass (p1, p2). The high pass's numerator is (1, -2, 1), which
+    // saves two products.
+    AMP_INLINE T operator()(T const x, T& s1, T& s2, T& p1, T& p2) const
+        noexcept
+    {
+        auto const y = shelf[0] * x + s1;
+        s1 = shelf[1] * x - shelf[3] * y + s2;
+        s2 = shelf[2] * x - shelf[4] * y;
+
+        auto const z = y + p1;
+        p1 = p2 - (y + y) - pass[3] * z;
+        p2 = y - pass[4] * z;
+        return z;
+    }
+};
+
+
+// Weights of BS.1770-4, Table 3: the surrounds are boosted by 1.5 dB, and
+// the LFE channel is not measured.
+template<typename T>
+AMP_INLINE constexpr T kweighting_channel_weight(uint32 const bit) noexcept
+{
+    switch (bit) {
+    case channel_bit::lfe:
+        return T(0);
+    case channel_bit::back_left:
+    case channel_bit::back_right:
+    case channel_bit::side_left:
+    case channel_bit::side_right:
+        return T(1.41);
+    default:
+        return T(1);
+    }
+}
+
+}}    // namespace amp::audio
+
+
+#endif  // AMP_INCLUDED_F7F60249_D45B_4BFF_8A32_541F7780336D
@@ -59,6 +59,22 @@ protected:
     ~output_device_list() = default;
 };
 
+// Interleaved audio that an output stream can read in place, rather than
+// having it copied into a buffer of its own.
+class output_source
+{
+public:
+    // Returns the next `frames` frames to be played. If fewer are available,
+    // `frames` is lowered accordingly; the rest of the period should be
+    // filled with silence. The samples remain valid until released.
+    virtual float const* acquire(uint32& frames) noexcept = 0;
+    virtual void release(uint32 frames) noexcept = 0;
+
+protected:
+    output_source() = default;
+    ~output_source() = default;
+};
+
 class output_stream
 {
 public:
@@ -66,6 +82,10 @@ public:
     virtual void release() noexcept = 0;
 
     virtual void start(function_view<void(float*, uint32)>) = 0;
+
+    // Starts pulling audio from `src` in place. Returns false (and does
+    // nothing) if the stream can only be fed through start().
+    virtual bool start_pull(output_source&) = 0;
     virtual void stop() = 0;
     virtual void pause() = 0;
     virtual void flush() = 0;
@@ -74,6 +94,9 @@ public:
     virtual float get_volume() = 0;
     virtual audio::format get_format() = 0;
 
+    // Frames between the output callback and the speaker, while started.
+    virtual uint64 get_latency() = 0;
+
 protected:
     output_stream() = default;
     ~output_stream() = default;
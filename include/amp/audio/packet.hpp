@@ -16,12 +16,19 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <new>
 #include <utility>
 
 
 namespace amp {
 namespace audio {
 
+// Storage is obtained from the global operator new, rather than malloc, so
+// that a replacement allocator (see core/allocation_guard.hpp) sees it.
+// Growing the buffer reserves half as much again as was asked for, so that
+// a buffer which is refilled with packets of slightly varying sizes settles
+// on a fixed capacity after only a few reallocations.
+
 class packet_buffer
 {
 public:
@@ -73,7 +80,7 @@ public:
     ~packet_buffer()
     {
         if (data_ != nullptr) {
-            std::free(data_);
+            ::operator delete(data_);
         }
     }
 
@@ -172,12 +179,7 @@ public:
     {
         if (n > size()) {
             if (n > capacity()) {
-                auto const tmp = std::realloc(data_, n * sizeof(value_type));
-                if (tmp == nullptr) {
-                    raise_bad_alloc();
-                }
-                data_ = static_cast<value_type*>(tmp);
-                capacity_ = n;
+                grow_(n);
             }
             std::fill(begin() + size(), begin() + n, value_type{});
         }
@@ -187,29 +189,44 @@ public:
     void resize(size_type const n, uninitialized_t)
     {
         if (n > capacity()) {
-            auto const tmp = std::realloc(data_, n * sizeof(value_type));
-            if (tmp == nullptr) {
-                raise_bad_alloc();
-            }
-            data_ = static_cast<value_type*>(tmp);
-            capacity_ = n;
+            grow_(n);
         }
         size_ = n;
     }
 
+    // Ensures that the buffer can hold `n` samples without reallocating.
+    void reserve(size_type const n)
+    {
+        if (n > capacity()) {
+            reallocate_(n);
+        }
+    }
+
 private:
     AMP_INLINE static pointer allocate_(size_type const n)
     {
         if (n != 0) {
-            auto const p = std::malloc(n * sizeof(float));
-            if (p == nullptr) {
-                raise_bad_alloc();
-            }
-            return static_cast<pointer>(p);
+            return static_cast<pointer>(::operator new(n * sizeof(float)));
         }
         return nullptr;
     }
 
+    void reallocate_(size_type const n)
+    {
+        auto const tmp = packet_buffer::allocate_(n);
+        std::copy(cbegin(), cend(), tmp);
+        if (data_ != nullptr) {
+            ::operator delete(data_);
+        }
+        data_ = tmp;
+        capacity_ = n;
+    }
+
+    void grow_(size_type const n)
+    {
+        reallocate_(std::max(n, capacity() + capacity() / 2));
+    }
+
     pointer data_{};
     size_type size_{};
     size_type capacity_{};
@@ -337,6 +354,9 @@ public:
     void resize(size_type const n, uninitialized_t)
     { buffer_.resize(n, uninitialized); }
 
+    void reserve(size_type const n)
+    { buffer_.reserve(n); }
+
     void fill_planar(const_pointer const* const planes, size_type const n)
     {
         resize(n * channels(), uninitialized);
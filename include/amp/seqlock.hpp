@@ -0,0 +1,95 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// amp/seqlock.hpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef AMP_INCLUDED_0FFA6567_F909_411E_A493_765A0696840B
+#define AMP_INCLUDED_0FFA6567_F909_411E_A493_765A0696840B
+
+
+#include <amp/stddef.hpp>
+#include <amp/type_traits.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+
+
+namespace amp {
+
+// -- Overview --
+//
+// Publishes a small trivially copyable value from a single writer to any
+// number of readers. Neither side ever blocks: the writer never waits, and a
+// reader simply retries if it raced with a write. The value is stored as an
+// array of atomic words so that torn reads are well-defined (and discarded).
+
+
+template<typename T>
+class seqlock
+{
+    static_assert(is_trivially_copyable_v<T>, "");
+    static_assert(sizeof(T) % sizeof(uint32) == 0, "");
+
+    static constexpr auto word_count = sizeof(T) / sizeof(uint32);
+
+public:
+    explicit seqlock(T const& x = T{}) noexcept
+    {
+        store_words_(x);
+    }
+
+    seqlock(seqlock const&) = delete;
+    seqlock& operator=(seqlock const&) = delete;
+
+    void store(T const& x) noexcept
+    {
+        auto const seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        store_words_(x);
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    T load() const noexcept
+    {
+        for (;;) {
+            auto const seq = seq_.load(std::memory_order_acquire);
+            if (AMP_UNLIKELY(seq & 1)) {
+                continue;
+            }
+
+            uint32 words[word_count];
+            for (auto i = 0_sz; i != word_count; ++i) {
+                words[i] = words_[i].load(std::memory_order_relaxed);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (AMP_LIKELY(seq_.load(std::memory_order_relaxed) == seq)) {
+                T x;
+                std::memcpy(&x, words, sizeof(x));
+                return x;
+            }
+        }
+    }
+
+private:
+    void store_words_(T const& x) noexcept
+    {
+        uint32 words[word_count];
+        std::memcpy(words, &x, sizeof(x));
+        for (auto i = 0_sz; i != word_count; ++i) {
+            words_[i].store(words[i], std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<uint32> seq_{0};
+    std::atomic<uint32> words_[word_count];
+};
+
+}     // namespace amp
+
+
+#endif  // AMP_INCLUDED_0FFA6567_F909_411E_A493_765A0696840B
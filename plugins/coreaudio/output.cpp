@@ -57,6 +57,7 @@ class output_stream final :
 {
 public:
     explicit output_stream(AudioDeviceID const device_id) :
+        device_id_(device_id),
         unit_([]{
             AudioComponentDescription acd{};
             acd.componentType         = kAudioUnitType_Output;
@@ -98,6 +99,12 @@ public:
         verify(AudioOutputUnitStart(unit_.get()));
     }
 
+    bool start_pull(audio::output_source&) noexcept override
+    {
+        // The HAL hands us the buffers to render into.
+        return false;
+    }
+
     void stop() override
     {
         pause();
@@ -142,6 +149,8 @@ public:
         return format;
     }
 
+    uint64 get_latency() override;
+
 private:
     static remove_pointer_t<AURenderCallback> render;
 
@@ -173,6 +182,7 @@ private:
                                     0, &asbd, sizeof(asbd)));
     }
 
+    AudioDeviceID const device_id_;
     std::unique_ptr<remove_pointer_t<AudioUnit>> unit_;
     function_view<void(float*, uint32)> feed_;
 };
@@ -226,6 +236,22 @@ inline auto get_string_property(AudioDeviceID const device_id,
                                 static_cast<std::size_t>(len));
 }
 
+inline auto get_uint32_property(AudioDeviceID const device_id,
+                                AudioObjectPropertySelector const selector)
+{
+    uint32 data;
+    auto size = uint32{sizeof(data)};
+    auto addr = AudioObjectPropertyAddress {
+        selector,
+        kAudioDevicePropertyScopeOutput,
+        kAudioObjectPropertyElementMaster,
+    };
+
+    verify(AudioObjectGetPropertyData(device_id, &addr, 0, nullptr,
+                                      &size, &data));
+    return data;
+}
+
 inline auto get_device_uid(AudioDeviceID const device_id)
 {
     return get_string_property(device_id, kAudioDevicePropertyDeviceUID);
@@ -292,6 +318,19 @@ inline auto make_device(u8string const& uid)
 }
 
 
+uint64 output_stream::get_latency()
+{
+    // The device's own latency and safety offset, plus one I/O buffer that
+    // the HAL renders ahead of the hardware.
+    return uint64{get_uint32_property(device_id_,
+                                      kAudioDevicePropertyLatency)}
+         + uint64{get_uint32_property(device_id_,
+                                      kAudioDevicePropertySafetyOffset)}
+         + uint64{get_uint32_property(device_id_,
+                                      kAudioDevicePropertyBufferFrameSize)};
+}
+
+
 class output_device_list final :
     public implement_ref_count<output_device_list, audio::output_device_list>
 {
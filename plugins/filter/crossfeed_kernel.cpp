@@ -0,0 +1,275 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// plugins/filter/crossfeed_kernel.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/utility.hpp>
+#include <amp/bitops.hpp>
+#include <amp/numeric.hpp>
+#include <amp/range.hpp>
+#include <amp/stddef.hpp>
+
+#include "crossfeed_kernel.hpp"
+#include "simd.hpp"
+
+#include <cmath>
+#include <cstddef>
+
+
+namespace amp {
+namespace audio {
+namespace {
+
+using coefficients = crossfeed_kernel::coefficients;
+using state = crossfeed_kernel::state;
+
+
+void process_generic(float* const p, std::size_t const n,
+                     coefficients const& c, state& st) noexcept
+{
+    for (auto const i : xrange(n)) {
+        auto const L = p[i*2 + 0];
+        auto const R = p[i*2 + 1];
+
+        st.lo[0] = (c.lo_b * st.lo[0]) + (c.lo_a * L);
+        st.lo[1] = (c.lo_b * st.lo[1]) + (c.lo_a * R);
+
+        st.hi[0] = (c.hi_b * st.hi[0]) + (c.hi_a * L) - (c.hi_c * st.prev[0]);
+        st.hi[1] = (c.hi_b * st.hi[1]) + (c.hi_a * R) - (c.hi_c * st.prev[1]);
+
+        st.prev[0] = L;
+        st.prev[1] = R;
+
+        p[i*2 + 0] = st.hi[0] + st.lo[1];
+        p[i*2 + 1] = st.hi[1] + st.lo[0];
+    }
+}
+
+#if defined(AMP_FILTER_SSE2)
+
+// y[t] = u[t] + b y[t-1] over four frames, with y[-1] broadcast in `s`.
+// Leaves y[3] broadcast in `s`.
+AMP_TARGET("sse2")
+AMP_INLINE __m128 scan(__m128 const u, __m128& s, __m128 const b1,
+                       __m128 const b2, __m128 const pw) noexcept
+{
+    auto const u1 = _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(u), 4));
+    auto const v = _mm_add_ps(u, _mm_mul_ps(b1, u1));
+    auto const v2 = _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 8));
+    auto const w = _mm_add_ps(v, _mm_mul_ps(b2, v2));
+    auto const y = _mm_add_ps(w, _mm_mul_ps(pw, s));
+    s = _mm_shuffle_ps(y, y, _MM_SHUFFLE(3, 3, 3, 3));
+    return y;
+}
+
+// Returns {prev[3], x[0], x[1], x[2]}.
+AMP_TARGET("sse2")
+AMP_INLINE __m128 delay(__m128 const x, __m128 const prev) noexcept
+{
+    auto const t = _mm_shuffle_ps(prev, x, _MM_SHUFFLE(0, 0, 3, 3));
+    return _mm_shuffle_ps(t, x, _MM_SHUFFLE(2, 1, 2, 0));
+}
+
+AMP_TARGET("sse2")
+void process_sse2(float* const p, std::size_t const n,
+                  coefficients const& c, state& st) noexcept
+{
+    auto const lo_a  = _mm_set1_ps(c.lo_a);
+    auto const lo_b1 = _mm_set1_ps(c.lo_pow[0]);
+    auto const lo_b2 = _mm_set1_ps(c.lo_pow[1]);
+    auto const lo_pw = _mm_loadu_ps(c.lo_pow);
+    auto const hi_a  = _mm_set1_ps(c.hi_a);
+    auto const hi_c  = _mm_set1_ps(c.hi_c);
+    auto const hi_b1 = _mm_set1_ps(c.hi_pow[0]);
+    auto const hi_b2 = _mm_set1_ps(c.hi_pow[1]);
+    auto const hi_pw = _mm_loadu_ps(c.hi_pow);
+
+    auto lo_l = _mm_set1_ps(st.lo[0]);
+    auto lo_r = _mm_set1_ps(st.lo[1]);
+    auto hi_l = _mm_set1_ps(st.hi[0]);
+    auto hi_r = _mm_set1_ps(st.hi[1]);
+    auto prev_l = _mm_set1_ps(st.prev[0]);
+    auto prev_r = _mm_set1_ps(st.prev[1]);
+    auto i = 0_sz;
+
+    for (auto const last = align_down(n, 4); i != last; i += 4) {
+        auto const p0 = _mm_loadu_ps(&p[i*2 + 0]);
+        auto const p1 = _mm_loadu_ps(&p[i*2 + 4]);
+        auto const L = _mm_shuffle_ps(p0, p1, _MM_SHUFFLE(2, 0, 2, 0));
+        auto const R = _mm_shuffle_ps(p0, p1, _MM_SHUFFLE(3, 1, 3, 1));
+
+        auto const u_hi_l = _mm_sub_ps(_mm_mul_ps(hi_a, L),
+                                       _mm_mul_ps(hi_c, delay(L, prev_l)));
+        auto const u_hi_r = _mm_sub_ps(_mm_mul_ps(hi_a, R),
+                                       _mm_mul_ps(hi_c, delay(R, prev_r)));
+        prev_l = L;
+        prev_r = R;
+
+        auto const y_lo_l = scan(_mm_mul_ps(lo_a, L), lo_l, lo_b1, lo_b2, lo_pw);
+        auto const y_lo_r = scan(_mm_mul_ps(lo_a, R), lo_r, lo_b1, lo_b2, lo_pw);
+        auto const y_hi_l = scan(u_hi_l, hi_l, hi_b1, hi_b2, hi_pw);
+        auto const y_hi_r = scan(u_hi_r, hi_r, hi_b1, hi_b2, hi_pw);
+
+        auto const out_l = _mm_add_ps(y_hi_l, y_lo_r);
+        auto const out_r = _mm_add_ps(y_hi_r, y_lo_l);
+        _mm_storeu_ps(&p[i*2 + 0], _mm_unpacklo_ps(out_l, out_r));
+        _mm_storeu_ps(&p[i*2 + 4], _mm_unpackhi_ps(out_l, out_r));
+    }
+
+    st.lo[0] = _mm_cvtss_f32(lo_l);
+    st.lo[1] = _mm_cvtss_f32(lo_r);
+    st.hi[0] = _mm_cvtss_f32(hi_l);
+    st.hi[1] = _mm_cvtss_f32(hi_r);
+    st.prev[0] = _mm_cvtss_f32(_mm_shuffle_ps(prev_l, prev_l, 0xff));
+    st.prev[1] = _mm_cvtss_f32(_mm_shuffle_ps(prev_r, prev_r, 0xff));
+    process_generic(&p[i*2], n - i, c, st);
+}
+
+
+// Same as above, with the left channel in the lower half of each register
+// and the right one in the upper half; the AVX2 byte shifts and alignr work
+// on each half independently.
+AMP_TARGET("avx2")
+AMP_INLINE __m256 scan(__m256 const u, __m256& s, __m256 const b1,
+                       __m256 const b2, __m256 const pw) noexcept
+{
+    auto const u1 = _mm256_castsi256_ps(
+        _mm256_slli_si256(_mm256_castps_si256(u), 4));
+    auto const v = _mm256_add_ps(u, _mm256_mul_ps(b1, u1));
+    auto const v2 = _mm256_castsi256_ps(
+        _mm256_slli_si256(_mm256_castps_si256(v), 8));
+    auto const w = _mm256_add_ps(v, _mm256_mul_ps(b2, v2));
+    auto const y = _mm256_add_ps(w, _mm256_mul_ps(pw, s));
+    s = _mm256_shuffle_ps(y, y, _MM_SHUFFLE(3, 3, 3, 3));
+    return y;
+}
+
+AMP_TARGET("avx2")
+void process_avx2(float* const p, std::size_t const n,
+                  coefficients const& c, state& st) noexcept
+{
+    auto const deinterleave = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    auto const interleave   = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    auto const lo_a  = _mm256_set1_ps(c.lo_a);
+    auto const lo_b1 = _mm256_set1_ps(c.lo_pow[0]);
+    auto const lo_b2 = _mm256_set1_ps(c.lo_pow[1]);
+    auto const lo_pw = _mm256_broadcast_ps(
+        reinterpret_cast<__m128 const*>(c.lo_pow));
+    auto const hi_a  = _mm256_set1_ps(c.hi_a);
+    auto const hi_c  = _mm256_set1_ps(c.hi_c);
+    auto const hi_b1 = _mm256_set1_ps(c.hi_pow[0]);
+    auto const hi_b2 = _mm256_set1_ps(c.hi_pow[1]);
+    auto const hi_pw = _mm256_broadcast_ps(
+        reinterpret_cast<__m128 const*>(c.hi_pow));
+
+    auto lo = _mm256_setr_m128(_mm_set1_ps(st.lo[0]), _mm_set1_ps(st.lo[1]));
+    auto hi = _mm256_setr_m128(_mm_set1_ps(st.hi[0]), _mm_set1_ps(st.hi[1]));
+    auto prev = _mm256_setr_m128(_mm_set1_ps(st.prev[0]),
+                                 _mm_set1_ps(st.prev[1]));
+    auto i = 0_sz;
+
+    for (auto const last = align_down(n, 4); i != last; i += 4) {
+        auto const x = _mm256_permutevar8x32_ps(_mm256_loadu_ps(&p[i*2]),
+                                                deinterleave);
+        auto const x1 = _mm256_castsi256_ps(
+            _mm256_alignr_epi8(_mm256_castps_si256(x),
+                               _mm256_castps_si256(prev), 12));
+        prev = x;
+
+        auto const y_lo = scan(_mm256_mul_ps(lo_a, x), lo, lo_b1, lo_b2, lo_pw);
+        auto const y_hi = scan(_mm256_sub_ps(_mm256_mul_ps(hi_a, x),
+                                             _mm256_mul_ps(hi_c, x1)),
+                               hi, hi_b1, hi_b2, hi_pw);
+
+        // Each side gets the other side's low pass.
+        auto const y = _mm256_add_ps(y_hi,
+                                     _mm256_permute2f128_ps(y_lo, y_lo, 0x01));
+        _mm256_storeu_ps(&p[i*2], _mm256_permutevar8x32_ps(y, interleave));
+    }
+
+    prev = _mm256_shuffle_ps(prev, prev, _MM_SHUFFLE(3, 3, 3, 3));
+    st.lo[0] = _mm256_cvtss_f32(lo);
+    st.lo[1] = _mm_cvtss_f32(_mm256_extractf128_ps(lo, 1));
+    st.hi[0] = _mm256_cvtss_f32(hi);
+    st.hi[1] = _mm_cvtss_f32(_mm256_extractf128_ps(hi, 1));
+    st.prev[0] = _mm256_cvtss_f32(prev);
+    st.prev[1] = _mm_cvtss_f32(_mm256_extractf128_ps(prev, 1));
+    process_generic(&p[i*2], n - i, c, st);
+}
+
+#endif  // AMP_FILTER_SSE2
+
+}     // namespace <unnamed>
+
+
+void crossfeed_kernel::calibrate(uint32 const rate_, uint32 const cutoff,
+                                 uint32 const feed) noexcept
+{
+    auto const level = static_cast<double>(feed) / 10.0;
+    auto const rate  = static_cast<double>(rate_);
+
+    auto const GB_lo = level * -5.0 / 6.0 - 3.0;
+    auto const GB_hi = level        / 6.0 - 3.0;
+
+    auto const G_lo  =       audio::to_amplitude(GB_lo);
+    auto const G_hi  = 1.0 - audio::to_amplitude(GB_hi);
+
+    auto const Fc_lo = static_cast<double>(cutoff);
+    auto const Fc_hi = Fc_lo * std::exp2((GB_lo - to_decibels(G_hi)) / 12.0);
+
+    auto const x_lo = std::exp(-2.0 * pi<double> * Fc_lo / rate);
+    auto const x_hi = std::exp(-2.0 * pi<double> * Fc_hi / rate);
+    auto const gain = 1.0 / (1.0 - G_hi + G_lo);
+
+    coeffs_.lo_a = static_cast<float>(G_lo * (1.0 - x_lo) * gain);
+    coeffs_.lo_b = static_cast<float>(x_lo);
+    coeffs_.hi_a = static_cast<float>((1.0 - G_hi * (1.0 - x_hi)) * gain);
+    coeffs_.hi_b = static_cast<float>(x_hi);
+    coeffs_.hi_c = static_cast<float>(x_hi * gain);
+
+    for (auto const k : xrange(4)) {
+        coeffs_.lo_pow[k] = static_cast<float>(std::pow(x_lo, k + 1));
+        coeffs_.hi_pow[k] = static_cast<float>(std::pow(x_hi, k + 1));
+    }
+
+    if (!select(isa::avx2) && !select(isa::sse2)) {
+        select(isa::generic);
+    }
+    flush();
+}
+
+bool crossfeed_kernel::select(isa const x) noexcept
+{
+    switch (x) {
+    case isa::generic:
+        kernel_ = &process_generic;
+        return true;
+#if defined(AMP_FILTER_SSE2)
+    case isa::sse2:
+        kernel_ = &process_sse2;
+        return true;
+    case isa::avx2:
+        if (has_avx2()) {
+            kernel_ = &process_avx2;
+            return true;
+        }
+        return false;
+#endif
+    default:
+        return false;
+    }
+}
+
+void crossfeed_kernel::process(float* const samples,
+                               std::size_t const frames) noexcept
+{
+#if defined(AMP_FILTER_SSE2)
+    denormals_as_zero const daz;
+#endif
+    kernel_(samples, frames, coeffs_, state_);
+}
+
+}}    // namespace amp::audio
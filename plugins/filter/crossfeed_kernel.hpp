@@ -0,0 +1,78 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// plugins/filter/crossfeed_kernel.hpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef AMP_INCLUDED_271C0C19_F185_45CE_AC21_ED46EBFDFB1F
+#define AMP_INCLUDED_271C0C19_F185_45CE_AC21_ED46EBFDFB1F
+
+
+#include <amp/stddef.hpp>
+
+#include <cstddef>
+
+
+namespace amp {
+namespace audio {
+
+// -- Overview --
+//
+// Each output channel is its own channel through a high shelf, plus the
+// other channel through a low pass; both are one-pole filters. Frames are
+// processed four at a time: every filter's recurrence is unrolled over the
+// block (y[t] = b^(t+1) y[-1] + sum b^(t-j) u[j]) and evaluated as a
+// two-step prefix scan, so that there is no serial dependency from one frame
+// to the next within a block.
+
+class crossfeed_kernel
+{
+public:
+    struct coefficients
+    {
+        // The output gain is folded into `lo_a`, `hi_a` and `hi_c`.
+        float lo_a, lo_b;
+        float hi_a, hi_b, hi_c;
+
+        // Powers b^1 ... b^4 of each filter's pole.
+        float lo_pow[4];
+        float hi_pow[4];
+    };
+
+    struct state
+    {
+        float lo[2];
+        float hi[2];
+        float prev[2];
+    };
+
+    using kernel = void(float*, std::size_t, coefficients const&,
+                        state&) noexcept;
+
+    enum class isa { generic, sse2, avx2 };
+
+    // Takes the cutoff in Hz, and the feed level in tenths of a dB. Picks
+    // the fastest kernel this CPU can run.
+    void calibrate(uint32 rate, uint32 cutoff, uint32 feed) noexcept;
+
+    // Replaces the kernel picked by calibrate; returns false, and leaves it
+    // as it was, if this build or CPU cannot run `x`.
+    bool select(isa x) noexcept;
+
+    // Filters `frames` interleaved stereo frames in place.
+    void process(float* samples, std::size_t frames) noexcept;
+
+    void flush() noexcept
+    { state_ = {}; }
+
+private:
+    coefficients coeffs_{};
+    state state_{};
+    kernel* kernel_{};
+};
+
+}}    // namespace amp::audio
+
+
+#endif  // AMP_INCLUDED_271C0C19_F185_45CE_AC21_ED46EBFDFB1F
@@ -0,0 +1,121 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// plugins/filter/equalizer.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/filter.hpp>
+#include <amp/audio/format.hpp>
+#include <amp/audio/packet.hpp>
+#include <amp/seqlock.hpp>
+#include <amp/stddef.hpp>
+
+#include "equalizer.hpp"
+
+#include <cstring>
+
+
+namespace amp {
+namespace audio {
+
+namespace {
+
+// A flat ten band graphic equalizer, on the ISO octave centres.
+eq_preset default_preset() noexcept
+{
+    static constexpr float centres[] {
+        31.f, 62.f, 125.f, 250.f, 500.f,
+        1000.f, 2000.f, 4000.f, 8000.f, 16000.f,
+    };
+
+    eq_preset x{};
+    for (auto const f : centres) {
+        x.bands[x.count++] = {eq_band_type::peaking, f, 0.f, 1.41f};
+    }
+    return x;
+}
+
+}     // namespace <unnamed>
+
+
+seqlock<eq_preset>& equalizer_bands() noexcept
+{
+    static seqlock<eq_preset> x{default_preset()};
+    return x;
+}
+
+
+namespace {
+
+class equalizer
+{
+public:
+    void calibrate(audio::format&);
+    void process(audio::packet&) noexcept;
+    void drain(audio::packet&) noexcept;
+    void flush() noexcept;
+    uint64 get_latency() const noexcept;
+
+private:
+    void reload_() noexcept;
+
+    equalizer_kernel kernel;
+    eq_preset bands{};
+    uint32 rate{};
+    uint32 channels{};
+};
+
+
+void equalizer::calibrate(audio::format& fmt)
+{
+    if (rate == fmt.sample_rate && channels == fmt.channels) {
+        return;
+    }
+
+    rate = fmt.sample_rate;
+    channels = fmt.channels;
+    kernel.calibrate(rate, channels);
+    reload_();
+}
+
+void equalizer::process(audio::packet& pkt) noexcept
+{
+    auto const x = equalizer_bands().load();
+    if (AMP_UNLIKELY(std::memcmp(&x, &bands, sizeof(x)) != 0)) {
+        bands = x;
+        kernel.set_bands(bands.bands, bands.count);
+    }
+    kernel.process(pkt.data(), pkt.frames());
+}
+
+void equalizer::drain(audio::packet&) noexcept
+{
+}
+
+void equalizer::flush() noexcept
+{
+    kernel.flush();
+}
+
+// The biquads are causal and have no lookahead; their group delay is part
+// of the response, not a delay of the stream.
+uint64 equalizer::get_latency() const noexcept
+{
+    return 0;
+}
+
+void equalizer::reload_() noexcept
+{
+    bands = equalizer_bands().load();
+    kernel.set_bands(bands.bands, bands.count);
+}
+
+AMP_REGISTER_FILTER(
+    equalizer,
+    "amp.filter.equalizer",
+    "Equalizer");
+
+}     // namespace <unnamed>
+
+}}    // namespace amp::audio
@@ -0,0 +1,106 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// plugins/filter/equalizer.hpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef AMP_INCLUDED_0AA2FEE3_2371_43E6_87B8_36B5125BC82E
+#define AMP_INCLUDED_0AA2FEE3_2371_43E6_87B8_36B5125BC82E
+
+
+#include <amp/seqlock.hpp>
+#include <amp/stddef.hpp>
+
+#include <cstddef>
+#include <vector>
+
+
+namespace amp {
+namespace audio {
+
+enum class eq_band_type : uint32 {
+    peaking,
+    low_shelf,
+    high_shelf,
+};
+
+struct eq_band
+{
+    eq_band_type type;
+    float frequency;    // Hz
+    float gain;         // dB
+    float q;
+};
+
+constexpr std::size_t max_eq_bands = 16;
+
+struct eq_preset
+{
+    uint32 count;
+    eq_band bands[max_eq_bands];
+};
+
+// The bands of every equalizer instance; flat until something stores to it.
+// Each filter reads it before every packet. Stores must come from one
+// thread at a time.
+seqlock<eq_preset>& equalizer_bands() noexcept;
+
+
+// -- Overview --
+//
+// A cascade of RBJ biquads in transposed direct form II. Each band runs over
+// all channels at once, one channel per vector lane (4 lanes with SSE, 8 with
+// AVX), so there is no serial dependency between channels; bands are run in
+// pairs over blocks of frames that stay in L1, so that the next band's
+// recurrence overlaps with the current one's.
+//
+// Channel counts that are not a multiple of the vector width are padded into
+// a scratch block; the scratch and the filter state are only (re)allocated
+// by calibrate, never while processing.
+
+class equalizer_kernel
+{
+public:
+    struct section
+    {
+        float b0, b1, b2, a1, a2;
+        uint32 slot;            // index of the band's filter state
+    };
+
+    using kernel = void(float*, std::size_t frames, std::size_t stride,
+                        section const*, std::size_t count,
+                        float* state) noexcept;
+
+    static constexpr std::size_t block_frames = 256;
+
+    void calibrate(uint32 rate, uint32 channels);
+
+    // Recomputes the coefficients; does not allocate.
+    void set_bands(eq_band const* bands, std::size_t count) noexcept;
+
+    // Filters `frames` interleaved frames in place.
+    void process(float* samples, std::size_t frames) noexcept;
+
+    void flush() noexcept;
+
+    std::size_t active_bands() const noexcept
+    { return section_count_; }
+
+private:
+    section sections_[max_eq_bands]{};
+    std::size_t section_count_{};
+
+    std::vector<float> state_;      // [band][s1, s2][stride]
+    std::vector<float> scratch_;    // [block_frames][stride]
+    uint32 rate_{};
+    uint32 channels_{};
+    uint32 stride_{};               // channels rounded up to `width_`
+    uint32 width_{1};
+    kernel* kernel_{};
+};
+
+}}    // namespace amp::audio
+
+
+#endif  // AMP_INCLUDED_0AA2FEE3_2371_43E6_87B8_36B5125BC82E
@@ -0,0 +1,342 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// plugins/filter/equalizer_kernel.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/bitops.hpp>
+#include <amp/numeric.hpp>
+#include <amp/range.hpp>
+#include <amp/stddef.hpp>
+
+#include "equalizer.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+
+namespace amp {
+namespace audio {
+namespace {
+
+using section = equalizer_kernel::section;
+
+
+// Robert Bristow-Johnson's cookbook formulae, normalized by a0.
+section design(eq_band const& band, uint32 const rate) noexcept
+{
+    auto const fs = static_cast<double>(rate);
+    auto const f0 = std::min(static_cast<double>(band.frequency), fs * .45);
+    auto const A  = std::pow(10., static_cast<double>(band.gain) / 40.);
+    auto const w0 = 2. * pi<double> * f0 / fs;
+    auto const cs = std::cos(w0);
+    auto const alpha = std::sin(w0) / (2. * static_cast<double>(band.q));
+    auto const beta  = 2. * std::sqrt(A) * alpha;
+
+    double b0, b1, b2, a0, a1, a2;
+    switch (band.type) {
+    case eq_band_type::low_shelf:
+        b0 =      A * ((A + 1) - (A - 1) * cs + beta);
+        b1 = 2. * A * ((A - 1) - (A + 1) * cs);
+        b2 =      A * ((A + 1) - (A - 1) * cs - beta);
+        a0 =            (A + 1) + (A - 1) * cs + beta;
+        a1 =     -2. * ((A - 1) + (A + 1) * cs);
+        a2 =            (A + 1) + (A - 1) * cs - beta;
+        break;
+    case eq_band_type::high_shelf:
+        b0 =       A * ((A + 1) + (A - 1) * cs + beta);
+        b1 = -2. * A * ((A - 1) + (A + 1) * cs);
+        b2 =       A * ((A + 1) + (A - 1) * cs - beta);
+        a0 =             (A + 1) - (A - 1) * cs + beta;
+        a1 =       2. * ((A - 1) - (A + 1) * cs);
+        a2 =             (A + 1) - (A - 1) * cs - beta;
+        break;
+    default:
+        b0 = 1. + alpha * A;
+        b1 = -2. * cs;
+        b2 = 1. - alpha * A;
+        a0 = 1. + alpha / A;
+        a1 = -2. * cs;
+        a2 = 1. - alpha / A;
+        break;
+    }
+
+    section s;
+    s.b0 = static_cast<float>(b0 / a0);
+    s.b1 = static_cast<float>(b1 / a0);
+    s.b2 = static_cast<float>(b2 / a0);
+    s.a1 = static_cast<float>(a1 / a0);
+    s.a2 = static_cast<float>(a2 / a0);
+    s.slot = 0;
+    return s;
+}
+
+// A band with (almost) no gain is the identity, whatever its type.
+bool is_active(eq_band const& band, uint32 const rate) noexcept
+{
+    return std::abs(band.gain) >= .01f
+        && band.q > 0.f
+        && band.frequency > 0.f
+        && band.frequency < static_cast<float>(rate) * .5f;
+}
+
+
+void run_generic(float* const p, std::size_t const n, std::size_t const stride,
+                 section const* const sec, std::size_t const count,
+                 float* const state) noexcept
+{
+    for (auto const k : xrange(count)) {
+        auto const& s = sec[k];
+        auto const z1 = &state[s.slot * 2 * stride];
+        auto const z2 = z1 + stride;
+
+        for (auto const t : xrange(n)) {
+            for (auto const c : xrange(stride)) {
+                auto const x = p[t * stride + c];
+                auto const y = s.b0 * x + z1[c];
+                z1[c] = s.b1 * x - s.a1 * y + z2[c];
+                z2[c] = s.b2 * x - s.a2 * y;
+                p[t * stride + c] = y;
+            }
+        }
+    }
+}
+
+#if defined(AMP_FILTER_SSE2)
+
+struct biquad_sse
+{
+    AMP_TARGET("sse2")
+    biquad_sse(section const& s, float* const st, std::size_t const stride,
+               std::size_t const g) noexcept :
+        b0{_mm_set1_ps(s.b0)},
+        b1{_mm_set1_ps(s.b1)},
+        b2{_mm_set1_ps(s.b2)},
+        a1{_mm_set1_ps(s.a1)},
+        a2{_mm_set1_ps(s.a2)},
+        z1{&st[s.slot * 2 * stride + g]},
+        z2{z1 + stride},
+        u1{_mm_loadu_ps(z1)},
+        u2{_mm_loadu_ps(z2)}
+    {}
+
+    AMP_TARGET("sse2")
+    AMP_INLINE __m128 operator()(__m128 const x) noexcept
+    {
+        auto const y = _mm_add_ps(_mm_mul_ps(b0, x), u1);
+        u1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), u2);
+        u2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+        return y;
+    }
+
+    AMP_TARGET("sse2")
+    void save() const noexcept
+    {
+        _mm_storeu_ps(z1, u1);
+        _mm_storeu_ps(z2, u2);
+    }
+
+    __m128 b0, b1, b2, a1, a2;
+    float* z1;
+    float* z2;
+    __m128 u1, u2;
+};
+
+AMP_TARGET("sse2")
+void run_sse2(float* const p, std::size_t const n, std::size_t const stride,
+              section const* const sec, std::size_t const count,
+              float* const state) noexcept
+{
+    for (auto g = 0_sz; g != stride; g += 4) {
+        auto k = 0_sz;
+        for (; k + 2 <= count; k += 2) {
+            biquad_sse f{sec[k + 0], state, stride, g};
+            biquad_sse h{sec[k + 1], state, stride, g};
+            for (auto const t : xrange(n)) {
+                auto const q = &p[t * stride + g];
+                _mm_storeu_ps(q, h(f(_mm_loadu_ps(q))));
+            }
+            f.save();
+            h.save();
+        }
+        if (k != count) {
+            biquad_sse f{sec[k], state, stride, g};
+            for (auto const t : xrange(n)) {
+                auto const q = &p[t * stride + g];
+                _mm_storeu_ps(q, f(_mm_loadu_ps(q)));
+            }
+            f.save();
+        }
+    }
+}
+
+
+struct biquad_avx
+{
+    AMP_TARGET("avx")
+    biquad_avx(section const& s, float* const st, std::size_t const stride,
+               std::size_t const g) noexcept :
+        b0{_mm256_set1_ps(s.b0)},
+        b1{_mm256_set1_ps(s.b1)},
+        b2{_mm256_set1_ps(s.b2)},
+        a1{_mm256_set1_ps(s.a1)},
+        a2{_mm256_set1_ps(s.a2)},
+        z1{&st[s.slot * 2 * stride + g]},
+        z2{z1 + stride},
+        u1{_mm256_loadu_ps(z1)},
+        u2{_mm256_loadu_ps(z2)}
+    {}
+
+    AMP_TARGET("avx")
+    AMP_INLINE __m256 operator()(__m256 const x) noexcept
+    {
+        auto const y = _mm256_add_ps(_mm256_mul_ps(b0, x), u1);
+        u1 = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(b1, x),
+                                         _mm256_mul_ps(a1, y)), u2);
+        u2 = _mm256_sub_ps(_mm256_mul_ps(b2, x), _mm256_mul_ps(a2, y));
+        return y;
+    }
+
+    AMP_TARGET("avx")
+    void save() const noexcept
+    {
+        _mm256_storeu_ps(z1, u1);
+        _mm256_storeu_ps(z2, u2);
+    }
+
+    __m256 b0, b1, b2, a1, a2;
+    float* z1;
+    float* z2;
+    __m256 u1, u2;
+};
+
+AMP_TARGET("avx")
+void run_avx(float* const p, std::size_t const n, std::size_t const stride,
+             section const* const sec, std::size_t const count,
+             float* const state) noexcept
+{
+    for (auto g = 0_sz; g != stride; g += 8) {
+        auto k = 0_sz;
+        for (; k + 2 <= count; k += 2) {
+            biquad_avx f{sec[k + 0], state, stride, g};
+            biquad_avx h{sec[k + 1], state, stride, g};
+            for (auto const t : xrange(n)) {
+                auto const q = &p[t * stride + g];
+                _mm256_storeu_ps(q, h(f(_mm256_loadu_ps(q))));
+            }
+            f.save();
+            h.save();
+        }
+        if (k != count) {
+            biquad_avx f{sec[k], state, stride, g};
+            for (auto const t : xrange(n)) {
+                auto const q = &p[t * stride + g];
+                _mm256_storeu_ps(q, f(_mm256_loadu_ps(q)));
+            }
+            f.save();
+        }
+    }
+}
+
+#endif  // AMP_FILTER_SSE2
+
+}     // namespace <unnamed>
+
+
+void equalizer_kernel::calibrate(uint32 const rate, uint32 const channels)
+{
+    width_ = 1;
+    kernel_ = &run_generic;
+
+#if defined(AMP_FILTER_SSE2)
+    // A stereo or quad stream only fills half an AVX register.
+    if (channels > 4 && has_avx()) {
+        width_ = 8;
+        kernel_ = &run_avx;
+    }
+    else {
+        width_ = 4;
+        kernel_ = &run_sse2;
+    }
+#endif
+
+    rate_ = rate;
+    channels_ = channels;
+    stride_ = static_cast<uint32>(align_up(channels, width_));
+    section_count_ = 0;
+
+    state_.assign(max_eq_bands * 2 * stride_, 0.f);
+    scratch_.assign((stride_ != channels_) ? block_frames * stride_ : 0, 0.f);
+}
+
+void equalizer_kernel::set_bands(eq_band const* const bands,
+                                 std::size_t const count) noexcept
+{
+    uint32 was_active = 0;
+    for (auto const k : xrange(section_count_)) {
+        was_active |= uint32{1} << sections_[k].slot;
+    }
+
+    section_count_ = 0;
+    for (auto const i : xrange(std::min(count, max_eq_bands))) {
+        if (!is_active(bands[i], rate_)) {
+            continue;
+        }
+
+        // A band that was bypassed starts from rest; the others keep their
+        // state so that moving a slider does not click.
+        if (!(was_active & (uint32{1} << i))) {
+            std::fill_n(&state_[i * 2 * stride_], 2 * stride_, 0.f);
+        }
+
+        auto& s = sections_[section_count_++];
+        s = design(bands[i], rate_);
+        s.slot = static_cast<uint32>(i);
+    }
+}
+
+void equalizer_kernel::process(float* const p, std::size_t const frames) noexcept
+{
+    if (section_count_ == 0) {
+        return;
+    }
+
+#if defined(AMP_FILTER_SSE2)
+    denormals_as_zero const daz;
+#endif
+
+    auto const block = std::size_t{block_frames};
+    for (auto i = 0_sz; i < frames; i += block) {
+        auto const n = std::min(frames - i, block);
+        auto const q = &p[i * channels_];
+
+        if (stride_ == channels_) {
+            (*kernel_)(q, n, stride_, sections_, section_count_,
+                       state_.data());
+            continue;
+        }
+
+        // The padding lanes are never written, so they filter silence.
+        auto const s = scratch_.data();
+        for (auto const t : xrange(n)) {
+            std::memcpy(&s[t * stride_], &q[t * channels_],
+                        sizeof(float) * channels_);
+        }
+        (*kernel_)(s, n, stride_, sections_, section_count_, state_.data());
+        for (auto const t : xrange(n)) {
+            std::memcpy(&q[t * channels_], &s[t * stride_],
+                        sizeof(float) * channels_);
+        }
+    }
+}
+
+void equalizer_kernel::flush() noexcept
+{
+    std::fill(state_.begin(), state_.end(), 0.f);
+}
+
+}}    // namespace amp::audio
@@ -0,0 +1,77 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// plugins/filter/loudness_agc.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/filter.hpp>
+#include <amp/audio/format.hpp>
+#include <amp/audio/packet.hpp>
+#include <amp/stddef.hpp>
+
+#include "loudness_agc.hpp"
+
+
+namespace amp {
+namespace audio {
+namespace {
+
+class loudness_agc
+{
+public:
+    void calibrate(audio::format&);
+    void process(audio::packet&) noexcept;
+    void drain(audio::packet&);
+    void flush() noexcept;
+    uint64 get_latency() const noexcept;
+
+private:
+    loudness_agc_kernel kernel;
+    uint32 rate{};
+    uint32 channels{};
+    uint32 layout{};
+};
+
+
+void loudness_agc::calibrate(audio::format& fmt)
+{
+    if (rate == fmt.sample_rate && channels == fmt.channels
+            && layout == fmt.channel_layout) {
+        return;
+    }
+
+    rate = fmt.sample_rate;
+    channels = fmt.channels;
+    layout = fmt.channel_layout;
+    kernel.calibrate(rate, channels, layout);
+}
+
+void loudness_agc::process(audio::packet& pkt) noexcept
+{
+    kernel.process(pkt.data(), pkt.frames());
+}
+
+// Pushes the look-ahead out with as much silence.
+void loudness_agc::drain(audio::packet& pkt)
+{
+    pkt.resize(static_cast<std::size_t>(kernel.latency()) * channels);
+    kernel.process(pkt.data(), pkt.frames());
+}
+
+void loudness_agc::flush() noexcept
+{
+    kernel.flush();
+}
+
+uint64 loudness_agc::get_latency() const noexcept
+{
+    return kernel.latency();
+}
+
+AMP_REGISTER_FILTER(
+    loudness_agc,
+    "amp.filter.loudness_agc",
+    "Loudness Leveler");
+
+}}}   // namespace amp::audio::<unnamed>
@@ -0,0 +1,98 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// plugins/filter/loudness_agc.hpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef AMP_INCLUDED_BD7823E3_568E_4AFC_ADE1_DB3C8AB7417A
+#define AMP_INCLUDED_BD7823E3_568E_4AFC_ADE1_DB3C8AB7417A
+
+
+#include <amp/audio/kweighting.hpp>
+#include <amp/stddef.hpp>
+
+#include <cstddef>
+#include <vector>
+
+
+namespace amp {
+namespace audio {
+
+// -- Overview --
+//
+// Levels a stream towards the ReplayGain 2.0 reference (-18 LUFS) as it
+// plays. The stream is cut into 5ms blocks; each block is K-weighted and
+// its energy kept over the momentary (400ms) and short-term (3s) windows of
+// EBU R128. The gain follows the louder of the two, quickly downwards and
+// slowly upwards, and holds through silence and fades.
+//
+// A limiter keeps the peaks under -1 dBFS. The output lags the input by two
+// blocks, so the gain of each block is known to be safe for the block after
+// it; ramping linearly from one block's gain to the next thus never
+// overshoots. All buffers are sized by calibrate; processing does not
+// allocate.
+
+class loudness_agc_kernel
+{
+public:
+    static constexpr float reference = -18.f;     // LUFS
+
+    void calibrate(uint32 rate, uint32 channels, uint32 channel_layout);
+
+    // Levels `frames` interleaved frames in place, delayed by latency().
+    void process(float* samples, std::size_t frames) noexcept;
+
+    // Clears the delay line and the limiter; the gain is kept, so that a
+    // seek does not make the level jump.
+    void flush() noexcept;
+
+    uint64 latency() const noexcept
+    { return uint64{block_} * 2; }
+
+    // The levelling gain, before the limiter, in dB.
+    float gain() const noexcept
+    { return static_cast<float>(agc_db_); }
+
+private:
+    void end_block_() noexcept;
+    void measure_(float const* block) noexcept;
+    void update_gain_(double energy) noexcept;
+
+    std::vector<float> delay_;      // [2][block][channels]
+    std::vector<float> gains_;      // [block][channels], the output ramp
+    std::vector<float> scratch_;    // [block][stride]
+    std::vector<float> state_;      // [4][stride], K-weighting
+    std::vector<float> weights_;    // [stride]
+    std::vector<double> history_;   // block energies, over 3s
+
+    // Single precision: the error that adds at high rates is far below what
+    // a levelling gain could make audible.
+    kweighting<float> kweighting_{};
+
+    // Running sums of `history_` over the two windows.
+    double short_sum_{};
+    double momentary_sum_{};
+    std::size_t history_pos_{};
+    std::size_t history_count_{};
+    std::size_t momentary_blocks_{};
+
+    double agc_db_{};
+    double attack_{};
+    double release_{};
+    float rise_{};                  // limiter release, per block
+    float gain_{1.f};               // at the end of the current ramp
+    float peak_{};                  // of the previous block
+    bool ramp_{};
+
+    std::size_t fill_{};
+    std::size_t slot_{};
+    uint32 block_{};
+    uint32 channels_{};
+    uint32 stride_{};
+};
+
+}}    // namespace amp::audio
+
+
+#endif  // AMP_INCLUDED_BD7823E3_568E_4AFC_ADE1_DB3C8AB7417A
@@ -0,0 +1,429 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// plugins/filter/loudness_agc_kernel.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/format.hpp>
+#include <amp/audio/kweighting.hpp>
+#include <amp/bitops.hpp>
+#include <amp/numeric.hpp>
+#include <amp/range.hpp>
+#include <amp/stddef.hpp>
+
+#include "loudness_agc.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+
+namespace amp {
+namespace audio {
+namespace {
+
+constexpr double block_seconds     = .005;
+constexpr double momentary_seconds = .4;
+constexpr double short_seconds     = 3.;
+
+constexpr double attack_seconds  = .4;
+constexpr double release_seconds = 3.;
+constexpr double max_boost = 12.;       // dB
+constexpr double max_cut   = 24.;       // dB
+
+// Below this, the stream is taken to be silent or fading, and the gain is
+// held rather than raised.
+constexpr double gate = -50.;           // LUFS
+constexpr double relative_gate = -10.;  // LU
+
+constexpr float ceiling = .891251f;     // -1 dBFS
+constexpr double limiter_release = 60.; // dB/s
+
+
+inline double loudness(double const sum, std::size_t const blocks) noexcept
+{
+    return -0.691 + 10. * std::log10(std::max(sum, 0.)
+                                     / static_cast<double>(blocks));
+}
+
+
+// Outputs the delayed samples, scaled, and delays the input in their place.
+void swap_generic(float* const io, float* const delay, float const gain,
+                  std::size_t const n) noexcept
+{
+    for (auto const i : xrange(n)) {
+        auto const x = io[i];
+        io[i] = delay[i] * gain;
+        delay[i] = x;
+    }
+}
+
+void swap_generic(float* const io, float* const delay,
+                  float const* const gains, std::size_t const n) noexcept
+{
+    for (auto const i : xrange(n)) {
+        auto const x = io[i];
+        io[i] = delay[i] * gains[i];
+        delay[i] = x;
+    }
+}
+
+float peak_generic(float const* const x, std::size_t const n) noexcept
+{
+    auto peak = 0.f;
+    for (auto const i : xrange(n)) {
+        peak = std::max(peak, std::abs(x[i]));
+    }
+    return peak;
+}
+
+#if !defined(AMP_FILTER_SSE2)
+
+// K-weights `frames` frames of `stride` lanes, and returns their weighted
+// sum of squares.
+double kweight_generic(float const* const x, std::size_t const frames,
+                       std::size_t const stride,
+                       kweighting<float> const& kw, float* const state,
+                       float const* const weights) noexcept
+{
+    auto sum = 0.;
+    for (auto const c : xrange(stride)) {
+        auto s1 = state[0 * stride + c];
+        auto s2 = state[1 * stride + c];
+        auto p1 = state[2 * stride + c];
+        auto p2 = state[3 * stride + c];
+        auto acc = 0.f;
+
+        for (auto const t : xrange(frames)) {
+            auto const z = kw(x[t * stride + c], s1, s2, p1, p2);
+            acc += z * z;
+        }
+
+        state[0 * stride + c] = s1;
+        state[1 * stride + c] = s2;
+        state[2 * stride + c] = p1;
+        state[3 * stride + c] = p2;
+        sum += static_cast<double>(acc * weights[c]);
+    }
+    return sum;
+}
+
+#endif  // !AMP_FILTER_SSE2
+
+#if defined(AMP_FILTER_SSE2)
+
+void swap_sse2(float* const io, float* const delay, float const gain,
+               std::size_t const n) noexcept
+{
+    auto const g = _mm_set1_ps(gain);
+    auto i = 0_sz;
+    for (; i + 4 <= n; i += 4) {
+        auto const x = _mm_loadu_ps(&io[i]);
+        _mm_storeu_ps(&io[i], _mm_mul_ps(_mm_loadu_ps(&delay[i]), g));
+        _mm_storeu_ps(&delay[i], x);
+    }
+    swap_generic(&io[i], &delay[i], gain, n - i);
+}
+
+void swap_sse2(float* const io, float* const delay, float const* const gains,
+               std::size_t const n) noexcept
+{
+    auto i = 0_sz;
+    for (; i + 4 <= n; i += 4) {
+        auto const x = _mm_loadu_ps(&io[i]);
+        _mm_storeu_ps(&io[i], _mm_mul_ps(_mm_loadu_ps(&delay[i]),
+                                         _mm_loadu_ps(&gains[i])));
+        _mm_storeu_ps(&delay[i], x);
+    }
+    swap_generic(&io[i], &delay[i], &gains[i], n - i);
+}
+
+float peak_sse2(float const* const x, std::size_t const n) noexcept
+{
+    auto const sign = _mm_set1_ps(-0.f);
+    auto m0 = _mm_setzero_ps();
+    auto m1 = _mm_setzero_ps();
+
+    auto i = 0_sz;
+    for (; i + 8 <= n; i += 8) {
+        m0 = _mm_max_ps(m0, _mm_andnot_ps(sign, _mm_loadu_ps(&x[i + 0])));
+        m1 = _mm_max_ps(m1, _mm_andnot_ps(sign, _mm_loadu_ps(&x[i + 4])));
+    }
+    auto m = _mm_max_ps(m0, m1);
+    m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+    m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 0x55));
+    return std::max(_mm_cvtss_f32(m), peak_generic(&x[i], n - i));
+}
+
+// Four channels to a vector; `stride` is a multiple of four.
+double kweight_sse2(float const* const x, std::size_t const frames,
+                    std::size_t const stride, kweighting<float> const& kw,
+                    float* const state, float const* const weights) noexcept
+{
+    auto const b0 = _mm_set1_ps(kw.shelf[0]);
+    auto const b1 = _mm_set1_ps(kw.shelf[1]);
+    auto const b2 = _mm_set1_ps(kw.shelf[2]);
+    auto const a1 = _mm_set1_ps(kw.shelf[3]);
+    auto const a2 = _mm_set1_ps(kw.shelf[4]);
+    auto const c1 = _mm_set1_ps(kw.pass[3]);
+    auto const c2 = _mm_set1_ps(kw.pass[4]);
+
+    auto sum = _mm_setzero_ps();
+    for (auto c = 0_sz; c != stride; c += 4) {
+        auto s1 = _mm_loadu_ps(&state[0 * stride + c]);
+        auto s2 = _mm_loadu_ps(&state[1 * stride + c]);
+        auto p1 = _mm_loadu_ps(&state[2 * stride + c]);
+        auto p2 = _mm_loadu_ps(&state[3 * stride + c]);
+        auto acc = _mm_setzero_ps();
+
+        for (auto const t : xrange(frames)) {
+            auto const v = _mm_loadu_ps(&x[t * stride + c]);
+
+            auto const y = _mm_add_ps(_mm_mul_ps(b0, v), s1);
+            s1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, v),
+                                       _mm_mul_ps(a1, y)), s2);
+            s2 = _mm_sub_ps(_mm_mul_ps(b2, v), _mm_mul_ps(a2, y));
+
+            auto const z = _mm_add_ps(y, p1);
+            p1 = _mm_sub_ps(_mm_sub_ps(p2, _mm_add_ps(y, y)),
+                            _mm_mul_ps(c1, z));
+            p2 = _mm_sub_ps(y, _mm_mul_ps(c2, z));
+
+            acc = _mm_add_ps(acc, _mm_mul_ps(z, z));
+        }
+
+        _mm_storeu_ps(&state[0 * stride + c], s1);
+        _mm_storeu_ps(&state[1 * stride + c], s2);
+        _mm_storeu_ps(&state[2 * stride + c], p1);
+        _mm_storeu_ps(&state[3 * stride + c], p2);
+        sum = _mm_add_ps(sum, _mm_mul_ps(acc, _mm_loadu_ps(&weights[c])));
+    }
+
+    float lanes[4];
+    _mm_storeu_ps(lanes, sum);
+    return (double{lanes[0]} + double{lanes[1]})
+         + (double{lanes[2]} + double{lanes[3]});
+}
+
+#endif  // AMP_FILTER_SSE2
+
+
+// SSE2 is part of x86-64, so there is nothing to detect at run time.
+template<typename Gain>
+inline void swap(float* const io, float* const delay, Gain const gain,
+                 std::size_t const n) noexcept
+{
+#if defined(AMP_FILTER_SSE2)
+    swap_sse2(io, delay, gain, n);
+#else
+    swap_generic(io, delay, gain, n);
+#endif
+}
+
+inline float peak(float const* const x, std::size_t const n) noexcept
+{
+#if defined(AMP_FILTER_SSE2)
+    return peak_sse2(x, n);
+#else
+    return peak_generic(x, n);
+#endif
+}
+
+inline double kweight(float const* const x, std::size_t const frames,
+                      std::size_t const stride, kweighting<float> const& kw,
+                      float* const state, float const* const weights) noexcept
+{
+#if defined(AMP_FILTER_SSE2)
+    return kweight_sse2(x, frames, stride, kw, state, weights);
+#else
+    return kweight_generic(x, frames, stride, kw, state, weights);
+#endif
+}
+
+}     // namespace <unnamed>
+
+
+void loudness_agc_kernel::calibrate(uint32 const rate, uint32 const channels,
+                                    uint32 const channel_layout)
+{
+    auto const fs = static_cast<double>(rate);
+
+    block_ = std::max(static_cast<uint32>(fs * block_seconds), uint32{1});
+    channels_ = channels;
+    stride_ = static_cast<uint32>(align_up(channels, 4));
+
+    delay_.assign(2_sz * block_ * channels_, 0.f);
+    gains_.assign(std::size_t{block_} * channels_, 1.f);
+    scratch_.assign(std::size_t{block_} * stride_, 0.f);
+    state_.assign(4_sz * stride_, 0.f);
+
+    // Padding lanes, and layouts that do not describe every channel, weigh
+    // nothing and as much as a front channel respectively.
+    weights_.assign(stride_, 0.f);
+    auto layout = channel_layout;
+    for (auto const c : xrange(channels_)) {
+        auto const bit = layout & (~layout + 1);
+        weights_[c] = kweighting_channel_weight<float>(bit);
+        layout &= ~bit;
+    }
+
+    kweighting_.design(fs);
+
+    auto const block = static_cast<double>(block_) / fs;
+    history_.assign(std::max(static_cast<std::size_t>(
+        std::lround(short_seconds / block)), 1_sz), 0.);
+    momentary_blocks_ = std::clamp(static_cast<std::size_t>(
+        std::lround(momentary_seconds / block)), 1_sz, history_.size());
+    short_sum_ = 0.;
+    momentary_sum_ = 0.;
+    history_pos_ = 0;
+    history_count_ = 0;
+
+    agc_db_ = 0.;
+    attack_ = 1. - std::exp(-block / attack_seconds);
+    release_ = 1. - std::exp(-block / release_seconds);
+    rise_ = static_cast<float>(std::pow(10., limiter_release * block / 20.));
+
+    flush();
+}
+
+void loudness_agc_kernel::process(float* samples, std::size_t frames) noexcept
+{
+#if defined(AMP_FILTER_SSE2)
+    denormals_as_zero const daz;
+#endif
+
+    while (frames != 0) {
+        auto const n = std::min(frames, block_ - fill_);
+        auto const count = n * channels_;
+        auto const delay = &delay_[(slot_ * block_ + fill_) * channels_];
+
+        if (ramp_) {
+            swap(samples, delay, &gains_[fill_ * channels_], count);
+        }
+        else {
+            swap(samples, delay, gain_, count);
+        }
+
+        samples += count;
+        frames -= n;
+        fill_ += n;
+
+        if (fill_ == block_) {
+            end_block_();
+            fill_ = 0;
+            slot_ ^= 1;
+        }
+    }
+}
+
+void loudness_agc_kernel::flush() noexcept
+{
+    std::fill(delay_.begin(), delay_.end(), 0.f);
+    std::fill(state_.begin(), state_.end(), 0.f);
+
+    gain_ = static_cast<float>(std::pow(10., agc_db_ / 20.));
+    peak_ = 0.f;
+    ramp_ = false;
+    fill_ = 0;
+    slot_ = 0;
+}
+
+// The slot that was just filled holds block `m`; the other holds block
+// `m - 1`, which is output next, while block `m + 1` comes in.
+void loudness_agc_kernel::end_block_() noexcept
+{
+    auto const block = &delay_[slot_ * block_ * channels_];
+    auto const block_peak = peak(block, std::size_t{block_} * channels_);
+    measure_(block);
+
+    // The gain at the end of block `m - 1` must also be safe for the start
+    // of block `m`, and the one it ramps from was made safe for all of
+    // block `m - 1` in turn.
+    auto const loudest = std::max(block_peak, peak_);
+    auto gain = std::min(static_cast<float>(std::pow(10., agc_db_ / 20.)),
+                         gain_ * rise_);
+    if (loudest * gain > ceiling) {
+        gain = ceiling / loudest;
+    }
+    peak_ = block_peak;
+
+#if __has_warning("-Wfloat-equal")
+# pragma clang diagnostic push
+# pragma clang diagnostic ignored "-Wfloat-equal"
+#endif
+    ramp_ = (gain != gain_);
+#if __has_warning("-Wfloat-equal")
+# pragma clang diagnostic pop
+#endif
+
+    if (ramp_) {
+        auto const step = (gain - gain_) / static_cast<float>(block_);
+        for (auto const t : xrange(std::size_t{block_})) {
+            auto const g = gain_ + step * static_cast<float>(t + 1);
+            std::fill_n(&gains_[t * channels_], channels_, g);
+        }
+    }
+    gain_ = gain;
+}
+
+void loudness_agc_kernel::measure_(float const* const block) noexcept
+{
+    auto const s = scratch_.data();
+    for (auto const t : xrange(std::size_t{block_})) {
+        std::memcpy(&s[t * stride_], &block[t * channels_],
+                    sizeof(float) * channels_);
+    }
+
+    auto const energy = kweight(s, block_, stride_, kweighting_,
+                                state_.data(), weights_.data());
+    update_gain_(energy / static_cast<double>(block_));
+}
+
+void loudness_agc_kernel::update_gain_(double const energy) noexcept
+{
+    auto const n = history_.size();
+    if (history_count_ >= momentary_blocks_) {
+        auto const oldest = (history_pos_ + n - momentary_blocks_) % n;
+        momentary_sum_ -= history_[oldest];
+    }
+    if (history_count_ == n) {
+        short_sum_ -= history_[history_pos_];
+    }
+    else {
+        history_count_ += 1;
+    }
+
+    history_[history_pos_] = energy;
+    history_pos_ = (history_pos_ + 1) % n;
+    short_sum_ += energy;
+    momentary_sum_ += energy;
+
+    auto const momentary = loudness(momentary_sum_, std::min(
+        history_count_, momentary_blocks_));
+    auto const short_term = loudness(short_sum_, history_count_);
+
+    // Pauses and fade-outs empty the momentary window long before the
+    // short-term one; the gain holds until the signal is back.
+    if (!(momentary >= gate)) {
+        return;
+    }
+
+    // Attacks follow the momentary loudness, and releases the short-term;
+    // releases wait while the signal falls away, as the relative gate of
+    // R128 would.
+    auto const target = std::clamp(double{reference}
+                                   - std::max(momentary, short_term),
+                                   -max_cut, max_boost);
+    if (target < agc_db_) {
+        agc_db_ += (target - agc_db_) * attack_;
+    }
+    else if (momentary >= short_term + relative_gate) {
+        agc_db_ += (target - agc_db_) * release_;
+    }
+}
+
+}}    // namespace amp::audio
@@ -26,6 +26,7 @@ public:
     void drain(audio::packet&) noexcept;
     void flush() noexcept;
     uint64 get_latency() const noexcept;
+    bool get_matrix(audio::frame_matrix&) const noexcept;
 };
 
 void reverse_stereo::calibrate(audio::format& fmt)
@@ -57,6 +58,16 @@ uint64 reverse_stereo::get_latency() const noexcept
     return 0;
 }
 
+bool reverse_stereo::get_matrix(audio::frame_matrix& m) const noexcept
+{
+    static constexpr float swap[2][2] {
+        { 0.f, 1.f },
+        { 1.f, 0.f },
+    };
+    m = {2, 2, &swap[0][0], 2};
+    return true;
+}
+
 AMP_REGISTER_FILTER(
     reverse_stereo,
     "amp.filter.reversestereo",
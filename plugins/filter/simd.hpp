@@ -0,0 +1,75 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// plugins/filter/simd.hpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef AMP_INCLUDED_6BF560D7_9E88_48A1_A483_1EFC655254B4
+#define AMP_INCLUDED_6BF560D7_9E88_48A1_A483_1EFC655254B4
+
+
+#include <amp/stddef.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64)
+# define AMP_FILTER_SSE2
+# include <immintrin.h>
+#endif
+
+
+namespace amp {
+namespace audio {
+
+#if defined(AMP_FILTER_SSE2)
+
+// Recursive filters decay into denormals whenever the input goes silent,
+// which is slow on x86; this flushes them to zero while in scope.
+class denormals_as_zero
+{
+public:
+    denormals_as_zero() noexcept :
+        csr_{_mm_getcsr()}
+    {
+        _mm_setcsr(csr_ | 0x8040);      // FTZ | DAZ
+    }
+
+    ~denormals_as_zero()
+    { _mm_setcsr(csr_); }
+
+    denormals_as_zero(denormals_as_zero const&) = delete;
+    denormals_as_zero& operator=(denormals_as_zero const&) = delete;
+
+private:
+    unsigned csr_;
+};
+
+
+// Plugins cannot see the core's CPU feature detection.
+inline bool has_avx() noexcept
+{
+#if defined(__AVX__)
+    return true;
+#elif defined(__GNUC__)
+    return __builtin_cpu_supports("avx");
+#else
+    return false;
+#endif
+}
+
+inline bool has_avx2() noexcept
+{
+#if defined(__AVX2__)
+    return true;
+#elif defined(__GNUC__)
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+#endif  // AMP_FILTER_SSE2
+
+}}    // namespace amp::audio
+
+
+#endif  // AMP_INCLUDED_6BF560D7_9E88_48A1_A483_1EFC655254B4
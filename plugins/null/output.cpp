@@ -0,0 +1,297 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// plugins/null/output.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/format.hpp>
+#include <amp/audio/output.hpp>
+#include <amp/error.hpp>
+#include <amp/functional.hpp>
+#include <amp/numeric.hpp>
+#include <amp/ref_ptr.hpp>
+#include <amp/stddef.hpp>
+#include <amp/u8string.hpp>
+
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <ratio>
+#include <string_view>
+#include <thread>
+
+
+namespace amp {
+namespace null {
+namespace {
+
+// -- Overview --
+//
+// An output that discards everything it is fed. A timer thread pulls one
+// period at a time from the player (in place, if started with start_pull),
+// either paced by the wall clock, or as fast as possible (yielding between
+// periods) to measure how far the whole pipeline can run ahead of real time.
+//
+// The device UID selects the clock, optionally followed by a comma separated
+// list of settings, e.g. "fast:rate=96000,channels=6,period=256".
+
+enum class clock : uint8 {
+    realtime,
+    fast,
+};
+
+struct device_config
+{
+    clock  clock_type{clock::realtime};
+    uint32 sample_rate{48000};
+    uint32 channels{2};
+    uint32 period{512};
+};
+
+constexpr std::string_view realtime_uid{"realtime"};
+constexpr std::string_view fast_uid{"fast"};
+
+
+uint32 parse_value(std::string_view const key, std::string_view const value,
+                   uint32 const min, uint32 const max)
+{
+    uint32 x{};
+    auto const last = value.data() + value.size();
+    auto const ret = std::from_chars(value.data(), last, x);
+    if (ret.ec != std::errc{} || ret.ptr != last || x < min || x > max) {
+        raise(errc::invalid_argument,
+              "null output: invalid value for '%.*s': '%.*s'",
+              static_cast<int>(key.size()), key.data(),
+              static_cast<int>(value.size()), value.data());
+    }
+    return x;
+}
+
+device_config parse_config(std::string_view uid)
+{
+    device_config config;
+
+    auto const colon = uid.find(':');
+    auto const name = uid.substr(0, colon);
+    if (name == fast_uid) {
+        config.clock_type = clock::fast;
+    }
+    else if (!name.empty() && name != realtime_uid) {
+        raise(errc::invalid_argument, "null output: unknown device '%.*s'",
+              static_cast<int>(name.size()), name.data());
+    }
+
+    uid = (colon != uid.npos) ? uid.substr(colon + 1) : std::string_view{};
+    while (!uid.empty()) {
+        auto const comma = uid.find(',');
+        auto const item = uid.substr(0, comma);
+        uid = (comma != uid.npos) ? uid.substr(comma + 1) : std::string_view{};
+
+        auto const equals = item.find('=');
+        auto const key = item.substr(0, equals);
+        auto const value = (equals != item.npos) ? item.substr(equals + 1)
+                                                 : std::string_view{};
+        if (key == "rate") {
+            config.sample_rate = parse_value(key, value,
+                                             audio::min_sample_rate,
+                                             audio::max_sample_rate);
+        }
+        else if (key == "channels") {
+            config.channels = parse_value(key, value,
+                                          audio::min_channels,
+                                          audio::max_channels);
+        }
+        else if (key == "period") {
+            config.period = parse_value(key, value, 1, 1 << 16);
+        }
+        else {
+            raise(errc::invalid_argument, "null output: unknown key '%.*s'",
+                  static_cast<int>(key.size()), key.data());
+        }
+    }
+    return config;
+}
+
+
+class output_stream final :
+    public implement_ref_count<output_stream, audio::output_stream>
+{
+public:
+    explicit output_stream(device_config const& config) :
+        config_(config),
+        buffer_(std::make_unique<float[]>(config.period * config.channels))
+    {}
+
+    ~output_stream()
+    {
+        stop_thread();
+    }
+
+    void start(function_view<void(float*, uint32)> const f) override
+    {
+        stop_thread();
+        feed_ = f;
+        source_ = nullptr;
+        start_thread();
+    }
+
+    bool start_pull(audio::output_source& src) override
+    {
+        stop_thread();
+        feed_ = {};
+        source_ = &src;
+        start_thread();
+        return true;
+    }
+
+    void stop() override
+    {
+        stop_thread();
+        feed_ = {};
+        source_ = nullptr;
+    }
+
+    void pause() override
+    {
+        stop_thread();
+    }
+
+    void flush() override
+    {
+    }
+
+    void set_volume(float const volume) override
+    {
+        volume_.store(volume, std::memory_order_relaxed);
+    }
+
+    float get_volume() override
+    {
+        return volume_.load(std::memory_order_relaxed);
+    }
+
+    audio::format get_format() override
+    {
+        audio::format format;
+        format.channels       = config_.channels;
+        format.channel_layout = audio::guess_channel_layout(format.channels);
+        format.sample_rate    = config_.sample_rate;
+        return format;
+    }
+
+    uint64 get_latency() noexcept override
+    {
+        return 0;
+    }
+
+private:
+    void start_thread()
+    {
+        running_.store(true, std::memory_order_relaxed);
+        thread_ = std::thread{[this]() noexcept { run(); }};
+    }
+
+    void stop_thread() noexcept
+    {
+        running_.store(false, std::memory_order_relaxed);
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    void run() noexcept
+    {
+        using clock_type = std::chrono::steady_clock;
+
+        // Deadlines are derived from the total number of frames rendered
+        // since starting, so that rounding errors never accumulate.
+        auto const epoch = clock_type::now();
+        uint64 frames{};
+
+        while (running_.load(std::memory_order_relaxed)) {
+            if (source_ != nullptr) {
+                // Consumed in place; there is nothing to do with the samples.
+                auto n = config_.period;
+                (void)source_->acquire(n);
+                source_->release(n);
+            }
+            else {
+                feed_(buffer_.get(), config_.period);
+            }
+            frames += config_.period;
+
+            if (config_.clock_type == clock::fast) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            auto const deadline = epoch + std::chrono::nanoseconds{
+                muldiv(frames, std::nano::den, config_.sample_rate)};
+            std::this_thread::sleep_until(deadline);
+        }
+    }
+
+    device_config const config_;
+    std::unique_ptr<float[]> const buffer_;
+    function_view<void(float*, uint32)> feed_;
+    audio::output_source* source_{};
+    std::atomic<float> volume_{1.f};
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
+
+
+class output_device_list final :
+    public implement_ref_count<output_device_list, audio::output_device_list>
+{
+public:
+    uint32 get_count() noexcept override
+    { return 2; }
+
+    audio::output_device get_device(uint32 const index) override
+    {
+        switch (index) {
+        case 0:
+            return {to_u8string(realtime_uid),
+                    to_u8string("Null (real time)")};
+        case 1:
+            return {to_u8string(fast_uid),
+                    to_u8string("Null (as fast as possible)")};
+        }
+        raise(errc::out_of_bounds);
+    }
+
+    audio::output_device get_default_device() override
+    { return get_device(0); }
+};
+
+
+class output_session final :
+    public implement_ref_count<output_session, audio::output_session>
+{
+public:
+    ref_ptr<audio::output_device_list> get_devices() override
+    {
+        return output_device_list::make();
+    }
+
+    ref_ptr<audio::output_stream> activate(u8string const& uid) override
+    {
+        return output_stream::make(parse_config({uid.data(), uid.size()}));
+    }
+
+    void set_delegate(audio::output_session_delegate*) noexcept override
+    {
+    }
+};
+
+
+AMP_REGISTER_OUTPUT(
+    output_session,
+    "amp.output.null",
+    "Null output");
+
+}}}   // namespace amp::null::<unnamed>
@@ -10,6 +10,7 @@
 #include <amp/audio/packet.hpp>
 #include <amp/error.hpp>
 #include <amp/numeric.hpp>
+#include <amp/range.hpp>
 #include <amp/stddef.hpp>
 #include <amp/type_traits.hpp>
 
@@ -17,6 +18,8 @@
 #include <cmath>
 #include <cstddef>
 #include <memory>
+#include <thread>
+#include <vector>
 
 #include <soxr.h>
 
@@ -46,6 +49,51 @@ inline void verify(::soxr_error_t const error)
 }
 
 
+// Packets are sized for this many frames up front, which covers what the
+// player and the decoders produce; larger ones grow the buffers once.
+constexpr std::size_t reserve_frames = 4096;
+
+// Each recipe's filter is about twice as long as the one below it, so its
+// cost per sample doubles.
+constexpr unsigned long recipes[] {
+    SOXR_QQ, SOXR_LQ, SOXR_MQ, SOXR_HQ, SOXR_VHQ,
+};
+
+constexpr uint64 recipe_cost(std::size_t const level) noexcept
+{
+    return uint64{1} << level;
+}
+
+// What one thread may spend: very high quality stereo at 192 kHz. 8 channels
+// at 384 kHz need twice that even at medium quality.
+constexpr uint64 cost_budget = uint64{2} * 192000 * recipe_cost(4);
+
+struct plan
+{
+    unsigned long recipe;
+    uint32 threads;
+};
+
+// Splits the channels across threads once the requested quality is more
+// than one thread's budget, and only then lowers the quality, one recipe
+// at a time, until each thread is within budget.
+plan make_plan(std::size_t level, uint32 const irate, uint32 const orate,
+               uint32 const channels)
+{
+    auto const load = uint64{channels} * std::max(irate, orate);
+
+    auto threads = uint32{1};
+    if (load * recipe_cost(level) > cost_budget) {
+        auto const cores = std::max(std::thread::hardware_concurrency(), 2u);
+        threads = std::max(1u, std::min(channels, cores / 2));
+    }
+    while (level != 0 && load * recipe_cost(level) / threads > cost_budget) {
+        --level;
+    }
+    return {recipes[level], threads};
+}
+
+
 class resampler
 {
 public:
@@ -59,12 +107,23 @@ public:
     void set_quality(uint8);
 
 private:
+    void process_split_(audio::packet&, std::size_t ilen, std::size_t olen);
+
     std::unique_ptr<::soxr> handle_;
     audio::packet in_pkt_;
+
+    // With more than one thread, soxr works on each channel separately;
+    // handing it split channels saves it from deinterleaving them again.
+    std::vector<float> in_planes_;
+    std::vector<float> out_planes_;
+    std::vector<float const*> in_ptrs_;
+    std::vector<float*> out_ptrs_;
+
     uint32 irate_{};
     uint32 orate_{};
     uint32 channels_{};
-    uint32 quality_{};
+    uint32 threads_{};
+    std::size_t level_{2};
 };
 
 void resampler::set_sample_rate(uint32 const x)
@@ -75,12 +134,12 @@ void resampler::set_sample_rate(uint32 const x)
 void resampler::set_quality(uint8 const x)
 {
     switch (x) {
-    case audio::quality_minimum: quality_ = SOXR_QQ;  break;
-    case audio::quality_low:     quality_ = SOXR_LQ;  break;
-    case audio::quality_medium:  quality_ = SOXR_MQ;  break;
-    case audio::quality_high:    quality_ = SOXR_HQ;  break;
-    case audio::quality_maximum: quality_ = SOXR_VHQ; break;
-    default:                     quality_ = SOXR_MQ;  break;
+    case audio::quality_minimum: level_ = 0; break;
+    case audio::quality_low:     level_ = 1; break;
+    case audio::quality_medium:  level_ = 2; break;
+    case audio::quality_high:    level_ = 3; break;
+    case audio::quality_maximum: level_ = 4; break;
+    default:                     level_ = 2; break;
     }
 }
 
@@ -89,16 +148,32 @@ void resampler::calibrate(audio::format& fmt)
     irate_ = fmt.sample_rate;
     channels_ = fmt.channels;
 
+    auto const p = make_plan(level_, irate_, orate_, channels_);
+    threads_ = p.threads;
+
+    auto const type = (threads_ > 1) ? SOXR_FLOAT32_S : SOXR_FLOAT32_I;
     auto const quality_flags = SOXR_ROLLOFF_NONE | SOXR_HI_PREC_CLOCK;
-    auto const quality_spec = ::soxr_quality_spec(quality_, quality_flags);
-    auto const io_spec = ::soxr_io_spec(SOXR_FLOAT32_I, SOXR_FLOAT32_I);
+    auto const quality_spec = ::soxr_quality_spec(p.recipe, quality_flags);
+    auto const io_spec = ::soxr_io_spec(type, type);
+    auto const runtime_spec = ::soxr_runtime_spec(threads_);
 
     ::soxr_error_t error{};
     handle_.reset(::soxr_create(static_cast<double>(irate_),
                                 static_cast<double>(orate_),
                                 channels_, &error, &io_spec,
-                                &quality_spec, nullptr));
+                                &quality_spec, &runtime_spec));
     verify(error);
+
+    auto const max_out = muldiv(reserve_frames, orate_, irate_) + 1;
+    if (threads_ > 1) {
+        in_planes_.resize(reserve_frames * channels_);
+        out_planes_.resize(max_out * channels_);
+        in_ptrs_.resize(channels_);
+        out_ptrs_.resize(channels_);
+    }
+    else {
+        in_pkt_.reserve(reserve_frames * channels_);
+    }
     fmt.sample_rate = orate_;
 }
 
@@ -108,12 +183,17 @@ void resampler::process(audio::packet& out_pkt)
         return;
     }
 
-    out_pkt.swap(in_pkt_);
-    out_pkt.set_channel_layout(in_pkt_.channel_layout());
-
-    auto const ilen = in_pkt_.frames();
+    auto const ilen = out_pkt.frames();
     auto const olen = std::max<std::size_t>(muldiv(ilen, orate_, irate_), 1);
-    out_pkt.resize(olen * channels_);
+    if (threads_ > 1) {
+        process_split_(out_pkt, ilen, olen);
+        return;
+    }
+
+    // Resample from a copy, rather than swapping buffers with the caller, so
+    // that each packet keeps its own buffer and soon stops reallocating.
+    in_pkt_.assign(out_pkt.cbegin(), out_pkt.cend());
+    out_pkt.resize(olen * channels_, uninitialized);
 
     std::size_t idone, odone;
     verify(::soxr_process(handle_.get(),
@@ -122,6 +202,34 @@ void resampler::process(audio::packet& out_pkt)
     out_pkt.resize(odone * channels_);
 }
 
+void resampler::process_split_(audio::packet& pkt, std::size_t const ilen,
+                               std::size_t const olen)
+{
+    // Only grows past the reserved size for unusually large packets.
+    if (in_planes_.size() < ilen * channels_) {
+        in_planes_.resize(ilen * channels_);
+    }
+    if (out_planes_.size() < olen * channels_) {
+        out_planes_.resize(olen * channels_);
+    }
+
+    auto const in = pkt.data();
+    for (auto const c : xrange(channels_)) {
+        auto const plane = &in_planes_[c * ilen];
+        for (auto const t : xrange(ilen)) {
+            plane[t] = in[t * channels_ + c];
+        }
+        in_ptrs_[c] = plane;
+        out_ptrs_[c] = &out_planes_[c * olen];
+    }
+
+    std::size_t idone, odone;
+    verify(::soxr_process(handle_.get(),
+                          in_ptrs_.data(), ilen, &idone,
+                          out_ptrs_.data(), olen, &odone));
+    pkt.fill_planar(out_ptrs_.data(), odone);
+}
+
 void resampler::drain(audio::packet& pkt)
 {
     if (handle_ == nullptr) {
@@ -131,9 +239,23 @@ void resampler::drain(audio::packet& pkt)
     auto const delay = std::llround(::soxr_delay(handle_.get()));
     if (delay > 0) {
         auto const olen = static_cast<std::size_t>(delay);
-        pkt.resize(olen * channels_);
-
         std::size_t odone;
+
+        if (threads_ > 1) {
+            if (out_planes_.size() < olen * channels_) {
+                out_planes_.resize(olen * channels_);
+            }
+            for (auto const c : xrange(channels_)) {
+                out_ptrs_[c] = &out_planes_[c * olen];
+            }
+            verify(::soxr_process(handle_.get(),
+                                  nullptr, 0, nullptr,
+                                  out_ptrs_.data(), olen, &odone));
+            pkt.fill_planar(out_ptrs_.data(), odone);
+            return;
+        }
+
+        pkt.resize(olen * channels_);
         verify(::soxr_process(handle_.get(),
                               nullptr, 0, nullptr,
                               pkt.data(), olen, &odone));
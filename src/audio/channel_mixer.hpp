@@ -8,15 +8,24 @@
 #include <amp/audio/filter.hpp>
 #include <amp/audio/format.hpp>
 #include <amp/audio/packet.hpp>
+#include <amp/bitops.hpp>
 #include <amp/error.hpp>
 #include <amp/numeric.hpp>
+#include <amp/range.hpp>
 #include <amp/ref_ptr.hpp>
 #include <amp/stddef.hpp>
 
+#include "core/cpu.hpp"
+
 #include <algorithm>
 #include <cmath>
+#include <cstddef>
 #include <utility>
 
+#if defined(AMP_HAS_X86) || defined(AMP_HAS_X64)
+# include <immintrin.h>
+#endif
+
 
 namespace amp {
 namespace audio {
@@ -203,23 +212,321 @@ auto build_matrix(uint32 const src_layout, uint32 const dst_layout,
     }
 }
 
-void mix_generic(float const* src, float* dst, std::size_t n,
-                 float const(&matrix)[max_channels][max_channels],
-                 uint32 const src_channels, uint32 const dst_channels) noexcept
+// Mixing coefficients, as built for one pair of channel layouts. Besides the
+// dense matrix, each output channel keeps a list of just the inputs that
+// contribute to it, and `columns` marks the inputs that contribute at all.
+struct mix_plan
+{
+    struct row
+    {
+        uint32 count;
+        uint8 src[max_channels];
+        float coeff[max_channels];
+    };
+
+    float matrix[max_channels][max_channels];
+    row rows[max_channels];
+    uint32 columns;
+    uint32 src_channels;
+    uint32 dst_channels;
+};
+
+using mix_kernel = void(float const*, float*, std::size_t,
+                        mix_plan const&) noexcept;
+
+
+// ----------------------------------------------------------------------------
+// Any layout to any other, skipping zero coefficients.
+// ----------------------------------------------------------------------------
+
+void mix_sparse(float const* src, float* dst, std::size_t n,
+                mix_plan const& plan) noexcept
 {
     while (n-- != 0) {
-        for (auto const i : xrange(dst_channels)) {
+        for (auto const i : xrange(plan.dst_channels)) {
+            auto&& row = plan.rows[i];
             auto acc = 0.f;
-            for (auto const j : xrange(src_channels)) {
-                acc = std::fma(src[j], matrix[i][j], acc);
+            for (auto const k : xrange(row.count)) {
+                acc += src[row.src[k]] * row.coeff[k];
             }
             dst[i] = acc;
         }
-        src += src_channels;
-        dst += dst_channels;
+        src += plan.src_channels;
+        dst += plan.dst_channels;
     }
 }
 
+#if defined(AMP_HAS_X86) || defined(AMP_HAS_X64)
+
+// Returns {x[X], x[X], y[Y], y[Y]}: one input channel of two frames, lined up
+// with the two output channels of each.
+template<int X, int Y>
+AMP_TARGET("sse")
+AMP_INLINE __m128 pick(__m128 const x, __m128 const y) noexcept
+{
+    return _mm_shuffle_ps(x, y, _MM_SHUFFLE(Y, Y, X, X));
+}
+
+// Coefficients of input channel `j` for both output channels, twice.
+AMP_TARGET("sse")
+AMP_INLINE __m128 stereo_column(mix_plan const& plan, uint32 const j) noexcept
+{
+    auto const l = plan.matrix[0][j];
+    auto const r = plan.matrix[1][j];
+    return _mm_setr_ps(l, r, l, r);
+}
+
+
+// ----------------------------------------------------------------------------
+// Mono to stereo.
+// ----------------------------------------------------------------------------
+
+AMP_TARGET("sse")
+void mix_1_to_2_sse(float const* const src, float* const dst,
+                    std::size_t const n, mix_plan const& plan) noexcept
+{
+    auto const c = stereo_column(plan, 0);
+    auto i = 0_sz;
+
+    AMP_DISABLE_LOOP_UNROLLING_AND_VECTORIZATION
+    for (auto const last = align_down(n, 4); i != last; i += 4) {
+        auto const x = _mm_loadu_ps(&src[i]);
+        _mm_storeu_ps(&dst[i*2 + 0], _mm_mul_ps(_mm_unpacklo_ps(x, x), c));
+        _mm_storeu_ps(&dst[i*2 + 4], _mm_mul_ps(_mm_unpackhi_ps(x, x), c));
+    }
+    mix_sparse(&src[i], &dst[i*2], n - i, plan);
+}
+
+
+// ----------------------------------------------------------------------------
+// Stereo to 5.1: each pair of frames is three vectors of output, each the
+// sum of the left and right inputs times a column of coefficients.
+// ----------------------------------------------------------------------------
+
+AMP_TARGET("sse")
+void mix_2_to_6_sse(float const* const src, float* const dst,
+                    std::size_t const n, mix_plan const& plan) noexcept
+{
+    auto&& m = plan.matrix;
+    auto const l0 = _mm_setr_ps(m[0][0], m[1][0], m[2][0], m[3][0]);
+    auto const r0 = _mm_setr_ps(m[0][1], m[1][1], m[2][1], m[3][1]);
+    auto const l1 = _mm_setr_ps(m[4][0], m[5][0], m[0][0], m[1][0]);
+    auto const r1 = _mm_setr_ps(m[4][1], m[5][1], m[0][1], m[1][1]);
+    auto const l2 = _mm_setr_ps(m[2][0], m[3][0], m[4][0], m[5][0]);
+    auto const r2 = _mm_setr_ps(m[2][1], m[3][1], m[4][1], m[5][1]);
+    auto i = 0_sz;
+
+    AMP_DISABLE_LOOP_UNROLLING_AND_VECTORIZATION
+    for (auto const last = align_down(n, 2); i != last; i += 2) {
+        auto const x = _mm_loadu_ps(&src[i*2]);
+        auto const xl0 = _mm_shuffle_ps(x, x, _MM_SHUFFLE(0, 0, 0, 0));
+        auto const xr0 = _mm_shuffle_ps(x, x, _MM_SHUFFLE(1, 1, 1, 1));
+        auto const xl  = _mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 2, 0, 0));
+        auto const xr  = _mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 3, 1, 1));
+        auto const xl1 = _mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 2, 2, 2));
+        auto const xr1 = _mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 3, 3, 3));
+
+        _mm_storeu_ps(&dst[i*6 + 0], _mm_add_ps(_mm_mul_ps(xl0, l0),
+                                                _mm_mul_ps(xr0, r0)));
+        _mm_storeu_ps(&dst[i*6 + 4], _mm_add_ps(_mm_mul_ps(xl,  l1),
+                                                _mm_mul_ps(xr,  r1)));
+        _mm_storeu_ps(&dst[i*6 + 8], _mm_add_ps(_mm_mul_ps(xl1, l2),
+                                                _mm_mul_ps(xr1, r2)));
+    }
+    mix_sparse(&src[i*2], &dst[i*6], n - i, plan);
+}
+
+
+// ----------------------------------------------------------------------------
+// 5.1 and 7.1 to stereo: each output vector holds two frames, and every input
+// channel that contributes at all adds one multiply-add.
+// ----------------------------------------------------------------------------
+
+#define AMP_MIX_TERM(J, X, Y, A, B)                                         \
+    if (plan.columns & (1 << (J))) {                                        \
+        acc = _mm_add_ps(acc, _mm_mul_ps(pick<X, Y>(A, B), c[J]));          \
+    }
+
+AMP_TARGET("sse")
+void mix_6_to_2_sse(float const* const src, float* const dst,
+                    std::size_t const n, mix_plan const& plan) noexcept
+{
+    __m128 c[6];
+    for (auto const j : xrange(6)) {
+        c[j] = stereo_column(plan, static_cast<uint32>(j));
+    }
+    auto i = 0_sz;
+
+    AMP_DISABLE_LOOP_UNROLLING_AND_VECTORIZATION
+    for (auto const last = align_down(n, 2); i != last; i += 2) {
+        // {0 1 2 3} {4 5 0 1} {2 3 4 5}
+        auto const a = _mm_loadu_ps(&src[i*6 + 0]);
+        auto const b = _mm_loadu_ps(&src[i*6 + 4]);
+        auto const d = _mm_loadu_ps(&src[i*6 + 8]);
+
+        auto acc = _mm_setzero_ps();
+        AMP_MIX_TERM(0, 0, 2, a, b)
+        AMP_MIX_TERM(1, 1, 3, a, b)
+        AMP_MIX_TERM(2, 2, 0, a, d)
+        AMP_MIX_TERM(3, 3, 1, a, d)
+        AMP_MIX_TERM(4, 0, 2, b, d)
+        AMP_MIX_TERM(5, 1, 3, b, d)
+        _mm_storeu_ps(&dst[i*2], acc);
+    }
+    mix_sparse(&src[i*6], &dst[i*2], n - i, plan);
+}
+
+AMP_TARGET("sse")
+void mix_8_to_2_sse(float const* const src, float* const dst,
+                    std::size_t const n, mix_plan const& plan) noexcept
+{
+    __m128 c[8];
+    for (auto const j : xrange(8)) {
+        c[j] = stereo_column(plan, static_cast<uint32>(j));
+    }
+    auto i = 0_sz;
+
+    AMP_DISABLE_LOOP_UNROLLING_AND_VECTORIZATION
+    for (auto const last = align_down(n, 2); i != last; i += 2) {
+        // {0 1 2 3} {4 5 6 7} of each frame
+        auto const a0 = _mm_loadu_ps(&src[i*8 +  0]);
+        auto const b0 = _mm_loadu_ps(&src[i*8 +  4]);
+        auto const a1 = _mm_loadu_ps(&src[i*8 +  8]);
+        auto const b1 = _mm_loadu_ps(&src[i*8 + 12]);
+
+        auto acc = _mm_setzero_ps();
+        AMP_MIX_TERM(0, 0, 0, a0, a1)
+        AMP_MIX_TERM(1, 1, 1, a0, a1)
+        AMP_MIX_TERM(2, 2, 2, a0, a1)
+        AMP_MIX_TERM(3, 3, 3, a0, a1)
+        AMP_MIX_TERM(4, 0, 0, b0, b1)
+        AMP_MIX_TERM(5, 1, 1, b0, b1)
+        AMP_MIX_TERM(6, 2, 2, b0, b1)
+        AMP_MIX_TERM(7, 3, 3, b0, b1)
+        _mm_storeu_ps(&dst[i*2], acc);
+    }
+    mix_sparse(&src[i*8], &dst[i*2], n - i, plan);
+}
+
+#undef AMP_MIX_TERM
+
+#endif  // AMP_HAS_X86 || AMP_HAS_X64
+
+
+// Picks a kernel by channel counts alone; they work with any coefficients,
+// and so with any layouts of those sizes.
+mix_kernel* select_kernel(mix_plan const& plan) noexcept
+{
+#if defined(AMP_HAS_X86) || defined(AMP_HAS_X64)
+    if (cpu::has_sse()) {
+        auto const src = plan.src_channels;
+        auto const dst = plan.dst_channels;
+        if (src == 1 && dst == 2) { return &mix_1_to_2_sse; }
+        if (src == 2 && dst == 6) { return &mix_2_to_6_sse; }
+        if (src == 6 && dst == 2) { return &mix_6_to_2_sse; }
+        if (src == 8 && dst == 2) { return &mix_8_to_2_sse; }
+    }
+#endif
+    return &mix_sparse;
+}
+
+// Lists the non-zero coefficients of a plan whose matrix and channel counts
+// are set.
+void index_plan(mix_plan& plan) noexcept
+{
+    plan.columns = 0;
+
+#if __has_warning("-Wfloat-equal")
+# pragma clang diagnostic push
+# pragma clang diagnostic ignored "-Wfloat-equal"
+#endif
+    for (auto const i : xrange(plan.dst_channels)) {
+        auto&& row = plan.rows[i];
+        row.count = 0;
+        for (auto const j : xrange(plan.src_channels)) {
+            if (plan.matrix[i][j] != 0.f) {
+                row.src[row.count] = static_cast<uint8>(j);
+                row.coeff[row.count] = plan.matrix[i][j];
+                row.count++;
+                plan.columns |= (1U << j);
+            }
+        }
+    }
+#if __has_warning("-Wfloat-equal")
+# pragma clang diagnostic pop
+#endif
+}
+
+void build_plan(uint32 const src_layout, uint32 const dst_layout,
+                mix_plan& plan)
+{
+    plan = mix_plan{};
+    build_matrix(src_layout, dst_layout, plan.matrix);
+    plan.src_channels = popcnt(src_layout);
+    plan.dst_channels = popcnt(dst_layout);
+    index_plan(plan);
+}
+
+void build_plan(audio::frame_matrix const& m, mix_plan& plan) noexcept
+{
+    plan = mix_plan{};
+    plan.src_channels = m.src_channels;
+    plan.dst_channels = m.dst_channels;
+    for (auto const i : xrange(m.dst_channels)) {
+        for (auto const j : xrange(m.src_channels)) {
+            plan.matrix[i][j] = m.coeffs[i * m.stride + j];
+        }
+    }
+    index_plan(plan);
+}
+
+inline bool is_identity(mix_plan const& plan) noexcept
+{
+    if (plan.src_channels != plan.dst_channels) {
+        return false;
+    }
+    for (auto const i : xrange(plan.dst_channels)) {
+        auto&& row = plan.rows[i];
+        if (row.count != 1 || row.src[0] != i) {
+            return false;
+        }
+#if __has_warning("-Wfloat-equal")
+# pragma clang diagnostic push
+# pragma clang diagnostic ignored "-Wfloat-equal"
+#endif
+        if (row.coeff[0] != 1.f) {
+            return false;
+        }
+#if __has_warning("-Wfloat-equal")
+# pragma clang diagnostic pop
+#endif
+    }
+    return true;
+}
+
+// The plan that does what `first` and then `second` would. Swaps, gains and
+// mixes compose to another matrix, and the terms that cancel out are dropped
+// along with the zero ones.
+void compose_plan(mix_plan const& first, mix_plan const& second,
+                  mix_plan& out) noexcept
+{
+    AMP_ASSERT(first.dst_channels == second.src_channels);
+
+    out = mix_plan{};
+    out.src_channels = first.src_channels;
+    out.dst_channels = second.dst_channels;
+    for (auto const i : xrange(second.dst_channels)) {
+        for (auto const j : xrange(first.src_channels)) {
+            auto acc = 0.f;
+            for (auto const k : xrange(first.dst_channels)) {
+                acc += second.matrix[i][k] * first.matrix[k][j];
+            }
+            out.matrix[i][j] = acc;
+        }
+    }
+    index_plan(out);
+}
+
 
 class channel_mixer final :
     public implement_ref_count<channel_mixer, filter>
@@ -232,9 +539,19 @@ public:
         calibrate(src);
     }
 
+    // A fused stage, built by the filter chain out of a run of per-frame
+    // filters; it is never calibrated again.
+    explicit channel_mixer(mix_plan const& plan, uint32 const dst_layout) :
+        dst_channels(plan.dst_channels),
+        dst_channel_layout(dst_layout),
+        plan_(plan),
+        kernel_(select_kernel(plan_))
+    {}
+
     void calibrate(audio::format& fmt) override
     {
-        build_matrix(fmt.channel_layout, dst_channel_layout, matrix);
+        build_plan(fmt.channel_layout, dst_channel_layout, plan_);
+        kernel_ = select_kernel(plan_);
 
         fmt.channels = dst_channels;
         fmt.channel_layout = dst_channel_layout;
@@ -248,8 +565,8 @@ public:
         pkt.set_channel_layout(dst_channel_layout, dst_channels);
         pkt.resize(frames * dst_channels, uninitialized);
 
-        mix_generic(tmp_pkt.data(), pkt.data(), frames,
-                    matrix, tmp_pkt.channels(), dst_channels);
+        AMP_ASSERT(tmp_pkt.channels() == plan_.src_channels);
+        kernel_(tmp_pkt.data(), pkt.data(), frames, plan_);
     }
 
     void drain(audio::packet&) noexcept override
@@ -265,11 +582,19 @@ public:
         return 0;
     }
 
+    bool get_matrix(audio::frame_matrix& m) noexcept override
+    {
+        m = {plan_.src_channels, plan_.dst_channels,
+             &plan_.matrix[0][0], max_channels};
+        return true;
+    }
+
 private:
     audio::packet tmp_pkt;
     uint32 dst_channels{};
     uint32 dst_channel_layout{};
-    float matrix[max_channels][max_channels];
+    mix_plan plan_;
+    mix_kernel* kernel_{};
 };
 
 }}}   // namespace amp::audio::<unnamed>
@@ -5,6 +5,7 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 
+#include <amp/bitops.hpp>
 #include <amp/error.hpp>
 #include <amp/stddef.hpp>
 
@@ -20,10 +21,14 @@
 # include <mach/vm_prot.h>
 # include <mach/vm_statistics.h>
 # include <mach/vm_types.h>
+# include <sys/mman.h>
+# include <unistd.h>
 #elif defined(AMP_HAS_POSIX)
-# include <amp/scope_guard.hpp>
+# include <fcntl.h>
+# include <stdio.h>
 # include <stdlib.h>
 # include <sys/mman.h>
+# include <sys/stat.h>
 # include <unistd.h>
 #endif
 
@@ -34,7 +39,7 @@ namespace aux {
 
 #if defined(__APPLE__) && defined(__MACH__)
 
-void* allocate_mirrored(std::size_t const size)
+void* allocate_mirrored(std::size_t const size, uint32 const flags)
 {
     auto const task = mach_task_self();
 
@@ -76,6 +81,10 @@ void* allocate_mirrored(std::size_t const size)
             ::vm_deallocate(task, buffer, size);
             continue;
         }
+
+        if (flags & mirror_locked) {
+            (void)::mlock(reinterpret_cast<void*>(buffer), size * 2);
+        }
         return reinterpret_cast<void*>(buffer);
     }
     raise_bad_alloc();
@@ -89,37 +98,128 @@ void deallocate_mirrored(void* const ptr, std::size_t const size) noexcept
 
 #elif defined(AMP_HAS_POSIX)
 
-void* allocate_mirrored(std::size_t const size)
+namespace {
+
+// Each rung returns a file descriptor of exactly `size` bytes that is not
+// reachable through the filesystem, or -1 if it is not available.
+
+int open_memfd(std::size_t const size, uint32 const flags) noexcept
+{
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+    auto const fd = ::memfd_create("amp-circular-buffer", MFD_CLOEXEC | flags);
+    if (fd >= 0 && ::ftruncate(fd, static_cast<::off_t>(size)) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+#else
+    (void)size, (void)flags;
+    return -1;
+#endif
+}
+
+int open_shm(std::size_t const size) noexcept
+{
+    char name[64];
+    ::snprintf(name, sizeof(name), "/amp-circular-buffer-%ld-%p",
+               static_cast<long>(::getpid()), static_cast<void*>(name));
+
+    auto const fd = ::shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        return -1;
+    }
+    ::shm_unlink(name);
+
+    if (::ftruncate(fd, static_cast<::off_t>(size)) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int open_tmpfile(std::size_t const size) noexcept
 {
     char path[] = "/tmp/amp-circular-buffer-XXXXXX";
     auto const fd = ::mkstemp(path);
     if (fd < 0) {
-        raise(errc::failure, "failed to create temporary file");
+        return -1;
     }
-
-    AMP_SCOPE_EXIT { ::close(fd); };
     ::unlink(path);
 
-    if (::ftruncate(fd, static_cast<::off_t>(size * 2)) < 0) {
-        raise(errc::failure, "failed to grow temporary file's size");
+    if (::ftruncate(fd, static_cast<::off_t>(size)) < 0) {
+        ::close(fd);
+        return -1;
     }
+    return fd;
+}
 
-    auto const buffer = static_cast<uchar*>(::mmap(nullptr, size * 2,
-                                                   PROT_READ | PROT_WRITE,
-                                                   MAP_SHARED,
-                                                   fd, 0));
-    if (reinterpret_cast<intptr>(buffer) == -1) {
-        raise_bad_alloc();
+// Reserves twice the address space, then maps `fd` over both halves. Unlike
+// mapping the file once and remapping its second half, this neither requires
+// the file to be twice as large nor races with other threads' mappings.
+//
+// A file of huge pages must be mapped at an address that is a multiple of
+// their size, which mmap does not guarantee for the reservation: `align`
+// bytes more are reserved, and the slack on either side of the aligned
+// buffer is released.
+uchar* map_mirrored(int const fd, std::size_t const size,
+                    std::size_t const align = 0) noexcept
+{
+    auto const reserved = static_cast<uchar*>(
+        ::mmap(nullptr, size * 2 + align, PROT_NONE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (reserved == MAP_FAILED) {
+        return nullptr;
+    }
+
+    auto const buffer = align ? align_up(reserved, align) : reserved;
+    if (auto const head = static_cast<std::size_t>(buffer - reserved)) {
+        ::munmap(reserved, head);
+    }
+    if (auto const tail = align - static_cast<std::size_t>(buffer - reserved)) {
+        ::munmap(buffer + size * 2, tail);
+    }
+
+    for (auto const half : {buffer, buffer + size}) {
+        auto const p = ::mmap(half, size, PROT_READ | PROT_WRITE,
+                              MAP_FIXED | MAP_SHARED, fd, 0);
+        if (p != half) {
+            ::munmap(buffer, size * 2);
+            return nullptr;
+        }
     }
+    return buffer;
+}
 
-    auto const mirror = static_cast<uchar*>(::mmap(buffer + size, size,
-                                                   PROT_READ | PROT_WRITE,
-                                                   MAP_FIXED | MAP_SHARED,
-                                                   fd, 0));
-    if (mirror != (buffer + size)) {
-        ::munmap(buffer, size * 2);
+}     // namespace <unnamed>
+
+
+void* allocate_mirrored(std::size_t const size, uint32 const flags)
+{
+    uchar* buffer{};
+    auto try_map = [&](int const fd, std::size_t const align = 0) {
+        if (fd >= 0) {
+            buffer = map_mirrored(fd, size, align);
+            ::close(fd);
+        }
+        return (buffer != nullptr);
+    };
+
+#if defined(__linux__) && defined(MFD_HUGETLB)
+    constexpr auto hugepage_size = 2_sz * 1024 * 1024;
+    if ((flags & mirror_hugepages) && (size % hugepage_size) == 0) {
+        (void)try_map(open_memfd(size, MFD_HUGETLB), hugepage_size);
+    }
+#endif
+    if (buffer == nullptr && !try_map(open_memfd(size, 0))
+                          && !try_map(open_shm(size))
+                          && !try_map(open_tmpfile(size))) {
         raise_bad_alloc();
     }
+
+    if (flags & mirror_locked) {
+        // Both halves share the same pages, so locking one locks them all.
+        (void)::mlock(buffer, size);
+    }
     return buffer;
 }
 
@@ -130,5 +230,12 @@ void deallocate_mirrored(void* const ptr, std::size_t const size) noexcept
 
 #endif  // __APPLE__ && __MACH__
 
-}}}   // namespace amp::audio::aux
 
+std::size_t mirror_granularity() noexcept
+{
+    static auto const page_size = static_cast<std::size_t>(
+        ::sysconf(_SC_PAGESIZE));
+    return page_size;
+}
+
+}}}   // namespace amp::audio::aux
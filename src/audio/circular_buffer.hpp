@@ -13,7 +13,9 @@
 #include <amp/stddef.hpp>
 
 #include "core/cpu.hpp"
+#include "core/realtime.hpp"
 
+#include <algorithm>
 #include <atomic>
 #include <cstddef>
 #include <type_traits>
@@ -22,10 +24,21 @@
 
 namespace amp {
 namespace audio {
+enum mirror_flags : uint32 {
+    // Back the buffer with huge pages, if it is large enough and the system
+    // has any available.
+    mirror_hugepages = (1 << 0),
+    // Lock the buffer into physical memory (best effort).
+    mirror_locked    = (1 << 1),
+};
+
 namespace aux {
 
-extern void* allocate_mirrored(std::size_t);
+// Maps `size` bytes of memory twice, back to back, so that the second half
+// aliases the first. `size` must be a multiple of mirror_granularity().
+extern void* allocate_mirrored(std::size_t, uint32);
 extern void deallocate_mirrored(void*, std::size_t) noexcept;
+extern std::size_t mirror_granularity() noexcept;
 
 }     // namespace aux
 
@@ -42,9 +55,10 @@ public:
     using const_pointer = T const*;
     using size_type     = std::size_t;
 
-    explicit circular_buffer(size_type const n) :
-        size_{ceil_pow2(n)},
-        data_{static_cast<pointer>(aux::allocate_mirrored(size_ * sizeof(T)))}
+    explicit circular_buffer(size_type const n, uint32 const flags = 0) :
+        size_{ceil_pow2(std::max(n, aux::mirror_granularity() / sizeof(T)))},
+        data_{static_cast<pointer>(
+            aux::allocate_mirrored(size_ * sizeof(T), flags))}
     {}
 
     circular_buffer(circular_buffer const&) = delete;
@@ -89,6 +103,26 @@ public:
     size_type capacity() const noexcept
     { return size_; }
 
+    // Locks the buffer into physical memory. Returns false on failure, e.g.
+    // if RLIMIT_MEMLOCK does not allow it.
+    bool lock() const noexcept
+    { return realtime::lock_memory(data_, size_ * sizeof(T)); }
+
+    // Exchanges the contents of two buffers. Neither may be accessed by any
+    // other thread while this is in progress.
+    void swap(circular_buffer& x) noexcept
+    {
+        auto const fill = fill_.load(std::memory_order_relaxed);
+        fill_.store(x.fill_.load(std::memory_order_relaxed),
+                    std::memory_order_relaxed);
+        x.fill_.store(fill, std::memory_order_relaxed);
+
+        std::swap(head_, x.head_);
+        std::swap(tail_, x.tail_);
+        std::swap(size_, x.size_);
+        std::swap(data_, x.data_);
+    }
+
     void write_commit(size_type const n) noexcept
     {
         head_ = (head_ + n) & (capacity() - 1);
@@ -105,8 +139,8 @@ private:
     alignas(cache_line_size) std::atomic<size_type> fill_{0};
     alignas(cache_line_size) size_type head_{0};
     alignas(cache_line_size) size_type tail_{0};
-    size_type const size_;
-    pointer const data_;
+    size_type size_;
+    pointer data_;
 };
 
 }}    // namespace amp::audio
@@ -9,14 +9,18 @@
 #include <amp/audio/format.hpp>
 #include <amp/audio/packet.hpp>
 #include <amp/error.hpp>
+#include <amp/numeric.hpp>
 #include <amp/range.hpp>
 #include <amp/stddef.hpp>
 
 #include "audio/channel_mixer.hpp"
 #include "audio/filter_chain.hpp"
+#include "audio/resampler.hpp"
 #include "core/registry.hpp"
 
+#include <algorithm>
 #include <memory>
+#include <ratio>
 #include <utility>
 
 
@@ -24,27 +28,35 @@ namespace amp {
 namespace audio {
 namespace {
 
-auto make_resampler(audio::format& src, audio::format const& dst,
-                    uint8 const quality = audio::quality_medium)
+ref_ptr<audio::resampler> make_resampler(
+    audio::format& src, audio::format const& dst,
+    uint8 const quality = audio::quality_medium)
 {
-    std::exception_ptr ep;
+    auto const init = [&](ref_ptr<audio::resampler> instance) {
+        instance->set_sample_rate(dst.sample_rate);
+        instance->set_quality(quality);
+        instance->calibrate(src);
+        return instance;
+    };
+
+    // Plugins take precedence; the built-in resampler is the fallback when
+    // none is installed, or none can handle the format.
     for (auto&& factory : audio::resampler_factories) {
         try {
-            auto instance = factory.create();
-            instance->set_sample_rate(dst.sample_rate);
-            instance->set_quality(quality);
-            instance->calibrate(src);
-            return instance;
+            return init(factory.create());
         }
         catch (...) {
-            ep = std::current_exception();
         }
     }
+    return init(audio::resampler_bridge<audio::polyphase_resampler>::make());
+}
 
-    if (ep) {
-        std::rethrow_exception(ep);
-    }
-    raise(errc::failure, "no audio resampler plugin");
+AMP_INLINE bool operator==(audio::format const& x,
+                           audio::format const& y) noexcept
+{
+    return x.channels       == y.channels
+        && x.channel_layout == y.channel_layout
+        && x.sample_rate    == y.sample_rate;
 }
 
 }     // namespace <unnamed>
@@ -53,47 +65,149 @@ auto make_resampler(audio::format& src, audio::format const& dst,
 void filter_chain::rebuild(std::vector<u8string> const& preset,
                            audio::replaygain_config const& config)
 {
+    factories_.clear();
+    elems_.clear();
+    stages_.clear();
+    src_ = dst_ = {};
+    latency_ = 0;
+
     for (auto&& id : preset) {
         auto factory = audio::filter_factories.find(id);
         if (factory != audio::filter_factories.end()) {
             elems_.push_back(factory->create());
+            factories_.push_back(&*factory);
         }
     }
     rgain_.reset(config);
 }
 
 void filter_chain::calibrate(audio::format const& src,
-                             audio::format const& dst,
-                             audio::replaygain_info const& info)
+                             audio::format const& dst)
 {
+    // Drop the format converters from any previous calibration; they are
+    // always appended after the user's filters.
+    elems_.resize(factories_.size());
+
     auto fmt = src;
     fmt.validate();
 
-    for (auto&& elem : elems_) {
-        elem->calibrate(fmt);
+    // Each filter reports its latency at its own output sample rate, so sum
+    // them up in nanoseconds first.
+    uint64 ns{};
+    auto add_latency = [&](audio::filter& elem, uint32 const rate) {
+        ns += muldiv(elem.get_latency(), std::nano::den, rate);
+    };
+
+    // Runs of filters that are each a per-frame matrix (channel swaps,
+    // mixes, gains) are composed into one, and run as a single pass. Every
+    // other filter is a barrier.
+    stages_.clear();
+    mix_plan run, next, tmp;
+    auto run_first = 0_sz;
+    auto run_size = 0_sz;
+    uint32 run_layout{};
+
+    auto end_run = [&] {
+        if (run_size == 1) {
+            stages_.push_back({run_first, nullptr});
+        }
+        else if (run_size > 1 && !is_identity(run)) {
+            stages_.push_back({run_first,
+                               channel_mixer::make(run, run_layout)});
+        }
+        run_size = 0;
+    };
+
+    // Called once the filter has been calibrated, i.e. with `fmt` as it
+    // comes out of it.
+    auto add_stage = [&](std::size_t const i) {
+        audio::frame_matrix m;
+        if (!elems_[i]->get_matrix(m)) {
+            end_run();
+            stages_.push_back({i, nullptr});
+            return;
+        }
+        if (run_size++ == 0) {
+            build_plan(m, run);
+            run_first = i;
+        }
+        else {
+            build_plan(m, next);
+            compose_plan(run, next, tmp);
+            run = tmp;
+        }
+        run_layout = fmt.channel_layout;
+    };
+
+    for (auto const i : xrange(elems_.size())) {
+        elems_[i]->calibrate(fmt);
         fmt.validate();
+        add_latency(*elems_[i], fmt.sample_rate);
+        add_stage(i);
     }
 
     if (fmt.channel_layout != dst.channel_layout) {
         elems_.push_back(channel_mixer::make(fmt, dst));
+        add_latency(*elems_.back(), fmt.sample_rate);
+        add_stage(elems_.size() - 1);
     }
     if (fmt.sample_rate != dst.sample_rate) {
         elems_.push_back(make_resampler(fmt, dst));
+        add_latency(*elems_.back(), dst.sample_rate);
+        add_stage(elems_.size() - 1);
+    }
+    end_run();
+
+    src_ = src;
+    dst_ = dst;
+    latency_ = muldiv(ns, dst.sample_rate, std::nano::den);
+
+    // Whatever the filters still hold when the track ends is at most about
+    // as long as their latency, so draining them need not allocate.
+    drain_buf_.reserve(static_cast<std::size_t>(
+        latency_ * std::max(src.channels, dst.channels)));
+}
+
+bool filter_chain::is_calibrated_for(audio::format const& src,
+                                     audio::format const& dst) const noexcept
+{
+    return (src_.sample_rate != 0) && (src_ == src) && (dst_ == dst);
+}
+
+void filter_chain::adopt(filter_chain& old) noexcept
+{
+    if (!old.is_calibrated_for(src_, dst_) || !is_calibrated_for(src_, dst_)) {
+        return;
+    }
+
+    // A filter's input format depends only on the filters before it, so any
+    // common prefix of the two chains was calibrated identically.
+    auto const n = std::min(factories_.size(), old.factories_.size());
+    auto i = 0_sz;
+    for (; i != n && factories_[i] == old.factories_[i]; ++i) {
+        elems_[i].swap(old.elems_[i]);
+    }
+
+    if (i == factories_.size() && i == old.factories_.size()) {
+        AMP_ASSERT(elems_.size() == old.elems_.size());
+        for (; i != elems_.size(); ++i) {
+            elems_[i].swap(old.elems_[i]);
+        }
     }
-    rgain_.calibrate(info);
 }
 
 void filter_chain::process(audio::packet& pkt)
 {
-    for (auto&& elem : elems_) {
-        elem->process(pkt);
+    for (auto&& s : stages_) {
+        auto&& f = s.fused ? *s.fused : *elems_[s.elem];
+        f.process(pkt);
     }
-    rgain_.process(pkt);
 }
 
 void filter_chain::drain(audio::packet& pkt)
 {
-    audio::packet tmp;
+    auto&& tmp = drain_buf_;
+    tmp.clear();
     tmp.set_channel_layout(pkt.channel_layout(), pkt.channels());
 
     auto const last = elems_.end();
@@ -108,7 +222,6 @@ void filter_chain::drain(audio::packet& pkt)
             tmp.clear();
         }
     }
-    rgain_.process(pkt);
 }
 
 void filter_chain::flush()
@@ -10,12 +10,17 @@
 
 
 #include <amp/audio/filter.hpp>
+#include <amp/audio/format.hpp>
+#include <amp/audio/packet.hpp>
 #include <amp/ref_ptr.hpp>
 #include <amp/stddef.hpp>
 #include <amp/u8string.hpp>
 
 #include "audio/replaygain.hpp"
 
+#include <atomic>
+#include <cstddef>
+#include <memory>
 #include <utility>
 #include <vector>
 
@@ -23,10 +28,6 @@
 namespace amp {
 namespace audio {
 
-struct format;
-class packet;
-
-
 class filter_chain
 {
 public:
@@ -34,20 +35,142 @@ public:
                  audio::replaygain_config const&);
 
     void calibrate(audio::format const&,
-                   audio::format const&,
-                   audio::replaygain_info const&);
-
+                   audio::format const&);
+
+    void calibrate(audio::replaygain_info const& info) noexcept
+    { rgain_.calibrate(info); }
+
+    void calibrate(audio::format const& src,
+                   audio::format const& dst,
+                   audio::replaygain_info const& info)
+    {
+        calibrate(src, dst);
+        calibrate(info);
+    }
+
+    bool is_calibrated_for(audio::format const&,
+                           audio::format const&) const noexcept;
+
+    // Takes over the filter instances of `old` that this chain would have
+    // created identically, so that their internal state (delay lines,
+    // resampler history, etc.) survives the swap. Never allocates.
+    void adopt(filter_chain&) noexcept;
+
+    // Neither applies the replay gain. That is the chain's final stage, and
+    // is rendered by the consumer straight into its output buffer (see
+    // output_stage::scale) to save a pass over every packet.
     void process(audio::packet&);
     void drain(audio::packet&);
     void flush();
 
+    float gain() const noexcept
+    { return rgain_.scale(); }
+
+    // Sum of the filters' latencies, in frames at the output sample rate,
+    // as of the last calibration.
+    uint64 latency() const noexcept
+    { return latency_; }
+
 private:
+    friend class filter_chain_exchange;
+
+    // What process() runs: one of the filters, or a run of adjacent filters
+    // that are each a per-frame matrix, folded into a single channel mixer
+    // starting at `elem`. Stages refer to filters by index, so that adopt()
+    // need not touch them.
+    struct stage
+    {
+        std::size_t elem;
+        ref_ptr<audio::filter> fused;
+    };
+
+    std::vector<audio::filter_factory const*> factories_;
     std::vector<ref_ptr<audio::filter>> elems_;
+    std::vector<stage> stages_;
     audio::replaygain_filter rgain_;
+    audio::packet drain_buf_;
+    audio::format src_{};
+    audio::format dst_{};
+    uint64 latency_{};
+    filter_chain* retired_next_{};
+};
+
+
+// -- Overview --
+//
+// Hands fully built filter chains from a control thread over to the decoder
+// thread without either side ever blocking on the other. The decoder thread
+// only ever exchanges pointers: chains it replaces are pushed on to a lock-free
+// list and are destroyed later by the control thread (the next time it
+// publishes, or once playback has stopped).
+
+class filter_chain_exchange
+{
+public:
+    filter_chain_exchange() = default;
+
+    filter_chain_exchange(filter_chain_exchange const&) = delete;
+    filter_chain_exchange& operator=(filter_chain_exchange const&) = delete;
+
+    ~filter_chain_exchange()
+    { clear(); }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Control thread functions
+    ////////////////////////////////////////////////////////////////////////////
+
+    void publish(std::unique_ptr<filter_chain> x) noexcept
+    {
+        reclaim();
+        delete pending_.exchange(x.release(), std::memory_order_acq_rel);
+    }
+
+    void reclaim() noexcept
+    {
+        auto p = retired_.exchange(nullptr, std::memory_order_acquire);
+        while (p != nullptr) {
+            delete std::exchange(p, p->retired_next_);
+        }
+    }
+
+    void clear() noexcept
+    {
+        delete pending_.exchange(nullptr, std::memory_order_acquire);
+        reclaim();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Decoder thread functions
+    ////////////////////////////////////////////////////////////////////////////
+
+    std::unique_ptr<filter_chain> take() noexcept
+    {
+        if (AMP_LIKELY(pending_.load(std::memory_order_relaxed) == nullptr)) {
+            return nullptr;
+        }
+        auto const p = pending_.exchange(nullptr, std::memory_order_acquire);
+        return std::unique_ptr<filter_chain>{p};
+    }
+
+    void retire(std::unique_ptr<filter_chain> x) noexcept
+    {
+        auto const p = x.release();
+        if (p == nullptr) {
+            return;
+        }
+        p->retired_next_ = retired_.load(std::memory_order_relaxed);
+        while (!retired_.compare_exchange_weak(p->retired_next_, p,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+        }
+    }
+
+private:
+    std::atomic<filter_chain*> pending_{nullptr};
+    std::atomic<filter_chain*> retired_{nullptr};
 };
 
 }}    // namespace amp::audio
 
 
 #endif  // AMP_INCLUDED_F6E06AF5_8E91_40D9_B008_456CC77C1312
-
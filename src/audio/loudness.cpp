@@ -0,0 +1,406 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// audio/loudness.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/format.hpp>
+#include <amp/audio/kweighting.hpp>
+#include <amp/numeric.hpp>
+#include <amp/range.hpp>
+#include <amp/stddef.hpp>
+
+#include "audio/loudness.hpp"
+#include "core/cpu.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#if defined(AMP_HAS_X86) || defined(AMP_HAS_X64)
+# include <emmintrin.h>
+#endif
+
+
+namespace amp {
+namespace audio {
+namespace {
+
+constexpr double absolute_gate = -70.;
+constexpr double relative_gate = -10.;
+constexpr double bins_per_lu = 10.;
+
+// Taps per phase of the true peak interpolator, and its phase count.
+constexpr std::size_t peak_taps = 12;
+constexpr std::size_t peak_phases = 4;
+
+inline double energy_to_loudness(double const energy) noexcept
+{
+    return -0.691 + 10. * std::log10(energy);
+}
+
+inline std::size_t bin_index(double const lufs) noexcept
+{
+    auto const x = std::floor((lufs - absolute_gate) * bins_per_lu);
+    return static_cast<std::size_t>(std::clamp(
+        x, 0., double{loudness_histogram::bin_count - 1}));
+}
+
+// Interpolates a sample at `phase / peak_phases` between two inputs, with a
+// Hann-windowed sinc. Tap `k` weighs the k-th oldest input of the window.
+void design_interpolator(float* const fir) noexcept
+{
+    auto const half = static_cast<double>(peak_taps) / 2.;
+
+    for (auto const p : xrange(peak_phases)) {
+        double h[peak_taps];
+        auto sum = 0.;
+        for (auto const k : xrange(peak_taps)) {
+            auto const t = static_cast<double>(k) + 1. - half
+                         - static_cast<double>(p) / peak_phases;
+            auto const x = pi<double> * t;
+            auto const sinc = (std::abs(x) < 1e-12) ? 1. : std::sin(x) / x;
+            auto const window = .5 + .5 * std::cos(pi<double> * t
+                                                   / (half + .5));
+            h[k] = sinc * window;
+            sum += h[k];
+        }
+        for (auto const k : xrange(peak_taps)) {
+            fir[k * peak_phases + p] = static_cast<float>(h[k] / sum);
+        }
+    }
+}
+
+// Once the signal stops, the filters' states decay exponentially; they are
+// cut off long before they would become denormal.
+template<typename T>
+inline void flush_tiny(T* const state, std::size_t const n) noexcept
+{
+    for (auto const i : xrange(n)) {
+        if (std::abs(state[i]) < T(1e-20)) {
+            state[i] = T(0);
+        }
+    }
+}
+
+
+using weighting_kernel = double(kweighting<double> const& kw,
+                                double* state, double const* weights,
+                                float const* x, std::size_t frames,
+                                uint32 channels);
+
+// Returns the weighted sum of squares of the K-weighted samples.
+double kweight_generic(kweighting<double> const& kw, double* const state,
+                       double const* const weights, float const* const x,
+                       std::size_t const frames, uint32 const channels)
+{
+    auto sum = 0.;
+    for (auto const c : xrange(channels)) {
+        auto const s = &state[(c / 2) * 8 + (c % 2)];
+        auto s1 = s[0], s2 = s[2], p1 = s[4], p2 = s[6];
+        auto acc = 0.;
+
+        for (auto const t : xrange(frames)) {
+            auto const z = kw(static_cast<double>(x[t * channels + c]),
+                              s1, s2, p1, p2);
+            acc += z * z;
+        }
+        s[0] = s1; s[2] = s2; s[4] = p1; s[6] = p2;
+        sum += acc * weights[c];
+    }
+    flush_tiny(state, ((channels + 1) / 2) * 8_sz);
+    return sum;
+}
+
+#if defined(AMP_HAS_X86) || defined(AMP_HAS_X64)
+
+AMP_TARGET("sse2")
+double kweight_sse2(kweighting<double> const& kw, double* const state,
+                    double const* const weights, float const* const x,
+                    std::size_t const frames, uint32 const channels)
+{
+    auto const b0 = _mm_set1_pd(kw.shelf[0]);
+    auto const b1 = _mm_set1_pd(kw.shelf[1]);
+    auto const b2 = _mm_set1_pd(kw.shelf[2]);
+    auto const a1 = _mm_set1_pd(kw.shelf[3]);
+    auto const a2 = _mm_set1_pd(kw.shelf[4]);
+    auto const c1 = _mm_set1_pd(kw.pass[3]);
+    auto const c2 = _mm_set1_pd(kw.pass[4]);
+
+    auto sum = _mm_setzero_pd();
+    for (auto c = 0_sz; c < channels; c += 2) {
+        auto const s = &state[(c / 2) * 8];
+        auto s1 = _mm_loadu_pd(&s[0]);
+        auto s2 = _mm_loadu_pd(&s[2]);
+        auto p1 = _mm_loadu_pd(&s[4]);
+        auto p2 = _mm_loadu_pd(&s[6]);
+        auto acc = _mm_setzero_pd();
+
+        auto in = &x[c];
+        auto const pair = (c + 1 < channels);
+
+        AMP_DISABLE_LOOP_UNROLLING_AND_VECTORIZATION
+        for (auto t = 0_sz; t != frames; ++t, in += channels) {
+            auto const v = pair
+                ? _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(
+                      reinterpret_cast<__m128i const*>(in))))
+                : _mm_cvtps_pd(_mm_load_ss(in));
+
+            auto const y = _mm_add_pd(_mm_mul_pd(b0, v), s1);
+            s1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(b1, v),
+                                       _mm_mul_pd(a1, y)), s2);
+            s2 = _mm_sub_pd(_mm_mul_pd(b2, v), _mm_mul_pd(a2, y));
+
+            auto const z = _mm_add_pd(y, p1);
+            p1 = _mm_sub_pd(_mm_sub_pd(p2, _mm_add_pd(y, y)),
+                            _mm_mul_pd(c1, z));
+            p2 = _mm_sub_pd(y, _mm_mul_pd(c2, z));
+
+            acc = _mm_add_pd(acc, _mm_mul_pd(z, z));
+        }
+
+        _mm_storeu_pd(&s[0], s1);
+        _mm_storeu_pd(&s[2], s2);
+        _mm_storeu_pd(&s[4], p1);
+        _mm_storeu_pd(&s[6], p2);
+        sum = _mm_add_pd(sum, _mm_mul_pd(acc, _mm_loadu_pd(&weights[c])));
+    }
+    flush_tiny(state, ((channels + 1) / 2) * 8_sz);
+
+    return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+}
+
+#endif  // AMP_HAS_X86 || AMP_HAS_X64
+
+weighting_kernel* select_weighting_kernel() noexcept
+{
+#if defined(AMP_HAS_X86) || defined(AMP_HAS_X64)
+    if (cpu::has_sse2()) {
+        return &kweight_sse2;
+    }
+#endif
+    return &kweight_generic;
+}
+
+
+using peak_kernel = void(float const* fir, float* history, std::size_t& pos,
+                         float* peak, float const* x, std::size_t frames,
+                         uint32 channels);
+
+void peak_generic(float const* const fir, float* const history,
+                  std::size_t& pos, float* const peak, float const* x,
+                  std::size_t const frames, uint32 const channels) noexcept
+{
+    auto const stride = peak_taps * 2;
+
+    for (auto const t : xrange(frames)) {
+        for (auto const c : xrange(channels)) {
+            auto const h = &history[c * stride];
+            h[pos] = h[pos + peak_taps] = x[t * channels + c];
+
+            float acc[peak_phases]{};
+            for (auto const k : xrange(peak_taps)) {
+                for (auto const p : xrange(peak_phases)) {
+                    acc[p] += fir[k * peak_phases + p] * h[pos + 1 + k];
+                }
+            }
+            for (auto const p : xrange(peak_phases)) {
+                peak[p] = std::max(peak[p], std::abs(acc[p]));
+            }
+        }
+        pos = (pos + 1) % peak_taps;
+    }
+}
+
+#if defined(AMP_HAS_X86) || defined(AMP_HAS_X64)
+
+// The phases of one output are in the lanes of a vector, so that each input
+// of the window costs one broadcast and one multiply-add.
+AMP_TARGET("sse")
+void peak_sse(float const* const fir, float* const history, std::size_t& pos,
+              float* const peak, float const* x, std::size_t const frames,
+              uint32 const channels) noexcept
+{
+    static_assert(peak_phases == 4, "");
+    auto const stride = peak_taps * 2;
+    auto const sign = _mm_set1_ps(-0.f);
+
+    __m128 h[peak_taps];
+    for (auto const k : xrange(peak_taps)) {
+        h[k] = _mm_loadu_ps(&fir[k * peak_phases]);
+    }
+    auto max = _mm_loadu_ps(peak);
+
+    for (auto n = frames; n != 0; --n) {
+        for (auto const c : xrange(channels)) {
+            auto const w = &history[c * stride];
+            w[pos] = w[pos + peak_taps] = *x++;
+
+            auto const in = &w[pos + 1];
+            auto acc0 = _mm_mul_ps(h[0], _mm_set1_ps(in[0]));
+            auto acc1 = _mm_mul_ps(h[1], _mm_set1_ps(in[1]));
+
+            AMP_DISABLE_LOOP_UNROLLING_AND_VECTORIZATION
+            for (auto k = 2_sz; k != peak_taps; k += 2) {
+                acc0 = _mm_add_ps(acc0, _mm_mul_ps(h[k + 0],
+                                                   _mm_set1_ps(in[k + 0])));
+                acc1 = _mm_add_ps(acc1, _mm_mul_ps(h[k + 1],
+                                                   _mm_set1_ps(in[k + 1])));
+            }
+            max = _mm_max_ps(max, _mm_andnot_ps(sign,
+                                                _mm_add_ps(acc0, acc1)));
+        }
+        pos = (pos + 1 == peak_taps) ? 0 : pos + 1;
+    }
+    _mm_storeu_ps(peak, max);
+}
+
+#endif  // AMP_HAS_X86 || AMP_HAS_X64
+
+peak_kernel* select_peak_kernel() noexcept
+{
+#if defined(AMP_HAS_X86) || defined(AMP_HAS_X64)
+    if (cpu::has_sse()) {
+        return &peak_sse;
+    }
+#endif
+    return &peak_generic;
+}
+
+}     // namespace <unnamed>
+
+
+void loudness_histogram::add(double const energy) noexcept
+{
+    auto const lufs = energy_to_loudness(energy);
+    if (!(lufs >= absolute_gate)) {
+        return;
+    }
+
+    auto const i = bin_index(lufs);
+    count_[i] += 1;
+    energy_[i] += energy;
+    blocks_ += 1;
+}
+
+void loudness_histogram::merge(loudness_histogram const& x) noexcept
+{
+    for (auto const i : xrange(bin_count)) {
+        count_[i] += x.count_[i];
+        energy_[i] += x.energy_[i];
+    }
+    blocks_ += x.blocks_;
+}
+
+double loudness_histogram::integrated() const noexcept
+{
+    if (blocks_ == 0) {
+        return -inf<double>;
+    }
+
+    auto energy = 0.;
+    for (auto const i : xrange(bin_count)) {
+        energy += energy_[i];
+    }
+    auto const gate = energy_to_loudness(energy / static_cast<double>(blocks_))
+                    + relative_gate;
+
+    // The bin holding the gate is kept whole, as is done by libebur128.
+    auto count = uint64{0};
+    energy = 0.;
+    for (auto const i : xrange(bin_index(gate), bin_count)) {
+        count += count_[i];
+        energy += energy_[i];
+    }
+    return energy_to_loudness(energy / static_cast<double>(count));
+}
+
+
+loudness_meter::loudness_meter(audio::format const& fmt) :
+    channels_{fmt.channels}
+{
+    kweighting_.design(static_cast<double>(fmt.sample_rate));
+
+    auto const pairs = (channels_ + 1) / 2_sz;
+    state_.assign(pairs * 8, 0.);
+    weights_.assign(pairs * 2, 0.);
+
+    // Layouts that do not describe every channel weigh the rest as fronts.
+    auto layout = fmt.channel_layout;
+    for (auto const c : xrange(channels_)) {
+        auto const bit = layout & (~layout + 1);
+        weights_[c] = kweighting_channel_weight<double>(bit);
+        layout &= ~bit;
+    }
+
+    step_frames_ = std::max(std::size_t{fmt.sample_rate} / 10, 1_sz);
+
+    // BS.1770-4 deems 4x oversampling enough at 48 kHz; from 192 kHz up,
+    // the samples are as close together as that already.
+    oversample_ = (fmt.sample_rate < 192000);
+    if (oversample_) {
+        fir_.resize(peak_taps * peak_phases);
+        design_interpolator(fir_.data());
+        history_.assign(channels_ * peak_taps * 2, 0.f);
+    }
+}
+
+void loudness_meter::process(float const* const samples,
+                             std::size_t const frames) noexcept
+{
+    peak_(samples, frames);
+    filter_(samples, frames);
+}
+
+void loudness_meter::filter_(float const* samples, std::size_t frames) noexcept
+{
+    static auto const kernel = select_weighting_kernel();
+
+    while (frames != 0) {
+        auto const n = std::min(frames, step_frames_ - step_fill_);
+        step_energy_ += (*kernel)(kweighting_, state_.data(), weights_.data(),
+                                  samples, n, channels_);
+        samples += n * channels_;
+        frames -= n;
+
+        step_fill_ += n;
+        if (step_fill_ != step_frames_) {
+            break;
+        }
+
+        // Gating blocks are 400ms long, and overlap by 75%.
+        steps_[step_count_++ % 4] = step_energy_
+                                  / static_cast<double>(step_frames_);
+        step_energy_ = 0.;
+        step_fill_ = 0;
+
+        if (step_count_ >= 4) {
+            histogram_.add((steps_[0] + steps_[1] + steps_[2] + steps_[3])
+                           / 4.);
+        }
+    }
+}
+
+void loudness_meter::peak_(float const* const samples,
+                           std::size_t const frames) noexcept
+{
+    if (oversample_) {
+        static auto const kernel = select_peak_kernel();
+        (*kernel)(fir_.data(), history_.data(), history_pos_, peak_max_,
+                  samples, frames, channels_);
+        return;
+    }
+
+    for (auto const i : xrange(frames * channels_)) {
+        peak_max_[0] = std::max(peak_max_[0], std::abs(samples[i]));
+    }
+}
+
+float loudness_meter::true_peak() const noexcept
+{
+    return std::max(std::max(peak_max_[0], peak_max_[1]),
+                    std::max(peak_max_[2], peak_max_[3]));
+}
+
+}}    // namespace amp::audio
@@ -0,0 +1,112 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// audio/loudness.hpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef AMP_INCLUDED_1F9B67C2_7FFC_4CA2_A882_12C4575DE1A2
+#define AMP_INCLUDED_1F9B67C2_7FFC_4CA2_A882_12C4575DE1A2
+
+
+#include <amp/audio/format.hpp>
+#include <amp/audio/kweighting.hpp>
+#include <amp/stddef.hpp>
+
+#include <cstddef>
+#include <vector>
+
+
+namespace amp {
+namespace audio {
+
+// ReplayGain 2.0 normalizes to -18 LUFS.
+constexpr double replaygain_reference = -18.;
+
+
+// -- Overview --
+//
+// The gating blocks of an ITU-R BS.1770 measurement, binned by loudness in
+// steps of 0.1 LU between the absolute gate (-70 LUFS) and +5 LUFS. Each bin
+// keeps the sum of its blocks' energies, so the gated mean is exact and only
+// the gating decision is rounded to a bin edge. Histograms of several tracks
+// merge into that of the album, at a fixed, small size.
+
+class loudness_histogram
+{
+public:
+    static constexpr std::size_t bin_count = 750;
+
+    void add(double energy) noexcept;
+    void merge(loudness_histogram const&) noexcept;
+
+    // Gated (integrated) loudness in LUFS; -inf if nothing was loud enough.
+    double integrated() const noexcept;
+
+    bool empty() const noexcept
+    { return blocks_ == 0; }
+
+private:
+    uint32 count_[bin_count]{};
+    double energy_[bin_count]{};
+    uint64 blocks_{};
+};
+
+
+// -- Overview --
+//
+// Measures the integrated loudness (BS.1770-4) and true peak of a stream of
+// interleaved frames. The K-weighting filters run in double precision, two
+// channels to a vector: at high sample rates the high pass's poles are too
+// close to the unit circle for single precision. Below 192 kHz, the true
+// peak is taken on a 4x oversampled signal, with the four phases in the
+// lanes of one vector.
+
+class loudness_meter
+{
+public:
+    explicit loudness_meter(audio::format const&);
+
+    void process(float const* samples, std::size_t frames) noexcept;
+
+    loudness_histogram const& histogram() const noexcept
+    { return histogram_; }
+
+    double integrated() const noexcept
+    { return histogram_.integrated(); }
+
+    // Linear, relative to full scale.
+    float true_peak() const noexcept;
+
+private:
+    void filter_(float const* samples, std::size_t frames) noexcept;
+    void peak_(float const* samples, std::size_t frames) noexcept;
+
+    loudness_histogram histogram_;
+
+    kweighting<double> kweighting_;
+    std::vector<double> state_;         // [channel pair][8]
+    std::vector<double> weights_;       // [channel], padded to pairs
+
+    // Energy of the last four 100ms steps; a gating block is 400ms.
+    double steps_[4]{};
+    double step_energy_{};
+    std::size_t step_count_{};
+    std::size_t step_frames_{};
+    std::size_t step_fill_{};
+
+    // True peak oversampling: [tap][phase], and per channel a history
+    // written twice over, so that it can always be read contiguously.
+    std::vector<float> fir_;
+    std::vector<float> history_;        // [channel][2 * taps]
+    std::size_t history_pos_{};
+    float peak_max_[4]{};
+    bool oversample_{};
+
+    uint32 channels_;
+};
+
+}}    // namespace amp::audio
+
+
+#endif  // AMP_INCLUDED_1F9B67C2_7FFC_4CA2_A882_12C4575DE1A2
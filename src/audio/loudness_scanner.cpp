@@ -0,0 +1,234 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// audio/loudness_scanner.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/format.hpp>
+#include <amp/audio/input.hpp>
+#include <amp/audio/packet.hpp>
+#include <amp/flat_map.hpp>
+#include <amp/media/tags.hpp>
+#include <amp/net/uri.hpp>
+#include <amp/numeric.hpp>
+#include <amp/range.hpp>
+#include <amp/stddef.hpp>
+#include <amp/u8string.hpp>
+
+#include "audio/loudness.hpp"
+#include "audio/loudness_scanner.hpp"
+#include "media/track.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <exception>
+#include <limits>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+namespace amp {
+namespace audio {
+namespace {
+
+constexpr auto no_album = std::numeric_limits<std::size_t>::max();
+
+struct album_state
+{
+    loudness_histogram histogram;
+    float peak{};
+};
+
+u8string find_tag(media::dictionary const& dict, std::string_view const key)
+{
+    auto const pos = dict.find(key);
+    return (pos != dict.end()) ? pos->second : u8string{};
+}
+
+void store_result(media::dictionary& info, std::string_view const gain_key,
+                  std::string_view const peak_key, double const lufs,
+                  float const peak)
+{
+    if (std::isfinite(lufs)) {
+        info.insert_or_assign(gain_key, u8format(
+            "%.2f dB", replaygain_reference - lufs));
+    }
+    info.insert_or_assign(peak_key, u8format("%.6f", double{peak}));
+}
+
+}     // namespace <unnamed>
+
+
+media::track_handle loudness_result::apply(media::track_handle const& t) const
+{
+    if (!measured()) {
+        return t;
+    }
+
+    auto x = *t;
+    store_result(x.info, tags::rg_track_gain, tags::rg_track_peak,
+                 track_loudness, track_peak);
+    if (album_peak >= 0.f) {
+        store_result(x.info, tags::rg_album_gain, tags::rg_album_peak,
+                     album_loudness, album_peak);
+    }
+    return media::track_handle{std::move(x)};
+}
+
+
+std::vector<loudness_result> loudness_scanner::run(
+    std::vector<media::track_handle> const& tracks, uint32 threads)
+{
+    done_.store(0, std::memory_order_relaxed);
+    cancel_.store(false, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> const lk{mtx_};
+        errors_.clear();
+    }
+
+    // Albums are told apart by their album artist, so that two albums of the
+    // same name by different artists are not merged.
+    flat_map<std::pair<u8string, u8string>, std::size_t> album_index;
+    std::vector<album_state> albums;
+    std::vector<std::size_t> album_of(tracks.size(), no_album);
+    std::vector<loudness_result> results(tracks.size());
+
+    for (auto const i : xrange(tracks.size())) {
+        auto album = find_tag(tracks[i]->tags, tags::album);
+        if (!album.empty()) {
+            auto const found = album_index.try_emplace(
+                std::make_pair(find_tag(tracks[i]->tags, tags::album_artist),
+                               std::move(album)),
+                albums.size());
+            if (found.second) {
+                albums.emplace_back();
+            }
+            album_of[i] = found.first->second;
+        }
+    }
+
+    // Decoding a track is far more work than claiming it, so a shared cursor
+    // balances the load as well as per-thread queues would; with the longest
+    // tracks first, the threads also run out of work at about the same time.
+    std::vector<std::size_t> order(tracks.size());
+    std::vector<uint64> length(tracks.size());
+    for (auto const i : xrange(order.size())) {
+        auto const& t = *tracks[i];
+        order[i] = i;
+        length[i] = muldiv(t.frames, uint64{48000},
+                           std::max(t.sample_rate, uint32{1}));
+    }
+    std::stable_sort(order.begin(), order.end(), [&](auto x, auto y) {
+        return length[x] > length[y];
+    });
+
+    std::atomic<std::size_t> cursor{0};
+    std::mutex album_mtx;
+
+    auto measure = [&](std::size_t const i) {
+        auto const in = (*open_)(*tracks[i]);
+        auto const fmt = in->get_format();
+        loudness_meter meter{fmt};
+        audio::packet pkt;
+
+        for (;;) {
+            if (canceled()) {
+                return;
+            }
+            pkt.clear();
+            pkt.set_channel_layout(fmt.channel_layout);
+            in->read(pkt);
+            if (pkt.empty()) {
+                break;
+            }
+            meter.process(pkt.data(), pkt.frames());
+        }
+
+        results[i].track_loudness = meter.integrated();
+        results[i].track_peak = meter.true_peak();
+
+        if (album_of[i] != no_album) {
+            std::lock_guard<std::mutex> const lk{album_mtx};
+            auto& album = albums[album_of[i]];
+            album.histogram.merge(meter.histogram());
+            album.peak = std::max(album.peak, meter.true_peak());
+        }
+    };
+
+    auto worker = [&]() noexcept {
+        for (;;) {
+            auto const i = cursor.fetch_add(1, std::memory_order_relaxed);
+            if (i >= order.size() || canceled()) {
+                return;
+            }
+
+            try {
+                measure(order[i]);
+            }
+            catch (std::exception const& ex) {
+                auto const& t = *tracks[order[i]];
+                std::lock_guard<std::mutex> const lk{mtx_};
+                errors_.push_back(u8format("%s: %s",
+                                           to_u8string(t.location).c_str(),
+                                           ex.what()));
+            }
+            done_.fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+
+    if (threads == 0) {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    threads = static_cast<uint32>(std::min<std::size_t>(threads,
+                                                        tracks.size()));
+
+    // The calling thread is one of the workers.
+    std::vector<std::thread> pool;
+    pool.reserve(threads);
+    for (auto n = threads; n > 1; --n) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto&& thread : pool) {
+        thread.join();
+    }
+
+    if (canceled()) {
+        return results;
+    }
+
+    // An album is only as complete as its tracks: one that failed to decode
+    // would otherwise be left out of the album gain silently.
+    for (auto const i : xrange(tracks.size())) {
+        if (album_of[i] != no_album && !results[i].measured()) {
+            albums[album_of[i]].peak = -1.f;
+        }
+    }
+    for (auto const i : xrange(tracks.size())) {
+        if (album_of[i] != no_album) {
+            auto const& album = albums[album_of[i]];
+            if (album.peak >= 0.f) {
+                results[i].album_loudness = album.histogram.integrated();
+                results[i].album_peak = album.peak;
+            }
+        }
+    }
+    return results;
+}
+
+void loudness_scanner::cancel() noexcept
+{
+    cancel_.store(true, std::memory_order_relaxed);
+}
+
+std::vector<u8string> loudness_scanner::errors() const
+{
+    std::lock_guard<std::mutex> const lk{mtx_};
+    return errors_;
+}
+
+}}    // namespace amp::audio
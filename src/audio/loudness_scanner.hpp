@@ -0,0 +1,111 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// audio/loudness_scanner.hpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef AMP_INCLUDED_39CD9BDE_3E1F_4690_961A_380209AEAD1C
+#define AMP_INCLUDED_39CD9BDE_3E1F_4690_961A_380209AEAD1C
+
+
+#include <amp/audio/input.hpp>
+#include <amp/ref_ptr.hpp>
+#include <amp/stddef.hpp>
+#include <amp/u8string.hpp>
+
+#include "audio/input_slice.hpp"
+#include "media/track.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+
+namespace amp {
+namespace audio {
+
+// The measurements of one track. A peak is negative when there is no value:
+// the track could not be decoded, or it has no album, or another track of
+// its album could not be decoded.
+
+struct loudness_result
+{
+    double track_loudness{-std::numeric_limits<double>::infinity()};
+    double album_loudness{-std::numeric_limits<double>::infinity()};
+    float track_peak{-1.f};
+    float album_peak{-1.f};
+
+    bool measured() const noexcept
+    { return track_peak >= 0.f; }
+
+    // Returns a copy of `t` with the ReplayGain 2.0 tags of this result in
+    // its `info` dictionary, where audio::replaygain_info reads them from;
+    // `t` itself if nothing was measured.
+    media::track_handle apply(media::track_handle const& t) const;
+};
+
+
+// -- Overview --
+//
+// Computes ReplayGain 2.0 values for a set of tracks. Tracks are decoded and
+// measured in parallel, on as many threads as there are cores; the longest
+// are handed out first, so that a long track is not left to run alone at
+// the end. Tracks sharing an album and album artist tag also get album
+// values, from their merged gating histograms.
+//
+// Tracks are shared and immutable, so run() returns one result per track
+// instead of changing them; a playlist entry takes its values with
+// `*it = result.apply(*it)`. run() blocks until every track is measured or
+// the scan is canceled, in which case there are no album values; the other
+// members may be called from any thread meanwhile.
+
+class loudness_scanner
+{
+public:
+    using open_function = ref_ptr<audio::input>(media::track const&);
+
+    // By default, tracks are opened as they are for playback.
+    explicit loudness_scanner(open_function* const open = &open_track_)
+        noexcept :
+        open_{open}
+    {}
+
+    std::vector<loudness_result> run(
+        std::vector<media::track_handle> const&, uint32 threads = 0);
+    void cancel() noexcept;
+
+    // Number of tracks measured so far, failed ones included.
+    std::size_t progress() const noexcept
+    { return done_.load(std::memory_order_relaxed); }
+
+    bool canceled() const noexcept
+    { return cancel_.load(std::memory_order_relaxed); }
+
+    // One message per track that could not be decoded.
+    std::vector<u8string> errors() const;
+
+private:
+    static ref_ptr<audio::input> open_track_(media::track const& t)
+    {
+        auto in = audio::input::resolve(t.location, audio::playback);
+        if (t.chapter) {
+            in = audio::input_slice::make(std::move(in), t);
+        }
+        return in;
+    }
+
+    open_function* const open_;
+    std::atomic<std::size_t> done_{0};
+    std::atomic<bool> cancel_{false};
+    std::vector<u8string> errors_;
+    mutable std::mutex mtx_;
+};
+
+}}    // namespace amp::audio
+
+
+#endif  // AMP_INCLUDED_39CD9BDE_3E1F_4690_961A_380209AEAD1C
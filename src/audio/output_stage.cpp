@@ -0,0 +1,408 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// audio/output_stage.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/format.hpp>
+#include <amp/bitops.hpp>
+#include <amp/numeric.hpp>
+#include <amp/range.hpp>
+#include <amp/stddef.hpp>
+
+#include "audio/output_stage.hpp"
+#include "core/cpu.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#if defined(AMP_HAS_X86) || defined(AMP_HAS_X64)
+# include <immintrin.h>
+#endif
+
+
+namespace amp {
+namespace audio {
+namespace {
+
+// The soft limiter is linear up to -1 dBFS, and above it approaches full
+// scale along x/(1+x), which meets the linear part with the same slope.
+constexpr float knee = 0.891250938f;
+constexpr float knee_slope = 1.f / (1.f - knee);
+
+
+// ----------------------------------------------------------------------------
+// Scalar building blocks, also used for the tails of the vectorized kernels.
+// ----------------------------------------------------------------------------
+
+AMP_INLINE uint32 xorshift(uint32& s) noexcept
+{
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    return s;
+}
+
+// Maps the upper 23 bits of `x` to a float in [0,1).
+AMP_INLINE float to_unit(uint32 const x) noexcept
+{
+    auto const bits = (x >> 9) | 0x3f800000U;
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f - 1.f;
+}
+
+template<limiter_mode Limiter>
+AMP_INLINE float limit(float const x) noexcept
+{
+    if (Limiter == limiter_mode::clip) {
+        return (x < -1.f) ? -1.f : (x > 1.f) ? 1.f : x;
+    }
+    auto const a = std::fabs(x);
+    auto const e = std::max(a - knee, 0.f);
+    return std::copysign(std::min(a, knee + e / (1.f + e * knee_slope)), x);
+}
+
+template<limiter_mode Limiter, bool Dither>
+AMP_INLINE float process_one(float x, float const gain, float const dither,
+                             uint32& seed) noexcept
+{
+    x *= gain;
+    if (Dither) {
+        auto const r0 = to_unit(xorshift(seed));
+        auto const r1 = to_unit(xorshift(seed));
+        x += (r0 - r1) * dither;
+    }
+    return limit<Limiter>(x);
+}
+
+
+// ----------------------------------------------------------------------------
+// dst[i] = limit(src[i] * (gain + step * i) + tpdf() * dither)
+// ----------------------------------------------------------------------------
+
+template<limiter_mode Limiter, bool Dither>
+void process_generic(float const* const src, float* const dst,
+                     std::size_t const n, float const gain, float const step,
+                     float const dither, uint32* const seed) noexcept
+{
+    for (auto const i : xrange(n)) {
+        auto const g = gain + step * static_cast<float>(i);
+        dst[i] = process_one<Limiter, Dither>(src[i], g, dither, seed[0]);
+    }
+}
+
+#if defined(AMP_HAS_X86) || defined(AMP_HAS_X64)
+
+AMP_TARGET("sse2")
+AMP_INLINE __m128i xorshift(__m128i& s) noexcept
+{
+    s = _mm_xor_si128(s, _mm_slli_epi32(s, 13));
+    s = _mm_xor_si128(s, _mm_srli_epi32(s, 17));
+    s = _mm_xor_si128(s, _mm_slli_epi32(s, 5));
+    return s;
+}
+
+AMP_TARGET("sse2")
+AMP_INLINE __m128 tpdf(__m128i& s) noexcept
+{
+    auto const one = _mm_set1_epi32(0x3f800000);
+    auto const r0 = _mm_or_si128(_mm_srli_epi32(xorshift(s), 9), one);
+    auto const r1 = _mm_or_si128(_mm_srli_epi32(xorshift(s), 9), one);
+    return _mm_sub_ps(_mm_castsi128_ps(r0), _mm_castsi128_ps(r1));
+}
+
+template<limiter_mode Limiter>
+AMP_TARGET("sse2")
+AMP_INLINE __m128 limit(__m128 const x) noexcept
+{
+    if (Limiter == limiter_mode::clip) {
+        return _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-1.f)), _mm_set1_ps(1.f));
+    }
+    auto const sign = _mm_and_ps(x, _mm_set1_ps(-0.f));
+    auto const a = _mm_xor_ps(x, sign);
+    auto const e = _mm_max_ps(_mm_sub_ps(a, _mm_set1_ps(knee)),
+                              _mm_setzero_ps());
+    auto const d = _mm_add_ps(_mm_set1_ps(1.f),
+                              _mm_mul_ps(e, _mm_set1_ps(knee_slope)));
+    auto const y = _mm_add_ps(_mm_set1_ps(knee), _mm_div_ps(e, d));
+    return _mm_or_ps(_mm_min_ps(a, y), sign);
+}
+
+template<limiter_mode Limiter, bool Dither>
+AMP_TARGET("sse2")
+void process_sse2(float const* const src, float* const dst,
+                  std::size_t const n, float const gain, float const step,
+                  float const dither, uint32* const seed) noexcept
+{
+    auto s = _mm_load_si128(reinterpret_cast<__m128i const*>(seed));
+    auto g = _mm_add_ps(_mm_set1_ps(gain),
+                        _mm_mul_ps(_mm_set1_ps(step),
+                                   _mm_setr_ps(0.f, 1.f, 2.f, 3.f)));
+    auto const g_step = _mm_set1_ps(step * 4);
+    auto const d = _mm_set1_ps(dither);
+    auto i = 0_sz;
+
+    AMP_DISABLE_LOOP_UNROLLING_AND_VECTORIZATION
+    for (auto const last = align_down(n, 4); i != last; i += 4) {
+        auto x = _mm_mul_ps(_mm_loadu_ps(&src[i]), g);
+        if (Dither) {
+            x = _mm_add_ps(x, _mm_mul_ps(tpdf(s), d));
+        }
+        _mm_storeu_ps(&dst[i], limit<Limiter>(x));
+        g = _mm_add_ps(g, g_step);
+    }
+    _mm_store_si128(reinterpret_cast<__m128i*>(seed), s);
+
+    AMP_DISABLE_LOOP_UNROLLING_AND_VECTORIZATION
+    for (; i != n; ++i) {
+        auto const gi = gain + step * static_cast<float>(i);
+        dst[i] = process_one<Limiter, Dither>(src[i], gi, dither, seed[0]);
+    }
+}
+
+AMP_TARGET("avx2")
+AMP_INLINE __m256i xorshift(__m256i& s) noexcept
+{
+    s = _mm256_xor_si256(s, _mm256_slli_epi32(s, 13));
+    s = _mm256_xor_si256(s, _mm256_srli_epi32(s, 17));
+    s = _mm256_xor_si256(s, _mm256_slli_epi32(s, 5));
+    return s;
+}
+
+AMP_TARGET("avx2")
+AMP_INLINE __m256 tpdf(__m256i& s) noexcept
+{
+    auto const one = _mm256_set1_epi32(0x3f800000);
+    auto const r0 = _mm256_or_si256(_mm256_srli_epi32(xorshift(s), 9), one);
+    auto const r1 = _mm256_or_si256(_mm256_srli_epi32(xorshift(s), 9), one);
+    return _mm256_sub_ps(_mm256_castsi256_ps(r0), _mm256_castsi256_ps(r1));
+}
+
+template<limiter_mode Limiter>
+AMP_TARGET("avx2")
+AMP_INLINE __m256 limit(__m256 const x) noexcept
+{
+    if (Limiter == limiter_mode::clip) {
+        return _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-1.f)),
+                             _mm256_set1_ps(1.f));
+    }
+    auto const sign = _mm256_and_ps(x, _mm256_set1_ps(-0.f));
+    auto const a = _mm256_xor_ps(x, sign);
+    auto const e = _mm256_max_ps(_mm256_sub_ps(a, _mm256_set1_ps(knee)),
+                                 _mm256_setzero_ps());
+    auto const d = _mm256_add_ps(_mm256_set1_ps(1.f),
+                                 _mm256_mul_ps(e, _mm256_set1_ps(knee_slope)));
+    auto const y = _mm256_add_ps(_mm256_set1_ps(knee), _mm256_div_ps(e, d));
+    return _mm256_or_ps(_mm256_min_ps(a, y), sign);
+}
+
+template<limiter_mode Limiter, bool Dither>
+AMP_TARGET("avx2")
+void process_avx2(float const* const src, float* const dst,
+                  std::size_t const n, float const gain, float const step,
+                  float const dither, uint32* const seed) noexcept
+{
+    auto s = _mm256_load_si256(reinterpret_cast<__m256i const*>(seed));
+    auto g = _mm256_add_ps(_mm256_set1_ps(gain),
+                           _mm256_mul_ps(_mm256_set1_ps(step),
+                                         _mm256_setr_ps(0.f, 1.f, 2.f, 3.f,
+                                                        4.f, 5.f, 6.f, 7.f)));
+    auto const g_step = _mm256_set1_ps(step * 8);
+    auto const d = _mm256_set1_ps(dither);
+    auto i = 0_sz;
+
+    AMP_DISABLE_LOOP_UNROLLING_AND_VECTORIZATION
+    for (auto const last = align_down(n, 8); i != last; i += 8) {
+        auto x = _mm256_mul_ps(_mm256_loadu_ps(&src[i]), g);
+        if (Dither) {
+            x = _mm256_add_ps(x, _mm256_mul_ps(tpdf(s), d));
+        }
+        _mm256_storeu_ps(&dst[i], limit<Limiter>(x));
+        g = _mm256_add_ps(g, g_step);
+    }
+    _mm256_store_si256(reinterpret_cast<__m256i*>(seed), s);
+
+    AMP_DISABLE_LOOP_UNROLLING_AND_VECTORIZATION
+    for (; i != n; ++i) {
+        auto const gi = gain + step * static_cast<float>(i);
+        dst[i] = process_one<Limiter, Dither>(src[i], gi, dither, seed[0]);
+    }
+}
+
+#endif  // AMP_HAS_X86 || AMP_HAS_X64
+
+template<limiter_mode Limiter, bool Dither>
+output_stage::kernel* select_kernel() noexcept
+{
+#if defined(AMP_HAS_X86) || defined(AMP_HAS_X64)
+    if (cpu::has_avx2()) {
+        return &process_avx2<Limiter, Dither>;
+    }
+    if (cpu::has_sse2()) {
+        return &process_sse2<Limiter, Dither>;
+    }
+#endif
+    return &process_generic<Limiter, Dither>;
+}
+
+output_stage::kernel* select_kernel(limiter_mode const limiter,
+                                    bool const dither) noexcept
+{
+    switch (limiter) {
+    case limiter_mode::clip:
+        return dither ? select_kernel<limiter_mode::clip, true>()
+                      : select_kernel<limiter_mode::clip, false>();
+    case limiter_mode::soft:
+        return dither ? select_kernel<limiter_mode::soft, true>()
+                      : select_kernel<limiter_mode::soft, false>();
+    }
+    AMP_UNREACHABLE();
+}
+
+
+// ----------------------------------------------------------------------------
+// dst[i] = src[i] * gain
+// ----------------------------------------------------------------------------
+
+void scale_generic(float const gain, float const* const src,
+                   float* const dst, std::size_t const n) noexcept
+{
+    for (auto const i : xrange(n)) {
+        dst[i] = src[i] * gain;
+    }
+}
+
+#if defined(AMP_HAS_X86) || defined(AMP_HAS_X64)
+
+AMP_TARGET("sse")
+void scale_sse(float const gain, float const* const src,
+               float* const dst, std::size_t const n) noexcept
+{
+    auto const g = _mm_set1_ps(gain);
+    auto i = 0_sz;
+
+    AMP_DISABLE_LOOP_UNROLLING_AND_VECTORIZATION
+    for (auto const last = align_down(n, 4); i != last; i += 4) {
+        _mm_storeu_ps(&dst[i], _mm_mul_ps(_mm_loadu_ps(&src[i]), g));
+    }
+
+    AMP_DISABLE_LOOP_UNROLLING_AND_VECTORIZATION
+    for (; i != n; ++i) {
+        dst[i] = src[i] * gain;
+    }
+}
+
+AMP_TARGET("avx")
+void scale_avx(float const gain, float const* const src,
+               float* const dst, std::size_t const n) noexcept
+{
+    auto const g = _mm256_set1_ps(gain);
+    auto i = 0_sz;
+
+    AMP_DISABLE_LOOP_UNROLLING_AND_VECTORIZATION
+    for (auto const last = align_down(n, 8); i != last; i += 8) {
+        _mm256_storeu_ps(&dst[i], _mm256_mul_ps(_mm256_loadu_ps(&src[i]), g));
+    }
+
+    AMP_DISABLE_LOOP_UNROLLING_AND_VECTORIZATION
+    for (; i != n; ++i) {
+        dst[i] = src[i] * gain;
+    }
+}
+
+#endif  // AMP_HAS_X86 || AMP_HAS_X64
+
+}     // namespace <unnamed>
+
+
+output_stage::output_stage(audio::format const& fmt,
+                           audio::output_stage_policy const& policy) noexcept :
+    samples_per_second_(uint64{fmt.sample_rate} * fmt.channels)
+{
+    // Any non-zero seeds will do, as long as the lanes differ.
+    for (auto const i : xrange(8)) {
+        seed_[i] = 0x9e3779b9U * static_cast<uint32>(i + 1);
+    }
+    set_policy(policy);
+}
+
+void output_stage::set_policy(audio::output_stage_policy const& x) noexcept
+{
+    auto const ms = static_cast<uint64>(std::max<int64>(x.volume_ramp.count(),
+                                                        0));
+    ramp_length_ = static_cast<std::size_t>(
+        std::max<uint64>(muldiv(ms, samples_per_second_, 1000), 1));
+
+    // One LSB at the device's word length, relative to full scale.
+    dither_ = (x.dither_bits != 0) ? std::ldexp(1.f, 1 - x.dither_bits) : 0.f;
+    kernel_ = select_kernel(x.limiter, x.dither_bits != 0);
+}
+
+void output_stage::set_volume(float const x) noexcept
+{
+#if __has_warning("-Wfloat-equal")
+# pragma clang diagnostic push
+# pragma clang diagnostic ignored "-Wfloat-equal"
+#endif
+    if (x == target_) {
+        return;
+    }
+#if __has_warning("-Wfloat-equal")
+# pragma clang diagnostic pop
+#endif
+
+    target_ = x;
+    ramp_ = ramp_length_;
+    step_ = (target_ - volume_) / static_cast<float>(ramp_);
+}
+
+void output_stage::process(float const* const src, float* const dst,
+                           std::size_t const n) noexcept
+{
+    auto i = 0_sz;
+    if (AMP_UNLIKELY(ramp_ != 0)) {
+        i = std::min(n, ramp_);
+        kernel_(src, dst, i, volume_, step_, dither_, seed_);
+
+        ramp_ -= i;
+        volume_ = (ramp_ != 0) ? volume_ + step_ * static_cast<float>(i)
+                               : target_;
+    }
+    if (i != n) {
+        kernel_(src + i, dst + i, n - i, volume_, 0.f, dither_, seed_);
+    }
+}
+
+void output_stage::scale(float const gain, float const* const src,
+                         float* const dst, std::size_t const n) noexcept
+{
+#if __has_warning("-Wfloat-equal")
+# pragma clang diagnostic push
+# pragma clang diagnostic ignored "-Wfloat-equal"
+#endif
+    if (gain == 1.f) {
+        if (src != dst) {
+            std::copy_n(src, n, dst);
+        }
+        return;
+    }
+#if __has_warning("-Wfloat-equal")
+# pragma clang diagnostic pop
+#endif
+
+#if defined(AMP_HAS_X86) || defined(AMP_HAS_X64)
+    if (cpu::has_avx()) {
+        return scale_avx(gain, src, dst, n);
+    }
+    if (cpu::has_sse()) {
+        return scale_sse(gain, src, dst, n);
+    }
+#endif
+    scale_generic(gain, src, dst, n);
+}
+
+}}    // namespace amp::audio
@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// audio/output_stage.hpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef AMP_INCLUDED_39C10124_3859_40B5_A70E_60396434E81F
+#define AMP_INCLUDED_39C10124_3859_40B5_A70E_60396434E81F
+
+
+#include <amp/audio/format.hpp>
+#include <amp/stddef.hpp>
+
+#include <chrono>
+#include <cstddef>
+
+
+namespace amp {
+namespace audio {
+
+enum class limiter_mode : uint8 {
+    clip,               // hard clip at full scale
+    soft,               // soft knee from -1 dBFS, never reaching full scale
+};
+
+struct output_stage_policy
+{
+    audio::limiter_mode limiter{audio::limiter_mode::clip};
+
+    // Word length of an integer device. If non-zero, TPDF dither at that
+    // resolution is added before the device converts the samples.
+    uint8 dither_bits{0};
+
+    // How long a volume change takes to ramp in.
+    std::chrono::milliseconds volume_ramp{20};
+};
+
+
+// -- Overview --
+//
+// Last stage of the audio path, run on the output callback as samples leave
+// the ring buffer: ramps the volume, then adds dither and limits, all in one
+// pass. ReplayGain only changes from one track to the next, so the player
+// thread applies it earlier, as it renders packets into the ring (scale()),
+// which keeps volume changes from lagging behind by the ring's length.
+
+class output_stage
+{
+public:
+    using kernel = void(float const*, float*, std::size_t,
+                        float, float, float, uint32*) noexcept;
+
+    explicit output_stage(audio::format const&,
+                          audio::output_stage_policy const& = {}) noexcept;
+
+    void set_policy(audio::output_stage_policy const&) noexcept;
+
+    // Ramps the volume towards `x`, unless that is already the target.
+    void set_volume(float x) noexcept;
+
+    float volume() const noexcept
+    { return volume_; }
+
+    // Processes `n` samples from `src` into `dst`. The two ranges may be
+    // identical, but must not otherwise overlap.
+    void process(float const* src, float* dst, std::size_t n) noexcept;
+
+    // Writes `n` samples of `src`, scaled by `gain`, to `dst`; with the same
+    // restrictions as process().
+    static void scale(float gain, float const* src, float* dst,
+                      std::size_t n) noexcept;
+
+private:
+    kernel* kernel_{};
+    uint64 samples_per_second_;
+    std::size_t ramp_length_{};
+    std::size_t ramp_{};
+    float volume_{1.f};
+    float target_{1.f};
+    float step_{};
+    float dither_{};
+    alignas(32) uint32 seed_[8];
+};
+
+}}    // namespace amp::audio
+
+
+#endif  // AMP_INCLUDED_39C10124_3859_40B5_A70E_60396434E81F
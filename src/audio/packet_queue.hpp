@@ -0,0 +1,154 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// audio/packet_queue.hpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef AMP_INCLUDED_EEE3B886_440D_4DEF_9172_FE11F3EB69EF
+#define AMP_INCLUDED_EEE3B886_440D_4DEF_9172_FE11F3EB69EF
+
+
+#include <amp/audio/packet.hpp>
+#include <amp/bitops.hpp>
+#include <amp/stddef.hpp>
+
+#include "core/cpu.hpp"
+#include "core/realtime.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+
+namespace amp {
+namespace audio {
+
+// -- Overview --
+//
+// Bounded lock-free queue of pre-allocated packets that is safe for a single
+// producer and a single consumer. Slots are never freed while the queue is
+// alive, so once every slot has been written to at least once, the packets'
+// buffers are simply recycled.
+//
+// Besides the fixed number of slots, the producer is also bounded by the total
+// number of samples that are currently enqueued. This lets the caller express
+// the queue's depth as a duration, independent of the size of each packet.
+
+
+class packet_queue
+{
+public:
+    enum flag : uint32 {
+        track_start   = (1 << 0),
+        discontinuity = (1 << 1),
+    };
+
+    struct slot
+    {
+        audio::packet pkt;
+        uint64 position;
+        uint32 generation;
+        uint32 flags;
+        float gain;
+        uint32 latency;     // of the filter chain, in frames
+    };
+
+    explicit packet_queue(std::size_t const n) :
+        size_{ceil_pow2(n)},
+        slots_{std::make_unique<slot[]>(size_)}
+    {}
+
+    packet_queue(packet_queue const&) = delete;
+    packet_queue& operator=(packet_queue const&) = delete;
+
+    std::size_t samples() const noexcept
+    { return samples_.load(std::memory_order_relaxed); }
+
+    std::size_t capacity() const noexcept
+    { return size_; }
+
+    // Preallocates room for `n` samples in every slot, so that filling the
+    // queue does not allocate unless a packet grows beyond that. Must be
+    // called before the queue is used.
+    void reserve(std::size_t const n)
+    {
+        for (auto i = 0_sz; i != size_; ++i) {
+            slots_[i].pkt.reserve(n);
+        }
+    }
+
+    // Like reserve(), but also locks the slots and their buffers into
+    // physical memory. Packets that later grow beyond `n` samples are
+    // reallocated and no longer locked.
+    bool lock_memory(std::size_t const n)
+    {
+        reserve(n);
+        auto ok = realtime::lock_memory(slots_.get(), size_ * sizeof(slot));
+        for (auto i = 0_sz; i != size_; ++i) {
+            auto&& pkt = slots_[i].pkt;
+            ok &= realtime::lock_memory(pkt.data(),
+                                        pkt.capacity() * sizeof(float));
+        }
+        return ok;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Producer functions
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Returns a free slot, or nullptr if either every slot is in use or at
+    // least `max_samples` samples are already enqueued.
+    slot* write_prepare(std::size_t const max_samples) const noexcept
+    {
+        auto const tail = tail_.load(std::memory_order_acquire);
+        if (AMP_UNLIKELY(head_ - tail == size_)) {
+            return nullptr;
+        }
+        if (head_ != tail && samples() >= max_samples) {
+            return nullptr;
+        }
+        return &slots_[head_ & (size_ - 1)];
+    }
+
+    void write_commit() noexcept
+    {
+        auto&& x = slots_[head_ & (size_ - 1)];
+        samples_.fetch_add(x.pkt.size(), std::memory_order_relaxed);
+        head_commit_.store(++head_, std::memory_order_release);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Consumer functions
+    ////////////////////////////////////////////////////////////////////////////
+
+    slot* read_acquire() const noexcept
+    {
+        auto const tail = tail_.load(std::memory_order_relaxed);
+        if (head_commit_.load(std::memory_order_acquire) == tail) {
+            return nullptr;
+        }
+        return &slots_[tail & (size_ - 1)];
+    }
+
+    void read_release() noexcept
+    {
+        auto const tail = tail_.load(std::memory_order_relaxed);
+        auto&& x = slots_[tail & (size_ - 1)];
+        samples_.fetch_sub(x.pkt.size(), std::memory_order_relaxed);
+        tail_.store(tail + 1, std::memory_order_release);
+    }
+
+private:
+    alignas(cache_line_size) std::atomic<std::size_t> head_commit_{0};
+    alignas(cache_line_size) std::atomic<std::size_t> tail_{0};
+    alignas(cache_line_size) std::atomic<std::size_t> samples_{0};
+    alignas(cache_line_size) std::size_t head_{0};
+    std::size_t const size_;
+    std::unique_ptr<slot[]> const slots_;
+};
+
+}}    // namespace amp::audio
+
+
+#endif  // AMP_INCLUDED_EEE3B886_440D_4DEF_9172_FE11F3EB69EF
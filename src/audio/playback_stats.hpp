@@ -0,0 +1,312 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// audio/playback_stats.hpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef AMP_INCLUDED_32EA4D55_9290_490D_AB02_0C6AB7E8CFC9
+#define AMP_INCLUDED_32EA4D55_9290_490D_AB02_0C6AB7E8CFC9
+
+
+#include <amp/range.hpp>
+#include <amp/stddef.hpp>
+
+#include "core/cpu.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+
+
+namespace amp {
+namespace audio {
+
+constexpr std::size_t ring_fill_buckets = 8;
+
+struct playback_stats
+{
+    // Output callbacks that could not be fully served from the ring buffer
+    // after it had been filled, and the number of samples replaced by silence.
+    uint64 underruns;
+    uint64 lost_samples;
+    uint64 callbacks;
+
+    // Fill level of the ring buffer (in samples) as seen by each output
+    // callback. Bucket `i` of the histogram counts the callbacks that found
+    // the ring between `i/N` and `(i+1)/N` full.
+    uint64 ring_capacity;
+    uint64 ring_fill_min;
+    uint64 ring_fill_avg;
+    uint64 ring_fill_max;
+    uint64 ring_fill_histogram[ring_fill_buckets];
+
+    // Deviation of the interval between two output callbacks from the
+    // duration of audio requested by the first of them.
+    std::chrono::nanoseconds callback_jitter_avg;
+    std::chrono::nanoseconds callback_jitter_max;
+
+    // Time from a seek being handled by the player thread until the output
+    // first played audio from the new position.
+    uint64 seeks;
+    std::chrono::nanoseconds seek_latency_avg;
+    std::chrono::nanoseconds seek_latency_max;
+
+    // Number of times the player thread was woken up, in total and on
+    // average per second since playback started.
+    uint64 wakeups;
+    double wakeups_per_second;
+
+    // Time the decoder thread spent decoding and filtering one packet.
+    uint64 packets;
+    std::chrono::nanoseconds receive_packet_avg;
+    std::chrono::nanoseconds receive_packet_max;
+};
+
+
+// -- Overview --
+//
+// Collects playback_stats without locks. The output callback and the decoder
+// thread each own (and are the only writers of) their own set of counters, so
+// updates are plain relaxed loads and stores. Any thread may take a snapshot
+// at any time; the counters are individually, but not mutually, consistent.
+
+class playback_monitor
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    playback_monitor() = default;
+
+    playback_monitor(playback_monitor const&) = delete;
+    playback_monitor& operator=(playback_monitor const&) = delete;
+
+    // Must not be called concurrently with the record functions.
+    void reset(std::size_t const capacity) noexcept
+    {
+        set_capacity(capacity);
+        underruns_.store(0, std::memory_order_relaxed);
+        lost_samples_.store(0, std::memory_order_relaxed);
+        callbacks_.store(0, std::memory_order_relaxed);
+        fill_min_.store(~uint64{0}, std::memory_order_relaxed);
+        fill_max_.store(0, std::memory_order_relaxed);
+        fill_sum_.store(0, std::memory_order_relaxed);
+        for (auto&& x : histogram_) {
+            x.store(0, std::memory_order_relaxed);
+        }
+        jitter_sum_.store(0, std::memory_order_relaxed);
+        jitter_max_.store(0, std::memory_order_relaxed);
+        intervals_.store(0, std::memory_order_relaxed);
+        seeks_.store(0, std::memory_order_relaxed);
+        seek_sum_.store(0, std::memory_order_relaxed);
+        seek_max_.store(0, std::memory_order_relaxed);
+        packets_.store(0, std::memory_order_relaxed);
+        receive_sum_.store(0, std::memory_order_relaxed);
+        receive_max_.store(0, std::memory_order_relaxed);
+        wakeups_.store(0, std::memory_order_relaxed);
+        epoch_.store(nanoseconds_since_epoch(), std::memory_order_relaxed);
+        restart();
+    }
+
+    void set_capacity(std::size_t const capacity) noexcept
+    {
+        capacity_.store(capacity, std::memory_order_relaxed);
+    }
+
+    // Forgets the timing of the last callback and treats the ring as not yet
+    // filled, e.g. after the output stream was stopped or flushed. Must not be
+    // called concurrently with record_callback().
+    void restart() noexcept
+    {
+        last_callback_ = 0;
+        expected_ = 0;
+        filled_ = false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Output callback functions
+    ////////////////////////////////////////////////////////////////////////////
+
+    void record_callback(std::size_t const fill,
+                         std::size_t const requested,
+                         std::chrono::nanoseconds const duration) noexcept
+    {
+        auto const now = nanoseconds_since_epoch();
+        if (AMP_LIKELY(last_callback_ != 0)) {
+            auto const interval = now - last_callback_;
+            auto const jitter = static_cast<uint64>(
+                (interval > expected_) ? interval - expected_
+                                       : expected_ - interval);
+            add(jitter_sum_, jitter);
+            store_max(jitter_max_, jitter);
+            add(intervals_, 1);
+        }
+        last_callback_ = now;
+        expected_ = static_cast<int64>(duration.count());
+
+        auto const capacity = capacity_.load(std::memory_order_relaxed);
+        auto const bucket = bucket_of(fill, capacity);
+        add(histogram_[bucket], 1);
+        add(callbacks_, 1);
+        add(fill_sum_, fill);
+        store_min(fill_min_, fill);
+        store_max(fill_max_, fill);
+
+        if (AMP_UNLIKELY(fill < requested)) {
+            if (filled_) {
+                add(underruns_, 1);
+                add(lost_samples_, requested - fill);
+            }
+            filled_ = (fill != 0);
+        }
+        else {
+            filled_ = true;
+        }
+    }
+
+    void record_seek(std::chrono::nanoseconds const x) noexcept
+    {
+        auto const ns = static_cast<uint64>(x.count());
+        add(seeks_, 1);
+        add(seek_sum_, ns);
+        store_max(seek_max_, ns);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Decoder thread functions
+    ////////////////////////////////////////////////////////////////////////////
+
+    void record_receive_packet(std::chrono::nanoseconds const x) noexcept
+    {
+        auto const ns = static_cast<uint64>(x.count());
+        add(packets_, 1);
+        add(receive_sum_, ns);
+        store_max(receive_max_, ns);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Player thread functions
+    ////////////////////////////////////////////////////////////////////////////
+
+    void record_wakeup() noexcept
+    { add(wakeups_, 1); }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Observer functions
+    ////////////////////////////////////////////////////////////////////////////
+
+    playback_stats snapshot() const noexcept
+    {
+        playback_stats x;
+        x.underruns     = underruns_.load(std::memory_order_relaxed);
+        x.lost_samples  = lost_samples_.load(std::memory_order_relaxed);
+        x.callbacks     = callbacks_.load(std::memory_order_relaxed);
+        x.ring_capacity = capacity_.load(std::memory_order_relaxed);
+        x.ring_fill_max = fill_max_.load(std::memory_order_relaxed);
+        x.ring_fill_min = std::min(fill_min_.load(std::memory_order_relaxed),
+                                   x.ring_fill_max);
+        x.ring_fill_avg = average(fill_sum_, x.callbacks);
+
+        for (auto const i : xrange(ring_fill_buckets)) {
+            x.ring_fill_histogram[i] =
+                histogram_[i].load(std::memory_order_relaxed);
+        }
+
+        auto const intervals = intervals_.load(std::memory_order_relaxed);
+        x.callback_jitter_avg = nanoseconds(average(jitter_sum_, intervals));
+        x.callback_jitter_max = nanoseconds(jitter_max_);
+
+        x.seeks = seeks_.load(std::memory_order_relaxed);
+        x.seek_latency_avg = nanoseconds(average(seek_sum_, x.seeks));
+        x.seek_latency_max = nanoseconds(seek_max_);
+
+        x.packets = packets_.load(std::memory_order_relaxed);
+        x.receive_packet_avg = nanoseconds(average(receive_sum_, x.packets));
+        x.receive_packet_max = nanoseconds(receive_max_);
+
+        auto const elapsed = nanoseconds_since_epoch()
+                           - epoch_.load(std::memory_order_relaxed);
+        x.wakeups = wakeups_.load(std::memory_order_relaxed);
+        x.wakeups_per_second = (elapsed > 0)
+            ? static_cast<double>(x.wakeups) * 1e9 / elapsed
+            : 0.;
+        return x;
+    }
+
+private:
+    using counter = std::atomic<uint64>;
+
+    static int64 nanoseconds_since_epoch() noexcept
+    {
+        auto const t = clock::now().time_since_epoch();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(t).count();
+    }
+
+    static std::chrono::nanoseconds nanoseconds(uint64 const x) noexcept
+    { return std::chrono::nanoseconds{static_cast<int64>(x)}; }
+
+    static std::chrono::nanoseconds nanoseconds(counter const& x) noexcept
+    { return nanoseconds(x.load(std::memory_order_relaxed)); }
+
+    static uint64 average(counter const& sum, uint64 const n) noexcept
+    { return (n != 0) ? sum.load(std::memory_order_relaxed) / n : 0; }
+
+    static std::size_t bucket_of(std::size_t const fill,
+                                     std::size_t const capacity) noexcept
+    {
+        if (AMP_UNLIKELY(capacity == 0)) {
+            return 0;
+        }
+        auto const i = (uint64{fill} * ring_fill_buckets) / capacity;
+        return std::min<std::size_t>(i, ring_fill_buckets - 1);
+    }
+
+    // Single-writer updates; no read-modify-write instructions required.
+    static void add(counter& x, uint64 const n) noexcept
+    { x.store(x.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+
+    static void store_min(counter& x, uint64 const n) noexcept
+    {
+        if (n < x.load(std::memory_order_relaxed)) {
+            x.store(n, std::memory_order_relaxed);
+        }
+    }
+
+    static void store_max(counter& x, uint64 const n) noexcept
+    {
+        if (n > x.load(std::memory_order_relaxed)) {
+            x.store(n, std::memory_order_relaxed);
+        }
+    }
+
+    alignas(cache_line_size) counter capacity_{0};
+    counter underruns_{0};
+    counter lost_samples_{0};
+    counter callbacks_{0};
+    counter fill_min_{0};
+    counter fill_max_{0};
+    counter fill_sum_{0};
+    counter histogram_[ring_fill_buckets]{};
+    counter jitter_sum_{0};
+    counter jitter_max_{0};
+    counter intervals_{0};
+    counter seeks_{0};
+    counter seek_sum_{0};
+    counter seek_max_{0};
+    int64 last_callback_{0};
+    int64 expected_{0};
+    bool filled_{false};
+
+    alignas(cache_line_size) counter packets_{0};
+    counter receive_sum_{0};
+    counter receive_max_{0};
+
+    alignas(cache_line_size) counter wakeups_{0};
+    std::atomic<int64> epoch_{0};
+};
+
+}}    // namespace amp::audio
+
+
+#endif  // AMP_INCLUDED_32EA4D55_9290_490D_AB02_0C6AB7E8CFC9
@@ -8,21 +8,31 @@
 #include <amp/audio/format.hpp>
 #include <amp/audio/input.hpp>
 #include <amp/audio/packet.hpp>
+#include <amp/bitops.hpp>
 #include <amp/error.hpp>
 #include <amp/numeric.hpp>
+#include <amp/optional.hpp>
+#include <amp/scope_guard.hpp>
 #include <amp/stddef.hpp>
 #include <amp/u8string.hpp>
 
 #include "audio/filter_chain.hpp"
-#include "audio/input_slice.hpp"
+#include "audio/output_stage.hpp"
+#include "audio/packet_queue.hpp"
 #include "audio/player.hpp"
 #include "audio/replaygain.hpp"
 #include "audio/sink_context.hpp"
+#include "audio/source_context.hpp"
+#include "audio/source_loader.hpp"
+#include "audio/transition.hpp"
+#include "core/allocation_guard.hpp"
 #include "core/registry.hpp"
 #include "media/track.hpp"
 
 #include <algorithm>
 #include <chrono>
+#include <exception>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <utility>
@@ -63,14 +73,54 @@ void player::set_output(u8string const& s_id, u8string const& d_id)
 
 void player::set_preset(std::vector<u8string> x, audio::replaygain_config y)
 {
-    {
-        std::lock_guard<std::mutex> const lk{mtx_};
-        preset_    = std::move(x);
-        rg_config_ = std::move(y);
+    std::lock_guard<std::mutex> const lk{mtx_};
+    preset_    = std::move(x);
+    rg_config_ = std::move(y);
+
+    if (!is_stopped()) {
+        // Instantiate and calibrate the new chain here, so that the decoder
+        // thread only has to swap it in. If the source changes before that
+        // happens, the decoder recalibrates the chain itself.
+        auto chain = std::make_unique<audio::filter_chain>();
+        chain->rebuild(preset_, rg_config_);
+
+        auto const src = source_format_.load();
+        auto const dst = output_format_.load();
+        if (src.sample_rate != 0 && dst.sample_rate != 0) {
+            chain->calibrate(src, dst);
+        }
+        chains_.publish(std::move(chain));
+        decoder_wake_.post();
     }
+}
+
+buffer_policy buffer_policy::from(latency_profile const x) noexcept
+{
+    using std::chrono::milliseconds;
+
+    switch (x) {
+    case latency_profile::low_latency:
+        return {milliseconds{20}, milliseconds{10}};
+    case latency_profile::balanced:
+        return {milliseconds{500}, milliseconds{250}};
+    case latency_profile::power_saving:
+        return {milliseconds{4000}, milliseconds{1000}};
+    }
+    AMP_UNREACHABLE();
+}
+
+buffer_policy buffer_policy::from(std::chrono::milliseconds x) noexcept
+{
+    // Below roughly one device period, every callback would underrun.
+    x = std::max(x, std::chrono::milliseconds{10});
+    return {x, x / 2};
+}
 
+void player::set_latency(buffer_policy const& x)
+{
+    latency_.store(x);
     if (!is_stopped()) {
-        events_.emplace(event::state);
+        events_.emplace(event::latency);
         ready_.post();
     }
 }
@@ -102,7 +152,12 @@ void player::stop()
 
     events_.clear();
     tracks_.clear();
-    position_.store(0, std::memory_order_relaxed);
+    chains_.clear();
+    source_format_.store({});
+    output_format_.store({});
+    clock_.store({});
+    played_.store(0, std::memory_order_relaxed);
+    timestamp_.store({});
     bit_rate_.store(0, std::memory_order_relaxed);
     state_ = player_state::stopped;
     clock_rate_ = -1ULL;
@@ -119,84 +174,474 @@ void player::pause()
 
 namespace {
 
-struct source_context
-{
-    AMP_INLINE explicit operator bool() const noexcept
-    { return static_cast<bool>(input); }
+// Packet buffers in the decoder's pool are preallocated (and locked, in
+// real-time mode) for this many frames.
+constexpr uint32 max_packet_frames = 4096;
+
+// The decoder's pool has enough slots to fill the decode-ahead with packets
+// this small, which is about as small as common codecs' frames get, plus a
+// few for the packets being decoded and played. Smaller packets only cut
+// the decode-ahead short.
+constexpr uint32 min_packet_frames = 1024;
+constexpr std::size_t spare_packets = 4;
 
-    AMP_INLINE audio::input* operator->() const noexcept
-    { return input.get(); }
+// Nodes preallocated for events sent from the player thread to the decoder.
+// Seeks are coalesced by the decoder, so only a burst larger than this while
+// it is busy would allocate.
+constexpr std::size_t max_pending_events = 16;
 
-    AMP_INLINE void reset() noexcept
-    { input.reset(); }
+}     // namespace <unnamed>
 
-    AMP_INLINE void reset(media::track const& x)
+
+class player::decoder_context
+{
+public:
+    decoder_context(audio::format const& fmt, uint32 const decode_ahead_ms) :
+        format(fmt),
+        queue(spare_packets + static_cast<std::size_t>(
+            align_up(muldiv(uint64{fmt.sample_rate}, decode_ahead_ms, 1000),
+                     min_packet_frames) / min_packet_frames))
     {
-        input = audio::input::resolve(x.location, audio::playback);
-        if (x.chapter) {
-            input = audio::input_slice::make(std::move(input), x);
-        }
-        frames = x.frames;
-        format = input->get_format();
-        rg_info.reset(x.info);
+        // The player thread is the producer of `events`, and only ever reads
+        // packets from `queue`, so this is all it needs to never allocate.
+        queue.reserve(fmt.channels * max_packet_frames);
+        events.reserve(max_pending_events);
     }
 
-    uint64 frames;
-    audio::format format;
-    audio::replaygain_info rg_info;
-    ref_ptr<audio::input> input;
+    audio::format const format;
+    audio::packet_queue queue;
+    spsc::queue<event> events;
+    std::atomic<uint64> committed{};
+    std::atomic<bool> failed{false};
+    std::atomic<bool> starved{false};
+    std::exception_ptr error;
 };
 
-}     // namespace <unnamed>
+
+void player::run_decoder_(decoder_context& dec)
+{
+    uint32 generation{};
+    uint32 flags{};
+    uint64 position{};
+    uint64 boundaries{};
+    bool exhausted{};
+    bool trim_leading{};
+    audio::source_context source, previous;
+    audio::source_loader loader;
+    std::unique_ptr<audio::filter_chain> chain;
+    std::unique_ptr<audio::filter_chain> spare_chain;
+    audio::transition fade;
+    audio::packet fade_pkt;
+    audio::trailing_silence trailing, fade_trailing;
+    audio::transition_policy policy;
+    media::track_handle track;
+    optional<media::track_handle> deferred;
+
+    {
+        std::lock_guard<std::mutex> const lk{mtx_};
+        chain = std::make_unique<audio::filter_chain>();
+        chain->rebuild(preset_, rg_config_);
+    }
+
+    auto const rate = uint64{dec.format.sample_rate} * dec.format.channels;
+    auto const silence_frames = std::size_t{dec.format.sample_rate}
+                              * static_cast<std::size_t>(
+                                    audio::silence_window.count());
+
+    auto calibrate = [&]{
+        chain->calibrate(source.format, dec.format, source.rg_info);
+        source_format_.store(source.format);
+    };
+
+    auto swap_chain = [&](std::unique_ptr<audio::filter_chain> next) {
+        if (source) {
+            if (AMP_UNLIKELY(!next->is_calibrated_for(source.format,
+                                                      dec.format))) {
+                next->calibrate(source.format, dec.format);
+            }
+            next->calibrate(source.rg_info);
+            next->adopt(*chain);
+        }
+        chains_.retire(std::exchange(chain, std::move(next)));
+    };
+
+    auto is_committed = [&]{
+        return dec.committed.load(std::memory_order_acquire) == boundaries;
+    };
+
+    auto open_next_source = [&]{
+        // Only one track change may be in flight at a time, since a seek
+        // must be able to roll back to the track that is still audible.
+        if (!is_committed()) {
+            return false;
+        }
+
+        auto next = deferred ? std::exchange(deferred, nullopt)
+                             : tracks_.pop();
+        if (!next) {
+            return false;
+        }
+
+        previous = std::move(source);
+        if (!loader.take(*next, source)) {
+            source.reset(**next);
+        }
+        track = std::move(*next);
+        calibrate();
+
+        flags |= packet_queue::track_start;
+        exhausted = false;
+        trim_leading = policy.trim_silence;
+        return true;
+    };
+
+    auto start_transition = [&]{
+        // `previous` keeps playing through its own filter chain, while the
+        // next track gets another. The chain that the last transition faded
+        // out is rebuilt for it, so that crossfades do not pile up chains.
+        auto outgoing = std::move(chain);
+        chain = spare_chain ? std::move(spare_chain)
+                            : std::make_unique<audio::filter_chain>();
+        {
+            std::lock_guard<std::mutex> const lk{mtx_};
+            chain->rebuild(preset_, rg_config_);
+        }
+        if (!open_next_source()) {
+            spare_chain = std::exchange(chain, std::move(outgoing));
+            return;
+        }
+
+        // Silence held back at the end of the outgoing track is still
+        // pending, and now belongs to the fade.
+        fade_trailing.swap(trailing);
+
+        auto const length = std::min(previous.remaining(),
+                                     std::chrono::nanoseconds{policy.duration});
+        auto const frames = muldiv(static_cast<uint64>(length.count()),
+                                   dec.format.sample_rate, std::nano::den);
+        auto const gain = (chain->gain() > 0.f)
+                        ? outgoing->gain() / chain->gain()
+                        : 0.f;
+        fade.start(policy, frames, gain, std::move(outgoing));
+    };
+
+    auto should_start_transition = [&]{
+        if (policy.duration.count() <= 0 || fade.active() || exhausted) {
+            return false;
+        }
+        if (source.remaining() > policy.duration || !is_committed()) {
+            return false;
+        }
+        return deferred || tracks_.front();
+    };
+
+    auto end_transition = [&]{
+        spare_chain = fade.finish();
+        fade_trailing.clear();
+    };
+
+    auto mix_transition = [&](audio::packet& pkt) {
+        while (fade.starved(pkt.frames())) {
+            fade_pkt.clear();
+            previous.read(fade_pkt);
+
+            if (AMP_UNLIKELY(fade_pkt.empty())) {
+                fade_trailing.clear();
+                fade.chain().drain(fade_pkt);
+                fade.push(fade_pkt);
+                fade_pkt.clear();
+            }
+            else {
+                fade.chain().process(fade_pkt);
+                if (policy.trim_silence || fade_trailing.holding()) {
+                    fade_trailing.process(fade_pkt, silence_frames);
+                    if (fade_pkt.empty()) {
+                        continue;
+                    }
+                }
+            }
+            fade.push(fade_pkt);
+        }
+        fade.mix(pkt);
+    };
+
+    auto prepare_next_source = [&]{
+        if (AMP_UNLIKELY(loader.idle())) {
+            if (deferred) {
+                loader.request(*deferred);
+            }
+            else if (auto const next = tracks_.front()) {
+                loader.request(*next);
+            }
+        }
+    };
+
+    auto seek = [&](uint64 pos) {
+        if (fade.active()) {
+            spare_chain = fade.finish();
+            if (!is_committed()) {
+                std::swap(chain, spare_chain);
+            }
+            fade_trailing.clear();
+        }
+        trailing.clear();
+        trim_leading = false;
+
+        // The last track change never became audible, so the seek applies
+        // to the previous track.
+        if (!is_committed()) {
+            --boundaries;
+            if (previous) {
+                deferred = std::move(track);
+                source = std::move(previous);
+                calibrate();
+            }
+            else {
+                flags |= packet_queue::track_start;
+            }
+        }
+
+        pos = muldiv(pos, source.format.sample_rate, std::nano::den);
+        pos = std::min(pos, source.frames - 1);
+        position = muldiv(pos, rate, source.format.sample_rate);
+
+        source.seek(pos);
+        chain->flush();
+        flags |= packet_queue::discontinuity;
+        exhausted = false;
+    };
+
+    auto process_events = [&]{
+        uint32 ret{};
+        uint64 pos{};
+
+        // Every seek bumps the generation, even if several are coalesced,
+        // so that it stays in lockstep with the player thread's copy.
+        dec.events.for_each([&](event const& e) noexcept {
+            if (e.type == event::seek) {
+                pos = e.data;
+                ++generation;
+            }
+            ret |= e.type;
+        });
+
+        if (ret & event::stop) {
+            return false;
+        }
+        if ((ret & event::seek) && source) {
+            seek(pos);
+        }
+        return true;
+    };
+
+    auto receive_packet = [&](packet_queue::slot& out) {
+        auto const start = playback_monitor::clock::now();
+        AMP_SCOPE_EXIT {
+            monitor_.record_receive_packet(
+                playback_monitor::clock::now() - start);
+        };
+
+        auto&& pkt = out.pkt;
+        pkt.clear();
+        source.read(pkt);
+
+        if (AMP_UNLIKELY(pkt.empty())) {
+            // Whatever was held back was silent to the end.
+            trailing.clear();
+            chain->drain(pkt);
+            exhausted = true;
+        }
+        else {
+            prepare_next_source();
+            bit_rate_.store(pkt.bit_rate(), std::memory_order_relaxed);
+            chain->process(pkt);
+
+            if (AMP_UNLIKELY(trim_leading)) {
+                pkt.pop_front(audio::leading_silence(pkt) * pkt.channels());
+                trim_leading = pkt.empty();
+            }
+            else if ((policy.trim_silence && !fade.active() &&
+                      source.remaining() <= audio::silence_window) ||
+                     trailing.holding()) {
+                trailing.process(pkt, silence_frames);
+            }
+        }
+
+        if (fade.active()) {
+            if (!pkt.empty()) {
+                mix_transition(pkt);
+            }
+            if (fade.done() || exhausted) {
+                end_transition();
+            }
+        }
+
+        if (!pkt.empty()) {
+            if (flags & packet_queue::track_start) {
+                ++boundaries;
+            }
+            out.position = position;
+            out.generation = generation;
+            out.flags = std::exchange(flags, 0);
+            out.gain = chain->gain();
+            out.latency = static_cast<uint32>(chain->latency());
+            dec.queue.write_commit();
+
+            // The player thread only needs to hear about new packets if it
+            // has run out of them; otherwise it sleeps until the output
+            // drains the ring buffer.
+            if (dec.starved.exchange(false)) {
+                ready_.post();
+            }
+        }
+    };
+
+    for (;;) {
+        if (!dec.events.empty() && !process_events()) {
+            return;
+        }
+        if (auto next = chains_.take()) {
+            swap_chain(std::move(next));
+        }
+        if (previous && is_committed() && !fade.active()) {
+            previous.reset();
+        }
+
+        policy = transition_.load();
+        if (!source || exhausted) {
+            if (!open_next_source()) {
+                decoder_wake_.wait();
+                continue;
+            }
+        }
+        else if (AMP_UNLIKELY(should_start_transition())) {
+            start_transition();
+        }
+
+        auto const ms = decode_ahead_.load(std::memory_order_relaxed);
+        auto const slot = dec.queue.write_prepare(muldiv(rate, ms, 1000));
+        if (slot == nullptr) {
+            decoder_wake_.wait();
+            continue;
+        }
+        receive_packet(*slot);
+    }
+}
 
 
 void player::run_thread_()
 {
-    uint64 sample;
-    audio::packet pkt;
-    audio::source_context source, pending_source;
-    audio::filter_chain chain;
-    audio::sink_context sink(ready_, [&]{
-        std::lock_guard<std::mutex> const lk{mtx_};
-        chain.rebuild(preset_, rg_config_);
-        return stream_;
-    }());
+    uint64 sample{};
+    uint32 generation{};
+    std::size_t offset{};
+    bool pending{};
+    bool started{};
+    bool paused{};
+    bool switching{};
+    uint64 chain_latency{};
+    playback_monitor::clock::time_point seek_requested;
+    packet_queue::slot* slot{};
+
+    audio::sink_context sink(ready_, monitor_, played_, timestamp_, volume_,
+                             output_stage_, stream_, latency_.load());
+    decoder_context dec{sink.format,
+                        decode_ahead_.load(std::memory_order_relaxed)};
 
     clock_rate_ = uint64{sink.format.sample_rate} * sink.format.channels;
+    output_format_.store(sink.format);
 
-    auto calibrate = [&]{
-        chain.calibrate(source.format, sink.format, source.rg_info);
+    audio::realtime_policy rt;
+    {
+        std::lock_guard<std::mutex> const lk{mtx_};
+        rt = realtime_;
+    }
+
+    auto memory_lock = realtime::result::not_requested;
+    if (rt.enabled && rt.lock_memory) {
+        auto const n = sink.lock_memory() + dec.queue.lock_memory(
+            sink.format.channels * max_packet_frames);
+        memory_lock = (n == 2) ? realtime::result::succeeded
+                    : (n == 1) ? realtime::result::degraded
+                    :            realtime::result::failed;
+    }
+    rt_memory_lock_.store(memory_lock, std::memory_order_relaxed);
+
+    std::thread decoder{[&]() noexcept {
+        try {
+            run_decoder_(dec);
+        }
+        catch (...) {
+            dec.error = std::current_exception();
+            dec.failed.store(true, std::memory_order_release);
+            ready_.post();
+        }
+    }};
+
+    AMP_SCOPE_EXIT {
+        dec.events.emplace(event::stop);
+        decoder_wake_.post();
+        decoder.join();
     };
 
+    // Only now, so that the decoder thread does not inherit the policy.
+    auto scheduling = realtime::result::not_requested;
+    auto affinity   = realtime::result::not_requested;
+    if (rt.enabled) {
+        // The player thread runs about once per refill of the ring.
+        auto const policy = latency_.load();
+        auto const period = std::chrono::nanoseconds{
+            policy.buffer - policy.low_watermark};
+
+        scheduling = realtime::promote_current_thread(
+            rt.priority, static_cast<uint64>(period.count()));
+        affinity = realtime::pin_current_thread(rt.cpu_mask);
+    }
+    rt_scheduling_.store(scheduling, std::memory_order_relaxed);
+    rt_affinity_.store(affinity, std::memory_order_relaxed);
+
     auto commit_track_change = [&]{
-        pending_source.reset();
-        tracks_.pop();
+        pending = false;
+        dec.committed.fetch_add(1, std::memory_order_release);
+        decoder_wake_.post();
+
+        allocation_guard::suspend const unguarded;
         delegate_.track_complete();
     };
 
-    auto cancel_track_change = [&]{
-        if (pending_source) {
-            source = std::move(pending_source);
-            calibrate();
-        }
+    auto publish_position = [&](uint64 const pos) {
+        // `played_` must be read after the ring buffer's fill level, so
+        // that a concurrent output callback is not counted twice.
+        clock_.store({pos, played_.load(std::memory_order_acquire),
+                      chain_latency + sink.device_latency()});
     };
 
     auto sync_clock = [&](uint64 const delta) {
         sample += delta;
+        if (AMP_UNLIKELY(switching)) {
+            // The ring buffer still holds audio from before the seek.
+            return;
+        }
 
         auto const delay = sink.delay();
-        uint64 pos;
-        if (AMP_LIKELY(!pending_source)) {
-            pos = sample - delay;
+        if (AMP_LIKELY(!pending)) {
+            publish_position(sample - delay);
         }
         else if (sample >= delay) {
             commit_track_change();
-            pos = sample - delay;
+            sink.wake_below(0);
+            publish_position(sample - delay);
         }
         else {
-            pos = position_.load(std::memory_order_relaxed) + delta;
+            // The previous track is still audible; keep extrapolating its
+            // position, and wake up as soon as the new one starts playing.
+            sink.wake_below(sample + 1);
         }
-        position_.store(pos, std::memory_order_relaxed);
+    };
+
+    auto release_packet = [&]{
+        slot = nullptr;
+        dec.queue.read_release();
+        decoder_wake_.post();
     };
 
     auto process_events = [&]{
@@ -208,8 +653,8 @@ void player::run_thread_()
             case event::seek:
                 pos = e.data;
                 [[fallthrough]];
-            case event::state:
             case event::stop:
+            case event::latency:
                 ret |= e.type;
                 break;
             case event::pause:
@@ -221,99 +666,123 @@ void player::run_thread_()
         if (ret & event::stop) {
             return ret;
         }
-        if (ret & event::state) {
-            {
-                std::lock_guard<std::mutex> const lk{mtx_};
-                chain.rebuild(preset_, rg_config_);
-            }
-            calibrate();
+        if (ret & event::latency) {
+            sink.set_policy(latency_.load());
         }
         if (ret & event::seek) {
-            cancel_track_change();
-
-            pos = muldiv(pos, source.format.sample_rate, std::nano::den);
-            pos = std::min(pos, source.frames - 1);
-
-            sample = muldiv(pos, clock_rate_, source.format.sample_rate);
-            position_.store(sample, std::memory_order_relaxed);
+            ++generation;
+            pending = false;
+            dec.events.emplace(event::seek, pos);
+            decoder_wake_.post();
+
+            sample = muldiv(pos, clock_rate_, std::nano::den);
+            seek_requested = playback_monitor::clock::now();
+            sink.wake_below(0);
+
+            // While paused, the output stream is stopped anyway.
+            switching = !paused && seek_policy_.load().keep_running;
+            if (!switching) {
+                sink.flush(seek_requested);
+            }
+            publish_position(sample);
 
-            source->seek(pos);
-            chain.flush();
-            sink.flush();
-            pkt.clear();
+            if (slot != nullptr) {
+                release_packet();
+            }
         }
         return ret;
     };
 
     auto poll = [&]() {
         ready_.wait();
+        monitor_.record_wakeup();
+        if (AMP_UNLIKELY(dec.failed.load(std::memory_order_acquire))) {
+            allocation_guard::suspend const unguarded;
+            std::rethrow_exception(dec.error);
+        }
         return !events_.empty() ? process_events() : 0;
     };
 
-    auto prepare_track_change = [&]{
-        if (pending_source) {
-            commit_track_change();
-        }
-
-        auto next = tracks_.front();
-        for (; !next; next = tracks_.front()) {
-            if (auto const ret = process_events()) {
-                return ret;
+    auto receive_packet = [&]{
+        for (;;) {
+            slot = dec.queue.read_acquire();
+            if (slot == nullptr) {
+                return false;
             }
+            if (slot->generation == generation) {
+                break;
+            }
+            release_packet();
         }
 
-        pending_source = std::move(source);
-        source.reset(*next);
-        calibrate();
-        sample = 0;
-        return uint32{0};
-    };
-
-    auto receive_packet = [&]{
-        pkt.clear();
-        pkt.set_channel_layout(source.format.channel_layout);
-        source->read(pkt);
-
-        if (AMP_UNLIKELY(pkt.empty())) {
-            chain.drain(pkt);
-            return prepare_track_change();
+        chain_latency = uint64{slot->latency} * sink.format.channels;
+        if (AMP_UNLIKELY(switching)) {
+            // Audio from the new position is ready; drop the old one.
+            switching = false;
+            sink.discard(seek_requested, seek_policy_.load().fade);
         }
 
-        bit_rate_.store(pkt.bit_rate(), std::memory_order_relaxed);
-        chain.process(pkt);
-        return process_events();
+        if (slot->flags & packet_queue::discontinuity) {
+            sample = slot->position;
+            publish_position(sample);
+        }
+        if (slot->flags & packet_queue::track_start) {
+            sample = 0;
+            pending = true;
+            if (!std::exchange(started, true)) {
+                commit_track_change();
+            }
+        }
+        offset = 0;
+        return true;
     };
 
+    // Once the pools above are warm, nothing in here may touch the heap;
+    // builds with AMP_CHECK_ALLOCATIONS enforce that.
     auto process_packet = [&]{
-        while (pkt.empty()) {
-            if (auto const ret = receive_packet()) {
+        allocation_guard::scope const guard;
+
+        while (slot == nullptr) {
+            if (receive_packet()) {
+                break;
+            }
+
+            // Ask the decoder for a wake-up, then check again in case it
+            // committed a packet in the meantime.
+            dec.starved.store(true);
+            if (receive_packet()) {
+                dec.starved.store(false);
+                break;
+            }
+            if (auto const ret = poll()) {
                 return ret;
             }
+            sync_clock(0);
         }
 
-        auto const end = pkt.data() + pkt.size();
-        auto remain = pkt.size();
+        auto const& pkt = slot->pkt;
+        auto render = [&](float* const dst, std::size_t const n) noexcept {
+            audio::output_stage::scale(slot->gain, pkt.data() + offset,
+                                       dst, n);
+        };
 
         for (;;) {
-            auto const samples = sink.write(end - remain, remain);
+            auto const samples = sink.write(pkt.size() - offset, render);
             sync_clock(samples);
 
-            remain -= samples;
-            if (remain == 0) {
-                pkt.clear();
-                return uint32{0};
+            offset += samples;
+            if (offset == pkt.size()) {
+                release_packet();
+                return !events_.empty() ? process_events() : 0;
             }
             if (auto const ret = poll()) {
-                pkt.pop_front(pkt.size() - remain);
                 return ret;
             }
         }
     };
 
-    prepare_track_change();
-    commit_track_change();
-
 play:
+    paused = false;
     sink.start();
     for (;;) {
         auto const ret = process_packet();
@@ -322,6 +791,7 @@ play:
     }
 
 pause:
+    paused = true;
     sink.pause();
     for (;;) {
         auto const ret = poll();
@@ -331,4 +801,3 @@ pause:
 }
 
 }}    // namespace amp::audio
-
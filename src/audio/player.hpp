@@ -15,8 +15,14 @@
 #include <amp/stddef.hpp>
 #include <amp/u8string.hpp>
 
+#include "audio/filter_chain.hpp"
+#include "audio/output_stage.hpp"
+#include "audio/playback_stats.hpp"
 #include "audio/replaygain.hpp"
+#include "audio/transition.hpp"
 #include "core/event.hpp"
+#include "core/realtime.hpp"
+#include <amp/seqlock.hpp>
 #include "core/spsc_queue.hpp"
 #include "media/track.hpp"
 
@@ -24,6 +30,7 @@
 #include <chrono>
 #include <mutex>
 #include <thread>
+#include <utility>
 #include <vector>
 
 
@@ -36,6 +43,74 @@ enum class player_state : uint8 {
     stopped,
 };
 
+enum class latency_profile : uint8 {
+    low_latency,
+    balanced,
+    power_saving,
+};
+
+// Controls how much audio is buffered between the player and the output
+// device. The player keeps the ring buffer filled up to `buffer` and, once it
+// is full, sleeps until the output has drained it below `low_watermark`.
+struct buffer_policy
+{
+    static buffer_policy from(audio::latency_profile) noexcept;
+    static buffer_policy from(std::chrono::milliseconds) noexcept;
+
+    std::chrono::milliseconds buffer;
+    std::chrono::milliseconds low_watermark;
+};
+
+
+// A playback position, and the host time at which it was audible.
+struct playback_timestamp
+{
+    std::chrono::nanoseconds position;
+    std::chrono::steady_clock::time_point time;
+};
+
+// Published by the output callback each time it runs: the number of samples
+// it had consumed until then, and when it started, in steady_clock ticks.
+struct output_timestamp
+{
+    uint64 played;
+    int64  time;
+};
+
+
+// Controls how a seek takes effect while playing.
+struct seek_policy
+{
+    // Keeps the output stream running: the ring buffer goes on playing until
+    // audio from the new position has been decoded, and is only then replaced
+    // by it. Otherwise, the output stream is stopped and restarted right away.
+    bool keep_running{true};
+
+    // Fades the old audio out and the new audio in over this length of time
+    // when switching over. Only used if `keep_running` is set.
+    std::chrono::milliseconds fade{0};
+};
+
+
+// Opt-in real-time mode for the player thread, which feeds the output
+// device. The decoder thread is left alone, since it may legitimately spend a
+// long time in a decoder or resampler.
+struct realtime_policy
+{
+    bool   enabled{false};
+    int32  priority{10};
+    uint64 cpu_mask{0};         // bit `i` selects CPU `i`; 0 disables pinning
+    bool   lock_memory{true};   // the sink ring buffer and the packet pool
+};
+
+struct realtime_status
+{
+    realtime::result scheduling;
+    realtime::result affinity;
+    realtime::result memory_lock;
+};
+
+
 class player_delegate
 {
 public:
@@ -62,22 +137,122 @@ public:
     void set_output(u8string const&, u8string const&);
     void set_preset(std::vector<u8string>, audio::replaygain_config);
 
-    void set_volume(float const level)
-    { stream_->set_volume(level); }
+    // The volume is applied in software by the output stage, ramping over
+    // its `volume_ramp` so that changes do not cause zipper noise.
+    void set_volume(float const level) noexcept
+    { volume_.store(level, std::memory_order_relaxed); }
+
+    float volume() const noexcept
+    { return volume_.load(std::memory_order_relaxed); }
+
+    // Read by the output callback, so takes effect right away.
+    void set_output_stage(audio::output_stage_policy const& x) noexcept
+    { output_stage_.store(x); }
+
+    audio::output_stage_policy output_stage() const noexcept
+    { return output_stage_.load(); }
+
+    void insert_track(media::track_handle x)
+    {
+        tracks_.push(std::move(x));
+        decoder_wake_.post();
+    }
+
+    // Sets how far ahead of the output the decoder and filter chain may run.
+    // Larger values absorb longer CPU bursts from expensive decoders and
+    // resamplers at the cost of memory and responsiveness to preset changes.
+    // The decoder's packet pool is sized for it when playback starts, so an
+    // increase only takes full effect from the next start.
+    void set_decode_ahead(std::chrono::milliseconds const x) noexcept
+    {
+        decode_ahead_.store(static_cast<uint32>(x.count()),
+                            std::memory_order_relaxed);
+    }
+
+    std::chrono::milliseconds decode_ahead() const noexcept
+    {
+        auto const ms = decode_ahead_.load(std::memory_order_relaxed);
+        return std::chrono::milliseconds{ms};
+    }
+
+    // Sets the output buffering policy. While playing, the ring buffer is
+    // reallocated to fit; when shrinking, only once it has drained enough.
+    void set_latency(audio::latency_profile const x)
+    { set_latency(audio::buffer_policy::from(x)); }
+
+    void set_latency(std::chrono::milliseconds const x)
+    { set_latency(audio::buffer_policy::from(x)); }
 
-    float volume() const
-    { return stream_->get_volume(); }
+    void set_latency(audio::buffer_policy const&);
 
-    void insert_track(media::track const& x)
-    { tracks_.push(x); }
+    audio::buffer_policy latency() const noexcept
+    { return latency_.load(); }
 
+    // Applies from the next track change on.
+    void set_transition(audio::transition_policy const& x) noexcept
+    { transition_.store(x); }
+
+    audio::transition_policy transition() const noexcept
+    { return transition_.load(); }
+
+    void set_seek_policy(audio::seek_policy const& x) noexcept
+    { seek_policy_.store(x); }
+
+    audio::seek_policy seek_policy() const noexcept
+    { return seek_policy_.load(); }
+
+    // Takes effect the next time playback is started.
+    void set_realtime(audio::realtime_policy const& x)
+    {
+        std::lock_guard<std::mutex> const lk{mtx_};
+        realtime_ = x;
+    }
+
+    // Reports which steps of the real-time policy succeeded when playback
+    // was last started.
+    audio::realtime_status realtime() const noexcept
+    {
+        return {
+            rt_scheduling_.load(std::memory_order_relaxed),
+            rt_affinity_.load(std::memory_order_relaxed),
+            rt_memory_lock_.load(std::memory_order_relaxed),
+        };
+    }
+
+    // The player thread only wakes up once the output has drained the ring
+    // buffer to its low watermark, so the position it last published is
+    // extrapolated by the number of samples played since. The latency of the
+    // filter chain and of the output device is accounted for.
     template<typename Duration = std::chrono::nanoseconds>
     Duration position() const noexcept
     {
-        auto const pos = position_.load(std::memory_order_relaxed);
+        auto const c = clock_.load();
+        auto const played = played_.load(std::memory_order_relaxed);
+        auto const pos = compensate(c, played);
         return Duration{muldiv(pos, Duration::period::den, clock_rate_)};
     }
 
+    // Like position(), but also returns the host time at which the output
+    // callback last ran. Until the next one, consumers may interpolate from
+    // it at the nominal sample rate rather than poll.
+    audio::playback_timestamp timestamp() const noexcept
+    {
+        auto const c = clock_.load();
+        auto const t = timestamp_.load();
+        auto const pos = compensate(c, t.played);
+
+        using clock = std::chrono::steady_clock;
+        return {
+            std::chrono::nanoseconds{
+                muldiv(pos, std::nano::den, clock_rate_)},
+            clock::time_point{clock::duration{t.time}},
+        };
+    }
+
+    // Safe to call from any thread, at any time.
+    audio::playback_stats statistics() const noexcept
+    { return monitor_.snapshot(); }
+
     auto bit_rate() const noexcept
     { return bit_rate_.load(std::memory_order_relaxed); }
 
@@ -97,10 +272,10 @@ private:
     struct event
     {
         enum type : uint32 {
-            seek  = (1 << 0),
-            state = (1 << 1),
-            stop  = (1 << 2),
-            pause = (1 << 3),
+            seek    = (1 << 0),
+            stop    = (1 << 1),
+            pause   = (1 << 2),
+            latency = (1 << 3),
         };
 
         explicit event(enum type const t, uint64 const d = 0) noexcept :
@@ -112,19 +287,56 @@ private:
         uint64    data;
     };
 
+    // Sample `played` of the output is sample `position` of the track, and
+    // is audible `latency` samples later.
+    struct clock_sync
+    {
+        uint64 position;
+        uint64 played;
+        uint64 latency;
+    };
+
+    static uint64 compensate(clock_sync const& c, uint64 const played) noexcept
+    {
+        auto const pos = static_cast<int64>(c.position + (played - c.played)
+                                                       - c.latency);
+        return (pos > 0) ? static_cast<uint64>(pos) : 0;
+    }
+
+    class decoder_context;
+
     AMP_INTERNAL_LINKAGE void run_thread_();
+    AMP_INTERNAL_LINKAGE void run_decoder_(decoder_context&);
 
     uint64 clock_rate_{-1ULL};
     audio::player_delegate& delegate_;
-    spsc::queue<media::track> tracks_;
+    spsc::queue<media::track_handle> tracks_;
     spsc::queue<event> events_;
     auto_reset_event ready_;
+    auto_reset_event decoder_wake_;
+    std::atomic<uint32> decode_ahead_{250};
     std::mutex mtx_;
     std::thread thread_;
-    std::atomic<uint64> position_{};
+    seqlock<clock_sync> clock_;
+    std::atomic<uint64> played_{};
+    seqlock<audio::output_timestamp> timestamp_;
     std::atomic<uint32> bit_rate_{};
     std::vector<u8string> preset_;
     audio::replaygain_config rg_config_;
+    audio::filter_chain_exchange chains_;
+    seqlock<audio::format> source_format_;
+    seqlock<audio::format> output_format_;
+    seqlock<audio::buffer_policy> latency_{
+        audio::buffer_policy::from(audio::latency_profile::balanced)};
+    seqlock<audio::seek_policy> seek_policy_;
+    seqlock<audio::transition_policy> transition_;
+    seqlock<audio::output_stage_policy> output_stage_;
+    std::atomic<float> volume_{1.f};
+    audio::playback_monitor monitor_;
+    audio::realtime_policy realtime_;
+    std::atomic<realtime::result> rt_scheduling_{};
+    std::atomic<realtime::result> rt_affinity_{};
+    std::atomic<realtime::result> rt_memory_lock_{};
 
     u8string session_id_;
     u8string device_id_;
@@ -24,8 +24,6 @@ namespace media {
 
 namespace audio {
 
-class packet;
-
 
 enum class replaygain_mode : uint8 {
     none  = 0,
@@ -98,10 +96,13 @@ private:
     replaygain_mode mode_;
 };
 
+// Holds the scale for the current track; it is applied as the player renders
+// into the sink (see output_stage::scale), and limited at the output stage.
 class replaygain_filter
 {
 public:
-    void process(audio::packet&) const noexcept;
+    float scale() const noexcept
+    { return scale_; }
 
     void calibrate(replaygain_info const& info) noexcept
     { scale_ = config_.compute_scale(info); }
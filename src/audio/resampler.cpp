@@ -0,0 +1,349 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// audio/resampler.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/filter.hpp>
+#include <amp/audio/format.hpp>
+#include <amp/audio/packet.hpp>
+#include <amp/bitops.hpp>
+#include <amp/error.hpp>
+#include <amp/numeric.hpp>
+#include <amp/range.hpp>
+#include <amp/stddef.hpp>
+
+#include "audio/resampler.hpp"
+#include "core/cpu.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <numeric>
+
+#if defined(AMP_HAS_X86) || defined(AMP_HAS_X64)
+# include <immintrin.h>
+#endif
+
+
+namespace amp {
+namespace audio {
+namespace {
+
+// Ratios with more branches than this are interpolated from `interpolated`
+// branches instead of being tabulated exactly.
+constexpr uint32 max_exact_branches = 1024;
+constexpr uint32 interpolated_branches = 512;
+
+// Input frames fed through the history at a time.
+constexpr std::size_t chunk_frames = 4096;
+
+struct quality_spec
+{
+    uint32 taps;            // filter length at unity ratio, in input frames
+    double attenuation;     // stop band, in dB
+};
+
+// Each level doubles the length, which halves the transition band; the stop
+// band starts at the Nyquist frequency of the lower of the two rates.
+constexpr quality_spec quality_specs[] {
+    {  16,  60. },          // quality_minimum
+    {  32,  80. },          // quality_low
+    {  64, 100. },          // quality_medium
+    { 128, 120. },          // quality_high
+    { 256, 140. },          // quality_maximum
+};
+
+double bessel_i0(double const x) noexcept
+{
+    auto sum = 1.;
+    auto term = 1.;
+    for (auto k = 1.; term > sum * 1e-16; k += 1.) {
+        term *= (x * x) / (4. * k * k);
+        sum += term;
+    }
+    return sum;
+}
+
+double kaiser_beta(double const attenuation) noexcept
+{
+    return 0.1102 * (attenuation - 8.7);
+}
+
+
+float dot_generic(float const* const a, float const* const x,
+                  std::size_t const n) noexcept
+{
+    float s[4]{};
+    for (auto i = 0_sz; i != n; i += 4) {
+        s[0] += a[i + 0] * x[i + 0];
+        s[1] += a[i + 1] * x[i + 1];
+        s[2] += a[i + 2] * x[i + 2];
+        s[3] += a[i + 3] * x[i + 3];
+    }
+    return (s[0] + s[1]) + (s[2] + s[3]);
+}
+
+#if defined(AMP_HAS_X86) || defined(AMP_HAS_X64)
+
+AMP_TARGET("sse")
+AMP_INLINE float hsum(__m128 const x) noexcept
+{
+    auto const y = _mm_add_ps(x, _mm_movehl_ps(x, x));
+    return _mm_cvtss_f32(_mm_add_ss(y, _mm_shuffle_ps(y, y, 0x55)));
+}
+
+AMP_TARGET("sse")
+float dot_sse(float const* const a, float const* const x,
+              std::size_t const n) noexcept
+{
+    auto s0 = _mm_setzero_ps();
+    auto s1 = _mm_setzero_ps();
+
+    AMP_DISABLE_LOOP_UNROLLING_AND_VECTORIZATION
+    for (auto i = 0_sz; i != n; i += 8) {
+        s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(&a[i + 0]),
+                                       _mm_loadu_ps(&x[i + 0])));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(&a[i + 4]),
+                                       _mm_loadu_ps(&x[i + 4])));
+    }
+    return hsum(_mm_add_ps(s0, s1));
+}
+
+AMP_TARGET("avx2,fma")
+float dot_avx2(float const* const a, float const* const x,
+               std::size_t const n) noexcept
+{
+    auto s0 = _mm256_setzero_ps();
+    auto s1 = _mm256_setzero_ps();
+
+    AMP_DISABLE_LOOP_UNROLLING_AND_VECTORIZATION
+    for (auto i = 0_sz; i != n; i += 16) {
+        s0 = _mm256_fmadd_ps(_mm256_loadu_ps(&a[i + 0]),
+                             _mm256_loadu_ps(&x[i + 0]), s0);
+        s1 = _mm256_fmadd_ps(_mm256_loadu_ps(&a[i + 8]),
+                             _mm256_loadu_ps(&x[i + 8]), s1);
+    }
+    auto const s = _mm256_add_ps(s0, s1);
+    return hsum(_mm_add_ps(_mm256_castps256_ps128(s),
+                           _mm256_extractf128_ps(s, 1)));
+}
+
+#endif  // AMP_HAS_X86 || AMP_HAS_X64
+
+
+polyphase_resampler::kernel* select_kernel() noexcept
+{
+#if defined(AMP_HAS_X86) || defined(AMP_HAS_X64)
+    if (cpu::has_avx2() && cpu::has_fma3()) {
+        return &dot_avx2;
+    }
+    if (cpu::has_sse()) {
+        return &dot_sse;
+    }
+#endif
+    return &dot_generic;
+}
+
+}     // namespace <unnamed>
+
+
+void polyphase_resampler::set_sample_rate(uint32 const x) noexcept
+{
+    orate_ = x;
+}
+
+void polyphase_resampler::set_quality(uint8 const x) noexcept
+{
+    quality_ = std::clamp(x, uint8{audio::quality_minimum},
+                          uint8{audio::quality_maximum});
+}
+
+void polyphase_resampler::calibrate(audio::format& fmt)
+{
+    if (fmt.sample_rate == 0 || orate_ == 0) {
+        raise(errc::invalid_argument, "invalid resampling ratio: %u -> %u",
+              fmt.sample_rate, orate_);
+    }
+
+    irate_ = fmt.sample_rate;
+    channels_ = fmt.channels;
+
+    auto const g = std::gcd(irate_, orate_);
+    up_ = orate_ / g;
+    down_ = irate_ / g;
+    branches_ = (up_ <= max_exact_branches) ? up_ : interpolated_branches;
+
+    design_();
+    dot_ = select_kernel();
+
+    capacity_ = taps_ + chunk_frames;
+    history_.assign(capacity_ * channels_, 0.f);
+    blend_.assign(taps_, 0.f);
+    out_.set_channel_layout(fmt.channel_layout, fmt.channels);
+    out_.reserve(static_cast<std::size_t>(
+        muldiv(chunk_frames, up_, down_) + 1) * channels_);
+    flush();
+
+    fmt.sample_rate = orate_;
+}
+
+void polyphase_resampler::design_()
+{
+    auto const& spec = quality_specs[quality_ - audio::quality_minimum];
+
+    // When decimating, both the cut-off and the transition band shrink by
+    // the ratio, so the filter grows by as much to keep the same quality.
+    auto const bandwidth = std::min(1., double(up_) / double(down_));
+    taps_ = static_cast<uint32>(align_up(
+        static_cast<uint32>(std::ceil(spec.taps / bandwidth)), 16));
+    taps_ = std::min(taps_, uint32{4096});
+
+    // Kaiser's estimate of the transition band, as a fraction of the input
+    // Nyquist frequency; it ends right at the stop band.
+    auto const transition = (spec.attenuation - 8.)
+                          / (2.285 * pi<double> * taps_);
+    auto const cutoff = std::max(bandwidth - transition / 2, bandwidth / 2);
+    auto const beta = kaiser_beta(spec.attenuation);
+    auto const i0_beta = bessel_i0(beta);
+
+    auto const G = static_cast<std::size_t>(branches_);
+    auto const taps = static_cast<std::size_t>(taps_);
+    auto const half = static_cast<double>(taps * G) / 2.;
+
+    coeffs_.assign((G + 1) * taps, 0.f);
+    std::vector<double> branch(taps);
+
+    for (auto const p : xrange(G + 1)) {
+        auto sum = 0.;
+        for (auto const k : xrange(taps)) {
+            auto const n = static_cast<double>(p + k * G) - half;
+            auto const t = n / static_cast<double>(G);
+            auto const w = n / half;
+            auto const x = pi<double> * cutoff * t;
+            auto const sinc = (std::abs(x) < 1e-12) ? 1. : std::sin(x) / x;
+            auto const window = bessel_i0(beta * std::sqrt(
+                std::max(0., 1. - w * w))) / i0_beta;
+
+            branch[k] = cutoff * sinc * window;
+            sum += branch[k];
+        }
+
+        // Normalize each branch to unity gain at DC, so that the branches
+        // do not modulate the signal as the phase advances. Coefficients
+        // are stored oldest input first, to match the history.
+        for (auto const k : xrange(taps)) {
+            coeffs_[p * taps + (taps - 1 - k)] =
+                static_cast<float>(branch[k] / sum);
+        }
+    }
+}
+
+std::size_t polyphase_resampler::pending_() const noexcept
+{
+    if (pos_ >= len_) {
+        return 0;
+    }
+    auto const span = uint64{len_ - pos_} * up_ - frac_;
+    return static_cast<std::size_t>((span + down_ - 1) / down_);
+}
+
+void polyphase_resampler::run_(float* out, std::size_t count) noexcept
+{
+    auto const taps = static_cast<std::size_t>(taps_);
+    auto const exact = (branches_ == up_);
+
+    while (count-- != 0) {
+        float const* h;
+        if (exact) {
+            h = &coeffs_[static_cast<std::size_t>(frac_) * taps];
+        }
+        else {
+            auto const x = frac_ * branches_;
+            auto const p = static_cast<std::size_t>(x / up_);
+            auto const mu = static_cast<float>(x % up_)
+                          / static_cast<float>(up_);
+            auto const h0 = &coeffs_[p * taps];
+            auto const h1 = h0 + taps;
+            for (auto const k : xrange(taps)) {
+                blend_[k] = h0[k] + mu * (h1[k] - h0[k]);
+            }
+            h = blend_.data();
+        }
+
+        auto const first = pos_ + 1 - taps;
+        for (auto const c : xrange(channels_)) {
+            *out++ = (*dot_)(h, &history_[c * capacity_ + first], taps);
+        }
+
+        frac_ += down_;
+        pos_ += static_cast<std::size_t>(frac_ / up_);
+        frac_ %= up_;
+    }
+}
+
+void polyphase_resampler::compact_() noexcept
+{
+    auto const shift = std::min(pos_ + 1 - taps_, len_);
+    if (shift == 0) {
+        return;
+    }
+
+    for (auto const c : xrange(channels_)) {
+        auto const plane = &history_[c * capacity_];
+        std::memmove(plane, plane + shift, sizeof(float) * (len_ - shift));
+    }
+    len_ -= shift;
+    pos_ -= shift;
+}
+
+void polyphase_resampler::process(audio::packet& pkt)
+{
+    auto const in = pkt.data();
+    auto const frames = pkt.frames();
+    auto done = 0_sz;
+
+    out_.clear();
+    for (auto i = 0_sz; i != frames; ) {
+        auto const n = std::min(frames - i, capacity_ - len_);
+        for (auto const c : xrange(channels_)) {
+            auto const plane = &history_[c * capacity_ + len_];
+            for (auto const t : xrange(n)) {
+                plane[t] = in[(i + t) * channels_ + c];
+            }
+        }
+        len_ += n;
+        i += n;
+
+        auto const count = pending_();
+        out_.resize((done + count) * channels_, uninitialized);
+        run_(out_.data() + done * channels_, count);
+        done += count;
+        compact_();
+    }
+    pkt.assign(out_.data(), done * channels_);
+}
+
+void polyphase_resampler::drain(audio::packet& pkt)
+{
+    // Push the last inputs past the centre of the filter.
+    pkt.resize((taps_ / 2 + 1) * channels_);
+    process(pkt);
+}
+
+void polyphase_resampler::flush() noexcept
+{
+    std::fill(history_.begin(), history_.end(), 0.f);
+    frac_ = 0;
+    len_ = taps_ - 1;
+    pos_ = taps_ - 1;
+}
+
+uint64 polyphase_resampler::get_latency() const noexcept
+{
+    return muldiv(uint64{taps_ / 2}, up_, down_);
+}
+
+}}    // namespace amp::audio
@@ -0,0 +1,86 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// audio/resampler.hpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef AMP_INCLUDED_3D2811CD_9CBF_4E87_922F_631F81A34EB4
+#define AMP_INCLUDED_3D2811CD_9CBF_4E87_922F_631F81A34EB4
+
+
+#include <amp/audio/filter.hpp>
+#include <amp/audio/format.hpp>
+#include <amp/audio/packet.hpp>
+#include <amp/stddef.hpp>
+
+#include <cstddef>
+#include <vector>
+
+
+namespace amp {
+namespace audio {
+
+// -- Overview --
+//
+// The built-in resampler, used when no resampler plugin is available. The
+// rate ratio is reduced to up/down, and a Kaiser-windowed sinc is tabulated
+// as `up` polyphase branches, so that each output sample is a single dot
+// product with the input history. Ratios whose `up` is too large for a table
+// (e.g. 44100 -> 48001) use a fixed number of branches instead, linearly
+// interpolating between the two nearest ones.
+//
+// The history is kept planar, so that the dot products run over contiguous
+// memory; it is sized once in calibrate, and the input is fed through it in
+// chunks, so processing only allocates while the output packet grows.
+
+class polyphase_resampler
+{
+public:
+    using kernel = float(float const* coeffs, float const* x,
+                         std::size_t taps) noexcept;
+
+    void calibrate(audio::format&);
+    void process(audio::packet&);
+    void drain(audio::packet&);
+    void flush() noexcept;
+    uint64 get_latency() const noexcept;
+
+    void set_sample_rate(uint32) noexcept;
+    void set_quality(uint8) noexcept;
+
+    // Filter length per branch, in input frames.
+    uint32 taps() const noexcept
+    { return taps_; }
+
+private:
+    void design_();
+    void run_(float* out, std::size_t count) noexcept;
+    void compact_() noexcept;
+    std::size_t pending_() const noexcept;
+
+    std::vector<float> coeffs_;     // [branch][taps], one extra branch
+    std::vector<float> history_;    // [channel][capacity]
+    std::vector<float> blend_;      // interpolated branch
+    audio::packet out_;
+    kernel* dot_{};
+
+    uint64 frac_{};                 // position between inputs, in 1/up
+    std::size_t pos_{};             // index of the newest input in a dot
+    std::size_t len_{};
+    std::size_t capacity_{};
+
+    uint32 irate_{};
+    uint32 orate_{};
+    uint32 up_{};
+    uint32 down_{};
+    uint32 branches_{};
+    uint32 taps_{};
+    uint32 channels_{};
+    uint8 quality_{audio::quality_medium};
+};
+
+}}    // namespace amp::audio
+
+
+#endif  // AMP_INCLUDED_3D2811CD_9CBF_4E87_922F_631F81A34EB4
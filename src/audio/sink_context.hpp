@@ -11,16 +11,26 @@
 
 #include <amp/audio/format.hpp>
 #include <amp/audio/output.hpp>
+#include <amp/numeric.hpp>
+#include <amp/bitops.hpp>
+#include <amp/range.hpp>
 #include <amp/ref_ptr.hpp>
 #include <amp/stddef.hpp>
 
 #include "audio/circular_buffer.hpp"
+#include "audio/output_stage.hpp"
+#include "audio/playback_stats.hpp"
+#include "audio/player.hpp"
+#include "core/allocation_guard.hpp"
 #include "core/event.hpp"
+#include <amp/seqlock.hpp>
 
 #include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <cstddef>
+#include <new>
+#include <ratio>
 #include <utility>
 
 
@@ -28,23 +38,49 @@ namespace amp {
 namespace audio {
 namespace {
 
-class sink_context
+// -- Overview --
+//
+// Owns the output stream and the ring buffer that feeds it. The player thread
+// renders the last stage of the filter chain directly into the ring's write
+// region, and a stream that supports it reads the ring in place, so samples
+// are not copied again on their way to the device. The output stage (volume,
+// limiter and dither) runs in the output callback, in place for such streams
+// and fused with the copy out of the ring for the others.
+
+class sink_context final :
+    private audio::output_source
 {
 public:
     explicit sink_context(auto_reset_event& ev,
-                          ref_ptr<audio::output_stream> s) :
+                          audio::playback_monitor& m,
+                          std::atomic<uint64>& played,
+                          seqlock<audio::output_timestamp>& ts,
+                          std::atomic<float> const& volume,
+                          seqlock<audio::output_stage_policy> const& stage,
+                          ref_ptr<audio::output_stream> s,
+                          audio::buffer_policy const& policy) :
         format(s->get_format()),
         ready_(ev),
-        buffer_(format.sample_rate * format.channels),
-        stream_(std::move(s))
-    {}
+        monitor_(m),
+        played_(played),
+        timestamp_(ts),
+        volume_(volume),
+        stage_policy_(stage),
+        buffer_(to_samples(policy.buffer), mirror_hugepages),
+        stream_(std::move(s)),
+        stage_(format, stage.load())
+    {
+        stage_.set_volume(volume.load(std::memory_order_relaxed));
+        set_policy(policy);
+        monitor_.reset(high_);
+    }
 
     ~sink_context()
     { stream_->stop(); }
 
     void start()
     {
-        stream_->start({&sink_context::read, this});
+        start_stream_();
         paused_ = false;
     }
 
@@ -54,30 +90,106 @@ public:
         paused_ = true;
     }
 
-    void flush()
+    // Stops the output stream, empties the ring buffer and restarts it.
+    // `requested` is when the seek that caused the flush was handled.
+    void flush(playback_monitor::clock::time_point const requested)
     {
         if (!paused_) {
             stream_->stop();
         }
         buffer_.read_flush();
+        staged_ = 0;
+        consumed_.store(written_, std::memory_order_relaxed);
+        discarded_ = discard_to_.load(std::memory_order_relaxed);
+        audible_since_ = requested.time_since_epoch().count();
+        fade_in_ = 0;
+        monitor_.restart();
         if (!paused_) {
-            stream_->start({&sink_context::read, this});
+            start_stream_();
         }
     }
 
-    std::size_t write(float const* const src, std::size_t n) noexcept
+    // Like flush(), but leaves the output stream running: the output callback
+    // drops everything written so far the next time it runs, and plays
+    // whatever is written after this call next. The `fade` keeps that much
+    // of the old audio, fading it out, and fades the new audio in.
+    void discard(playback_monitor::clock::time_point const requested,
+                 std::chrono::milliseconds const fade) noexcept
+    {
+        auto const frames = muldiv(static_cast<uint64>(fade.count()),
+                                   format.sample_rate, 1000);
+        fade_.store(static_cast<uint32>(frames), std::memory_order_relaxed);
+        seek_requested_.store(requested.time_since_epoch().count(),
+                              std::memory_order_relaxed);
+        discard_to_.store(written_, std::memory_order_release);
+        fade_in_ = fade_in_length_ =
+            static_cast<std::size_t>(frames * format.channels);
+    }
+
+    void set_policy(audio::buffer_policy const& x)
+    {
+        high_ = to_samples(x.buffer);
+        low_ = std::min(to_samples(x.low_watermark), high_);
+        wake_below(0);
+        monitor_.set_capacity(high_);
+        resize();
+    }
+
+    // Locks the ring buffer, and any that replaces it, into physical memory.
+    bool lock_memory() noexcept
     {
-        n = std::min(n, buffer_.write_prepare());
+        locked_ = true;
+        return buffer_.lock();
+    }
+
+    // The output callback wakes the player thread when the ring buffer's
+    // fill level drops below the low watermark, or below `n` if greater.
+    void wake_below(std::size_t const n) noexcept
+    {
+        wake_.store(std::max(low_, n), std::memory_order_relaxed);
+    }
+
+    // Lets `render(dst, k)` write up to `n` samples straight into the ring
+    // buffer, and returns `k`: the number of samples that fit below the high
+    // watermark.
+    template<typename Render>
+    std::size_t write(std::size_t n, Render&& render)
+    {
+        if (AMP_UNLIKELY(resize_pending_)) {
+            resize();
+        }
+
+        // Audio that is about to be discarded does not count towards the
+        // high watermark, but still occupies the ring.
+        auto const limit = std::min(high_, buffer_.capacity());
+        auto const fill = static_cast<std::size_t>(delay());
+        n = std::min({n, buffer_.write_prepare(),
+                      (limit > fill) ? (limit - fill) : 0});
         if (AMP_LIKELY(n != 0)) {
-            std::copy_n(src, n, buffer_.write_cursor());
+            auto const dst = buffer_.write_cursor();
+            render(dst, n);
+            if (AMP_UNLIKELY(fade_in_ != 0)) {
+                apply_fade_in_(dst, n);
+            }
             buffer_.write_commit(n);
+            written_ += n;
         }
         return n;
     }
 
+    // Samples between the output callback and the speaker.
+    uint64 device_latency() const noexcept
+    {
+        return device_latency_;
+    }
+
+    // Number of samples written that have not yet been played, excluding
+    // any that are about to be discarded.
     uint64 delay() const noexcept
     {
-        return buffer_.read_avail();
+        auto const consumed = consumed_.load(std::memory_order_relaxed);
+        auto const discard = discard_to_.load(std::memory_order_relaxed);
+        return written_ - std::max(consumed, discard);
     }
 
     audio::format const format;
@@ -85,13 +197,223 @@ public:
 private:
     static void read(void*, float*, uint32) noexcept;
 
+    float const* acquire(uint32&) noexcept override;
+    void release(uint32) noexcept override;
+    std::size_t prepare_(std::size_t) noexcept;
+    void consume_(std::size_t) noexcept;
+    std::size_t discard_(uint64, std::size_t) noexcept;
+    void apply_fade_in_(float*, std::size_t) noexcept;
+
+    void start_stream_()
+    {
+        // Starting a stream is free to allocate, even when it is restarted
+        // from the player thread's steady-state loop.
+        allocation_guard::suspend const unguarded;
+
+        monitor_.restart();
+        if (!stream_->start_pull(*this)) {
+            stream_->start({&sink_context::read, this});
+        }
+        device_latency_ = stream_->get_latency() * format.channels;
+    }
+
+    // Reallocates the ring buffer to fit the high watermark, keeping its
+    // contents. A smaller ring is only swapped in once the output has
+    // drained the current one far enough, so no audio is ever dropped.
+    void resize()
+    {
+        resize_pending_ = false;
+
+        auto const granularity = aux::mirror_granularity() / sizeof(float);
+        auto const n = ceil_pow2(std::max(high_, granularity));
+        if (n == buffer_.capacity()) {
+            return;
+        }
+        if (buffer_.read_avail() > n) {
+            resize_pending_ = true;
+            return;
+        }
+
+        try {
+            audio::circular_buffer<float> tmp{n, mirror_hugepages};
+            if (locked_) {
+                (void)tmp.lock();
+            }
+
+            if (!paused_) {
+                stream_->stop();
+            }
+            auto const fill = buffer_.read_acquire();
+            std::copy_n(buffer_.read_cursor(), fill, tmp.write_cursor());
+            tmp.write_commit(fill);
+            buffer_.swap(tmp);
+
+            if (!paused_) {
+                start_stream_();
+            }
+        }
+        catch (std::bad_alloc const&) {
+            // Keep using the current ring; write() never exceeds it.
+        }
+    }
+
+    std::size_t to_samples(std::chrono::milliseconds const x) const noexcept
+    {
+        auto const frames = muldiv(static_cast<uint64>(x.count()),
+                                   format.sample_rate, 1000);
+        return static_cast<std::size_t>(frames * format.channels);
+    }
+
     auto_reset_event& ready_;
+    audio::playback_monitor& monitor_;
+    std::atomic<uint64>& played_;
+    seqlock<audio::output_timestamp>& timestamp_;
+    std::atomic<float> const& volume_;
+    seqlock<audio::output_stage_policy> const& stage_policy_;
     audio::circular_buffer<float> buffer_;
     ref_ptr<audio::output_stream> stream_;
+    std::size_t high_;
+    std::size_t low_;
+    std::atomic<std::size_t> wake_;
+    std::size_t acquired_{};
+    uint64 device_latency_{};
+
+    // Counts of samples that went through the ring buffer, used to discard
+    // its contents without stopping the output callback.
+    uint64 written_{};
+    std::atomic<uint64> consumed_{0};
+    std::atomic<uint64> discard_to_{0};
+    std::atomic<uint32> fade_{0};
+    std::atomic<int64> seek_requested_{0};
+    std::size_t fade_in_{};
+    std::size_t fade_in_length_{};
+
+    // Output callback state. The first `staged_` samples of the readable
+    // region have already been through the output stage.
+    audio::output_stage stage_;
+    std::size_t staged_{};
+    uint64 discarded_{};
+    int64 audible_since_{};
     bool paused_{false};
+    bool resize_pending_{false};
+    bool locked_{false};
 };
 
 
+std::size_t sink_context::prepare_(std::size_t const n) noexcept
+{
+    // Everything written before the discard point is visible once it is.
+    auto const to = discard_to_.load(std::memory_order_acquire);
+    auto avail = buffer_.read_acquire();
+    if (AMP_UNLIKELY(to != discarded_)) {
+        avail -= discard_(to, avail);
+    }
+
+    auto const frames = n / format.channels;
+    auto const now = playback_monitor::clock::now();
+    timestamp_.store({played_.load(std::memory_order_relaxed),
+                      now.time_since_epoch().count()});
+    monitor_.record_callback(avail, n, std::chrono::nanoseconds{
+        muldiv(uint64{frames}, std::nano::den, format.sample_rate)});
+
+    stage_.set_policy(stage_policy_.load());
+    stage_.set_volume(volume_.load(std::memory_order_relaxed));
+
+    acquired_ = avail;
+    return std::min(avail, n);
+}
+
+float const* sink_context::acquire(uint32& frames) noexcept
+{
+    auto const n = std::size_t{frames} * format.channels;
+    auto const m = prepare_(n);
+
+    // The stream may release less than it acquired, so samples that are
+    // handed out again have already been processed.
+    auto const p = const_cast<float*>(buffer_.read_cursor());
+    if (m > staged_) {
+        stage_.process(p + staged_, p + staged_, m - staged_);
+        staged_ = m;
+    }
+
+    if (AMP_UNLIKELY(m < n)) {
+        frames = static_cast<uint32>(m / format.channels);
+    }
+    return p;
+}
+
+void sink_context::release(uint32 const frames) noexcept
+{
+    consume_(std::min(std::size_t{frames} * format.channels, acquired_));
+}
+
+void sink_context::consume_(std::size_t const n) noexcept
+{
+    buffer_.read_release(n);
+    staged_ -= std::min(staged_, n);
+    consumed_.store(consumed_.load(std::memory_order_relaxed) + n,
+                    std::memory_order_relaxed);
+    played_.store(played_.load(std::memory_order_relaxed) + n,
+                  std::memory_order_release);
+
+    if (AMP_UNLIKELY(audible_since_ != 0) && n != 0) {
+        using clock = playback_monitor::clock;
+        auto const since = clock::time_point{clock::duration{audible_since_}};
+        monitor_.record_seek(clock::now() - since);
+        audible_since_ = 0;
+    }
+
+    // Only wake the player thread once the fill level crosses the watermark;
+    // it then tops the ring buffer up to the high watermark in one go.
+    auto const wake = wake_.load(std::memory_order_relaxed);
+    if (acquired_ >= wake && (acquired_ - n) < wake) {
+        ready_.post();
+    }
+}
+
+std::size_t sink_context::discard_(uint64      const to,
+                                   std::size_t const avail) noexcept
+{
+    discarded_ = to;
+    audible_since_ = seek_requested_.exchange(0, std::memory_order_relaxed);
+
+    auto const consumed = consumed_.load(std::memory_order_relaxed);
+    auto const skip = static_cast<std::size_t>(
+        std::min<uint64>((to > consumed) ? (to - consumed) : 0, avail));
+
+    // The output callback owns the readable region until it releases it, so
+    // it may rewrite it: the oldest `keep` samples are faded out and moved
+    // up to just in front of the new audio.
+    auto const channels = format.channels;
+    auto const keep = std::min<std::size_t>(
+        std::size_t{fade_.load(std::memory_order_relaxed)} * channels, skip);
+    auto const frames = static_cast<float>(keep / channels + 1);
+    auto const p = const_cast<float*>(buffer_.read_cursor());
+    for (auto i = keep; i-- != 0; ) {
+        auto const gain = 1.f - static_cast<float>(i / channels + 1) / frames;
+        p[skip - keep + i] = p[i] * gain;
+    }
+
+    auto const n = skip - keep;
+    staged_ = (staged_ > skip) ? (staged_ - n) : std::min(staged_, keep);
+    buffer_.read_release(n);
+    consumed_.store(consumed + n, std::memory_order_relaxed);
+    return n;
+}
+
+void sink_context::apply_fade_in_(float*      const dst,
+                                  std::size_t const n) noexcept
+{
+    auto const channels = format.channels;
+    auto const frames = static_cast<float>(fade_in_length_ / channels + 1);
+    auto const first = fade_in_length_ - fade_in_;
+    auto const m = std::min(n, fade_in_);
+    for (auto const i : xrange(m)) {
+        dst[i] *= static_cast<float>((first + i) / channels + 1) / frames;
+    }
+    fade_in_ -= m;
+}
+
 void sink_context::read(void*  const opaque,
                         float* const dst,
                         uint32 const frames) noexcept
@@ -101,16 +423,15 @@ void sink_context::read(void*  const opaque,
     }
 
     auto&& self = *static_cast<sink_context*>(opaque);
-    auto n = std::size_t{frames} * self.format.channels;
+    auto const n = std::size_t{frames} * self.format.channels;
 
-    auto const avail = self.buffer_.read_acquire();
-    if (AMP_UNLIKELY(avail < n)) {
-        std::fill_n(dst + avail, n - avail, 0.f);
-        n = avail;
-    }
-    std::copy_n(self.buffer_.read_cursor(), n, dst);
-    self.buffer_.read_release(n);
-    self.ready_.post();
+    auto const m = self.prepare_(n);
+
+    // Nothing is ever staged in push mode.
+    AMP_ASSERT(self.staged_ == 0);
+    self.stage_.process(self.buffer_.read_cursor(), dst, m);
+    std::fill_n(dst + m, n - m, 0.f);
+    self.consume_(m);
 }
 
 }}}   // namespace amp::audio::<unnamed>
@@ -0,0 +1,122 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// audio/source_context.hpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef AMP_INCLUDED_98761548_8826_41E5_A3B8_371DD3ED1121
+#define AMP_INCLUDED_98761548_8826_41E5_A3B8_371DD3ED1121
+
+
+#include <amp/audio/format.hpp>
+#include <amp/audio/input.hpp>
+#include <amp/audio/packet.hpp>
+#include <amp/numeric.hpp>
+#include <amp/ref_ptr.hpp>
+#include <amp/stddef.hpp>
+
+#include "audio/input_slice.hpp"
+#include "audio/replaygain.hpp"
+#include "media/track.hpp"
+
+#include <chrono>
+#include <ratio>
+#include <utility>
+
+
+namespace amp {
+namespace audio {
+namespace {
+
+struct source_context
+{
+    AMP_INLINE explicit operator bool() const noexcept
+    { return static_cast<bool>(input); }
+
+    AMP_INLINE audio::input* operator->() const noexcept
+    { return input.get(); }
+
+    AMP_INLINE void reset() noexcept
+    {
+        input.reset();
+        primed.clear();
+    }
+
+    AMP_INLINE void reset(media::track const& x)
+    {
+        input = audio::input::resolve(x.location, audio::playback);
+        if (x.chapter) {
+            input = audio::input_slice::make(std::move(input), x);
+        }
+        frames = x.frames;
+        offset = 0;
+        format = input->get_format();
+        rg_info.reset(x.info);
+        primed.clear();
+    }
+
+    // Decodes roughly the first 1/8th of a second of audio so that the first
+    // reads after a track change never have to wait on the decoder.
+    void prime()
+    {
+        primed.clear();
+        primed.set_channel_layout(format.channel_layout);
+
+        audio::packet tmp;
+        while (primed.frames() < (format.sample_rate / 8)) {
+            tmp.clear();
+            tmp.set_channel_layout(format.channel_layout);
+            input->read(tmp);
+            if (tmp.empty()) {
+                break;
+            }
+            primed.set_bit_rate(tmp.bit_rate());
+            primed.append(tmp.cbegin(), tmp.cend());
+        }
+    }
+
+    void read(audio::packet& pkt)
+    {
+        if (AMP_UNLIKELY(!primed.empty())) {
+            pkt.swap(primed);
+            primed.clear();
+        }
+        else {
+            pkt.set_channel_layout(format.channel_layout);
+            input->read(pkt);
+        }
+        offset += pkt.frames();
+    }
+
+    void seek(uint64 const pos)
+    {
+        primed.clear();
+        input->seek(pos);
+        offset = pos;
+    }
+
+    // Time left until the end of the track, going by its metadata; the
+    // maximum if its length is unknown.
+    std::chrono::nanoseconds remaining() const noexcept
+    {
+        if (AMP_UNLIKELY(frames == 0)) {
+            return std::chrono::nanoseconds::max();
+        }
+        auto const n = (frames > offset) ? (frames - offset) : 0;
+        return std::chrono::nanoseconds{static_cast<int64>(
+            muldiv(n, std::nano::den, format.sample_rate))};
+    }
+
+    uint64 frames;
+    uint64 offset;
+    audio::format format;
+    audio::replaygain_info rg_info;
+    audio::packet primed;
+    ref_ptr<audio::input> input;
+};
+
+}}}   // namespace amp::audio::<unnamed>
+
+
+#endif  // AMP_INCLUDED_98761548_8826_41E5_A3B8_371DD3ED1121
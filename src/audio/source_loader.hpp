@@ -0,0 +1,188 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// audio/source_loader.hpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef AMP_INCLUDED_72519216_089D_4A2F_9F3D_84F570252FD3
+#define AMP_INCLUDED_72519216_089D_4A2F_9F3D_84F570252FD3
+
+
+#include <amp/scope_guard.hpp>
+#include <amp/stddef.hpp>
+
+#include "audio/source_context.hpp"
+#include "core/event.hpp"
+#include "media/track.hpp"
+
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <utility>
+
+
+namespace amp {
+namespace audio {
+namespace {
+
+// Opens, probes and primes the next queued track on a background thread so
+// that the player thread only has to swap in a ready source_context once the
+// current track runs out. All public member functions must be called from a
+// single (player) thread.
+template<typename Source>
+class basic_source_loader
+{
+public:
+    basic_source_loader() :
+        thread_{[this]() noexcept { run_(); }}
+    {}
+
+    basic_source_loader(basic_source_loader const&) = delete;
+    basic_source_loader& operator=(basic_source_loader const&) = delete;
+
+    ~basic_source_loader()
+    {
+        stop_.store(true, std::memory_order_relaxed);
+        wake_.post();
+        thread_.join();
+    }
+
+    bool idle() const noexcept
+    {
+        return (state_.load(std::memory_order_acquire) == state::idle);
+    }
+
+    void request(media::track_handle x)
+    {
+        AMP_ASSERT(idle());
+        track_ = std::move(x);
+        state_.store(state::loading, std::memory_order_release);
+        wake_.post();
+    }
+
+    // Moves the prepared source for `x` into `out`. Waits for the load to
+    // finish if it is still in progress. Returns false if no load was ever
+    // requested for `x`, or if it was abandoned, in which case the caller
+    // must open it itself; a load for another track is abandoned without
+    // waiting for it.
+    bool take(media::track_handle const& x, Source& out)
+    {
+        // Only this thread abandons loads, so neither state can change
+        // into the other behind its back.
+        auto const current = state_.load(std::memory_order_acquire);
+        if (current == state::idle || current == state::abandoned) {
+            return false;
+        }
+
+        // `track_` is only written while idle, so the loader thread cannot
+        // be changing it.
+        if (!(track_ == x)) {
+            abandon_();
+            return false;
+        }
+        while (state_.load(std::memory_order_acquire) != state::ready) {
+            done_.wait();
+        }
+
+        AMP_SCOPE_EXIT {
+            source_.reset();
+            state_.store(state::idle, std::memory_order_relaxed);
+        };
+
+        if (error_) {
+            std::rethrow_exception(std::exchange(error_, nullptr));
+        }
+        out = std::move(source_);
+        return true;
+    }
+
+private:
+    enum class state : uint8 {
+        idle,
+        loading,
+        abandoned,
+        ready,
+    };
+
+    // A load cannot be interrupted; if it is still running (or has yet to
+    // start), the loader thread throws its result away when it gets to it,
+    // and only then goes idle.
+    void abandon_() noexcept
+    {
+        auto expected = state::loading;
+        if (state_.compare_exchange_strong(expected, state::abandoned,
+                                           std::memory_order_relaxed)) {
+            return;
+        }
+        if (expected == state::abandoned) {
+            return;
+        }
+
+        AMP_ASSERT(expected == state::ready);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        discard_();
+    }
+
+    void discard_() noexcept
+    {
+        source_.reset();
+        error_ = nullptr;
+        state_.store(state::idle, std::memory_order_release);
+    }
+
+    void run_() noexcept
+    {
+        for (;;) {
+            wake_.wait();
+            if (stop_.load(std::memory_order_relaxed)) {
+                return;
+            }
+
+            // The load may have been abandoned before it started.
+            auto const current = state_.load(std::memory_order_acquire);
+            if (current == state::abandoned) {
+                discard_();
+                continue;
+            }
+            if (current != state::loading) {
+                continue;
+            }
+
+            try {
+                source_.reset(*track_);
+                source_.prime();
+            }
+            catch (...) {
+                source_.reset();
+                error_ = std::current_exception();
+            }
+
+            auto expected = state::loading;
+            if (state_.compare_exchange_strong(expected, state::ready,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+                done_.post();
+            }
+            else {
+                discard_();
+            }
+        }
+    }
+
+    std::atomic<state> state_{state::idle};
+    std::atomic<bool> stop_{false};
+    auto_reset_event wake_;
+    auto_reset_event done_;
+    media::track_handle track_;
+    Source source_;
+    std::exception_ptr error_;
+    std::thread thread_;
+};
+
+using source_loader = basic_source_loader<audio::source_context>;
+
+}}}   // namespace amp::audio::<unnamed>
+
+
+#endif  // AMP_INCLUDED_72519216_089D_4A2F_9F3D_84F570252FD3
@@ -0,0 +1,226 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// audio/transition.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/packet.hpp>
+#include <amp/bitops.hpp>
+#include <amp/numeric.hpp>
+#include <amp/range.hpp>
+#include <amp/stddef.hpp>
+
+#include "audio/filter_chain.hpp"
+#include "audio/transition.hpp"
+#include "core/cpu.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+#if defined(AMP_HAS_X86) || defined(AMP_HAS_X64)
+# include <immintrin.h>
+#endif
+
+
+namespace amp {
+namespace audio {
+namespace {
+
+struct gain_pair
+{
+    float in;
+    float out;
+};
+
+gain_pair gains_at(transition_curve const curve, float const t) noexcept
+{
+    switch (curve) {
+    case transition_curve::linear:
+        return {t, 1.f - t};
+    case transition_curve::equal_power:
+        return {std::sin(t * pi<float> / 2), std::cos(t * pi<float> / 2)};
+    case transition_curve::dj:
+        return {std::min(t * 2, 1.f), std::min((1.f - t) * 2, 1.f)};
+    }
+    AMP_UNREACHABLE();
+}
+
+
+// ----------------------------------------------------------------------------
+// x[i] = x[i] * gx[i] + y[i] * gy[i]
+// ----------------------------------------------------------------------------
+
+void crossfade_generic(float* const x, float const* const gx,
+                       float const* const y, float const* const gy,
+                       std::size_t const n) noexcept
+{
+    for (auto const i : xrange(n)) {
+        x[i] = x[i] * gx[i] + y[i] * gy[i];
+    }
+}
+
+#if defined(AMP_HAS_X86) || defined(AMP_HAS_X64)
+
+AMP_TARGET("sse")
+void crossfade_sse(float* const x, float const* const gx,
+                   float const* const y, float const* const gy,
+                   std::size_t const n) noexcept
+{
+    auto i = 0_sz;
+
+    AMP_DISABLE_LOOP_UNROLLING_AND_VECTORIZATION
+    for (auto const last = align_down(n, 4); i != last; i += 4) {
+        auto const a = _mm_mul_ps(_mm_loadu_ps(&x[i]), _mm_loadu_ps(&gx[i]));
+        auto const b = _mm_mul_ps(_mm_loadu_ps(&y[i]), _mm_loadu_ps(&gy[i]));
+        _mm_storeu_ps(&x[i], _mm_add_ps(a, b));
+    }
+
+    AMP_DISABLE_LOOP_UNROLLING_AND_VECTORIZATION
+    for (; i != n; ++i) {
+        x[i] = x[i] * gx[i] + y[i] * gy[i];
+    }
+}
+
+AMP_TARGET("avx")
+void crossfade_avx(float* const x, float const* const gx,
+                   float const* const y, float const* const gy,
+                   std::size_t const n) noexcept
+{
+    auto i = 0_sz;
+
+    AMP_DISABLE_LOOP_UNROLLING_AND_VECTORIZATION
+    for (auto const last = align_down(n, 8); i != last; i += 8) {
+        auto const a = _mm256_mul_ps(_mm256_loadu_ps(&x[i]),
+                                     _mm256_loadu_ps(&gx[i]));
+        auto const b = _mm256_mul_ps(_mm256_loadu_ps(&y[i]),
+                                     _mm256_loadu_ps(&gy[i]));
+        _mm256_storeu_ps(&x[i], _mm256_add_ps(a, b));
+    }
+
+    AMP_DISABLE_LOOP_UNROLLING_AND_VECTORIZATION
+    for (; i != n; ++i) {
+        x[i] = x[i] * gx[i] + y[i] * gy[i];
+    }
+}
+
+#endif  // AMP_HAS_X86 || AMP_HAS_X64
+
+void crossfade(float* const x, float const* const gx,
+               float const* const y, float const* const gy,
+               std::size_t const n) noexcept
+{
+#if defined(AMP_HAS_X86) || defined(AMP_HAS_X64)
+    if (cpu::has_avx()) {
+        return crossfade_avx(x, gx, y, gy, n);
+    }
+    if (cpu::has_sse()) {
+        return crossfade_sse(x, gx, y, gy, n);
+    }
+#endif
+    crossfade_generic(x, gx, y, gy, n);
+}
+
+}     // namespace <unnamed>
+
+
+std::size_t leading_silence(audio::packet const& x) noexcept
+{
+    for (auto const i : xrange(x.size())) {
+        if (std::fabs(x[i]) > silence_threshold) {
+            return i / x.channels();
+        }
+    }
+    return x.frames();
+}
+
+
+void trailing_silence::process(audio::packet& pkt,
+                               std::size_t const max_frames)
+{
+    if (pkt.empty()) {
+        return;
+    }
+    if (leading_silence(pkt) == pkt.frames()) {
+        held_.set_channel_layout(pkt.channel_layout(), pkt.channels());
+        held_.append(pkt.cbegin(), pkt.cend());
+        pkt.clear();
+        if (held_.frames() <= max_frames) {
+            return;
+        }
+    }
+    else if (held_.empty()) {
+        return;
+    }
+    else {
+        held_.append(pkt.cbegin(), pkt.cend());
+    }
+    pkt.assign(held_.data(), held_.size());
+    held_.clear();
+}
+
+
+void transition::start(audio::transition_policy const& policy,
+                       uint64 const frames, float const gain,
+                       std::unique_ptr<audio::filter_chain> chain) noexcept
+{
+    chain_ = std::move(chain);
+    buffer_.clear();
+    elapsed_ = 0;
+    length_ = std::max(frames, uint64{1});
+    gain_ = gain;
+    curve_ = policy.curve;
+    ended_ = false;
+}
+
+std::unique_ptr<audio::filter_chain> transition::finish() noexcept
+{
+    buffer_.clear();
+    length_ = 0;
+    return std::move(chain_);
+}
+
+void transition::push(audio::packet const& x)
+{
+    if (x.empty()) {
+        ended_ = true;
+        return;
+    }
+    buffer_.set_channel_layout(x.channel_layout(), x.channels());
+    buffer_.append(x.cbegin(), x.cend());
+}
+
+void transition::mix(audio::packet& pkt)
+{
+    auto const channels = pkt.channels();
+    auto const frames = pkt.frames();
+    auto const n = pkt.size();
+
+    // Expand the per-frame gains to every sample, so that the mixing itself
+    // is a plain multiply-add over contiguous arrays.
+    gains_.resize(n * 2);
+    auto const gin = gains_.data();
+    auto const gout = gin + n;
+    auto const length = static_cast<float>(length_);
+
+    for (auto const i : xrange(frames)) {
+        auto const t = std::min(static_cast<float>(elapsed_ + i) / length, 1.f);
+        auto const g = gains_at(curve_, t);
+        std::fill_n(gin  + i * channels, channels, g.in);
+        std::fill_n(gout + i * channels, channels, g.out * gain_);
+    }
+
+    auto const m = std::min(n, buffer_.size());
+    crossfade(pkt.data(), gin, buffer_.data(), gout, m);
+    for (auto const i : xrange(m, n)) {
+        pkt[i] *= gin[i];
+    }
+
+    buffer_.pop_front(m);
+    elapsed_ += frames;
+}
+
+}}    // namespace amp::audio
@@ -0,0 +1,139 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// audio/transition.hpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef AMP_INCLUDED_6C0A0FE1_6A34_4EE2_9A7D_C55B511A77E0
+#define AMP_INCLUDED_6C0A0FE1_6A34_4EE2_9A7D_C55B511A77E0
+
+
+#include <amp/audio/packet.hpp>
+#include <amp/stddef.hpp>
+
+#include "audio/filter_chain.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+
+namespace amp {
+namespace audio {
+
+enum class transition_curve : uint8 {
+    linear,             // constant amplitude
+    equal_power,        // constant power, for uncorrelated material
+    dj,                 // next track up to full level first, then cut
+};
+
+// Controls how the player moves from one track to the next.
+struct transition_policy
+{
+    // Length of the crossfade; zero plays the tracks back to back.
+    std::chrono::milliseconds duration{0};
+    audio::transition_curve curve{audio::transition_curve::equal_power};
+
+    // Skips silence at the start of each track, and silence that runs to
+    // the end of a track from within its last few seconds.
+    bool trim_silence{false};
+};
+
+// Anything quieter than this (-60 dBFS) counts as silence. Trailing silence
+// is only looked for within the last `silence_window` of a track.
+constexpr float silence_threshold = 1e-3f;
+constexpr std::chrono::seconds silence_window{5};
+
+// Returns the number of whole frames at the start of `x` that are silent.
+std::size_t leading_silence(audio::packet const& x) noexcept;
+
+
+// -- Overview --
+//
+// Holds back silent packets near the end of a track, since only what comes
+// after them tells trailing silence from a pause. If the track ends first,
+// the caller drops them with clear(); if more audio follows, they are let
+// through ahead of it.
+
+class trailing_silence
+{
+public:
+    // Takes the next packet of filtered audio. A silent one is held back,
+    // leaving `pkt` empty; otherwise, whatever was held back is put in front
+    // of it. Once more than `max_frames` frames are held, the silence is too
+    // long to be trailing, and is let through.
+    void process(audio::packet& pkt, std::size_t max_frames);
+
+    void clear() noexcept
+    { held_.clear(); }
+
+    bool holding() const noexcept
+    { return !held_.empty(); }
+
+    void swap(trailing_silence& x) noexcept
+    { held_.swap(x.held_); }
+
+private:
+    audio::packet held_;
+};
+
+
+// -- Overview --
+//
+// Mixes the tail of the outgoing track into the start of the next one on the
+// decoder thread. The caller keeps reading the outgoing source through its
+// own filter chain, which the transition holds on to, and pushes that audio
+// as needed; mix() then fades it out of each packet of the incoming track.
+
+class transition
+{
+public:
+    // Fades out the audio produced by `chain` over `frames` output frames.
+    // `gain` scales it relative to the incoming track's replay gain, which
+    // is applied to the mixed audio further downstream.
+    void start(audio::transition_policy const&, uint64 frames, float gain,
+               std::unique_ptr<audio::filter_chain> chain) noexcept;
+
+    // Ends the transition, returning the outgoing filter chain.
+    std::unique_ptr<audio::filter_chain> finish() noexcept;
+
+    bool active() const noexcept
+    { return (chain_ != nullptr); }
+
+    // True once the full length of the transition has been mixed.
+    bool done() const noexcept
+    { return (elapsed_ >= length_); }
+
+    audio::filter_chain& chain() const noexcept
+    { return *chain_; }
+
+    // True if less than `frames` frames of outgoing audio are buffered, and
+    // the outgoing track has not ended yet.
+    bool starved(std::size_t const frames) const noexcept
+    { return !ended_ && (buffer_.frames() < frames); }
+
+    // Appends filtered audio of the outgoing track; an empty packet marks
+    // its end, after which it is mixed in as silence.
+    void push(audio::packet const&);
+
+    // Fades `pkt`, the next audio of the incoming track, in and mixes the
+    // outgoing audio into it, fading it out.
+    void mix(audio::packet& pkt);
+
+private:
+    std::unique_ptr<audio::filter_chain> chain_;
+    audio::packet buffer_;
+    std::vector<float> gains_;
+    uint64 elapsed_{};
+    uint64 length_{};
+    float gain_{1.f};
+    audio::transition_curve curve_{};
+    bool ended_{};
+};
+
+}}    // namespace amp::audio
+
+
+#endif  // AMP_INCLUDED_6C0A0FE1_6A34_4EE2_9A7D_C55B511A77E0
@@ -0,0 +1,130 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// core/allocation_guard.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include "core/allocation_guard.hpp"
+
+#if defined(AMP_CHECK_ALLOCATIONS)
+
+#include <amp/stddef.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+
+namespace amp {
+namespace allocation_guard {
+namespace {
+
+thread_local uint32 depth;
+
+void abort_on_allocation(std::size_t const bytes) noexcept
+{
+    std::fprintf(stderr, "amp: %zu byte allocation in a guarded region\n",
+                 bytes);
+    std::abort();
+}
+
+std::atomic<handler> current_handler{&abort_on_allocation};
+
+}     // namespace <unnamed>
+
+
+void enter() noexcept
+{
+    ++depth;
+}
+
+void leave() noexcept
+{
+    --depth;
+}
+
+uint32 exchange_depth(uint32 const x) noexcept
+{
+    return std::exchange(depth, x);
+}
+
+handler set_handler(handler const x) noexcept
+{
+    return current_handler.exchange(x != nullptr ? x : &abort_on_allocation);
+}
+
+namespace {
+
+void* allocate(std::size_t bytes)
+{
+    if (AMP_UNLIKELY(depth != 0)) {
+        // The handler itself may allocate (to report the error, etc).
+        suspend const unguarded;
+        current_handler.load(std::memory_order_relaxed)(bytes);
+    }
+
+    bytes = (bytes != 0) ? bytes : 1;
+    for (;;) {
+        if (auto const p = std::malloc(bytes)) {
+            return p;
+        }
+        if (auto const f = std::get_new_handler()) {
+            f();
+        }
+        else {
+            throw std::bad_alloc{};
+        }
+    }
+}
+
+void* allocate(std::size_t const bytes, std::nothrow_t const&) noexcept
+{
+    try {
+        return allocate(bytes);
+    }
+    catch (...) {
+        return nullptr;
+    }
+}
+
+}     // namespace <unnamed>
+}}    // namespace amp::allocation_guard
+
+
+// Over-aligned allocations keep using the default implementation.
+
+void* operator new(std::size_t const n)
+{ return amp::allocation_guard::allocate(n); }
+
+void* operator new[](std::size_t const n)
+{ return amp::allocation_guard::allocate(n); }
+
+void* operator new(std::size_t const n, std::nothrow_t const& t) noexcept
+{ return amp::allocation_guard::allocate(n, t); }
+
+void* operator new[](std::size_t const n, std::nothrow_t const& t) noexcept
+{ return amp::allocation_guard::allocate(n, t); }
+
+void operator delete(void* const p) noexcept
+{ std::free(p); }
+
+void operator delete[](void* const p) noexcept
+{ std::free(p); }
+
+void operator delete(void* const p, std::size_t) noexcept
+{ std::free(p); }
+
+void operator delete[](void* const p, std::size_t) noexcept
+{ std::free(p); }
+
+void operator delete(void* const p, std::nothrow_t const&) noexcept
+{ std::free(p); }
+
+void operator delete[](void* const p, std::nothrow_t const&) noexcept
+{ std::free(p); }
+
+#endif  // AMP_CHECK_ALLOCATIONS
@@ -0,0 +1,93 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// core/allocation_guard.hpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef AMP_INCLUDED_9B5C8054_D7D4_401E_83B2_381084D04D5B
+#define AMP_INCLUDED_9B5C8054_D7D4_401E_83B2_381084D04D5B
+
+
+#include <amp/stddef.hpp>
+
+#include <cstddef>
+
+
+namespace amp {
+namespace allocation_guard {
+
+// -- Overview --
+//
+// Marks regions of code that must not touch the heap, such as the player
+// thread's steady-state loop. Builds with AMP_CHECK_ALLOCATIONS defined
+// replace the global operator new, and call the installed handler whenever
+// a thread allocates while it is inside a `scope` (and not inside a nested
+// `suspend`). The default handler reports the allocation and aborts. In all
+// other builds, the guards compile to nothing.
+//
+// Only allocations made through operator new are seen; audio::packet_buffer
+// and the standard containers use it, but third-party libraries that call
+// malloc directly are not checked.
+
+using handler = void (*)(std::size_t bytes) noexcept;
+
+#if defined(AMP_CHECK_ALLOCATIONS)
+
+constexpr bool enabled = true;
+
+void enter() noexcept;
+void leave() noexcept;
+uint32 exchange_depth(uint32) noexcept;
+handler set_handler(handler) noexcept;
+
+#else
+
+constexpr bool enabled = false;
+
+AMP_INLINE void enter() noexcept {}
+AMP_INLINE void leave() noexcept {}
+AMP_INLINE uint32 exchange_depth(uint32) noexcept { return 0; }
+AMP_INLINE handler set_handler(handler) noexcept { return nullptr; }
+
+#endif
+
+
+class scope
+{
+public:
+    scope() noexcept
+    { allocation_guard::enter(); }
+
+    ~scope()
+    { allocation_guard::leave(); }
+
+    scope(scope const&) = delete;
+    scope& operator=(scope const&) = delete;
+};
+
+
+// Lifts the current thread's guard for code that is known to allocate, and
+// is not part of the steady state (reconfiguring the output, notifying the
+// UI, etc).
+class suspend
+{
+public:
+    suspend() noexcept :
+        depth_{allocation_guard::exchange_depth(0)}
+    {}
+
+    ~suspend()
+    { allocation_guard::exchange_depth(depth_); }
+
+    suspend(suspend const&) = delete;
+    suspend& operator=(suspend const&) = delete;
+
+private:
+    uint32 depth_;
+};
+
+}}    // namespace amp::allocation_guard
+
+
+#endif  // AMP_INCLUDED_9B5C8054_D7D4_401E_83B2_381084D04D5B
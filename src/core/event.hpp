@@ -14,22 +14,38 @@
 
 #include <atomic>
 
-#include <mach/mach_init.h>
-#include <mach/mach_traps.h>
-#include <mach/semaphore.h>
-#include <mach/task.h>
+#if defined(__APPLE__) && defined(__MACH__)
+# include <mach/mach_init.h>
+# include <mach/mach_traps.h>
+# include <mach/semaphore.h>
+# include <mach/task.h>
+#elif defined(__linux__)
+# include <cerrno>
+# include <climits>
+# include <linux/futex.h>
+# include <semaphore.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+#elif defined(AMP_HAS_POSIX)
+# include <cerrno>
+# include <semaphore.h>
+#else
+# error "semaphore not implemented on this platform"
+#endif
 
 
 namespace amp {
 namespace aux {
 
-class semaphore
+#if defined(__APPLE__) && defined(__MACH__)
+
+class mach_semaphore
 {
 public:
-    semaphore(semaphore const&) = delete;
-    semaphore& operator=(semaphore const&) = delete;
+    mach_semaphore(mach_semaphore const&) = delete;
+    mach_semaphore& operator=(mach_semaphore const&) = delete;
 
-    explicit semaphore(int const init = 0)
+    explicit mach_semaphore(int const init = 0)
     {
         auto const ret = ::semaphore_create(mach_task_self(), &sem_,
                                             SYNC_POLICY_FIFO, init);
@@ -38,7 +54,7 @@ public:
         }
     }
 
-    ~semaphore()
+    ~mach_semaphore()
     {
         ::semaphore_destroy(mach_task_self(), sem_);
     }
@@ -61,13 +77,113 @@ private:
     ::semaphore_t sem_;
 };
 
+using semaphore = mach_semaphore;
+
+#else   // __APPLE__ && __MACH__
+
+class posix_semaphore
+{
+public:
+    posix_semaphore(posix_semaphore const&) = delete;
+    posix_semaphore& operator=(posix_semaphore const&) = delete;
+
+    explicit posix_semaphore(int const init = 0)
+    {
+        if (AMP_UNLIKELY(::sem_init(&sem_, 0, static_cast<unsigned>(init)))) {
+            raise_bad_alloc();
+        }
+    }
+
+    ~posix_semaphore()
+    {
+        ::sem_destroy(&sem_);
+    }
+
+    void wait()
+    {
+        while (AMP_UNLIKELY(::sem_wait(&sem_) != 0)) {
+            AMP_ASSERT(errno == EINTR);
+        }
+    }
+
+    void post()
+    {
+        auto const ret = ::sem_post(&sem_);
+        AMP_ASSERT(ret == 0);
+        (void)ret;
+    }
+
+private:
+    ::sem_t sem_;
+};
+
+#if defined(__linux__)
+
+// A counting semaphore built directly on a futex word. Unlike sem_t, it never
+// leaves user space when the count is positive, and a blocked waiter is woken
+// with a single FUTEX_WAKE system call.
+class futex_semaphore
+{
+public:
+    futex_semaphore(futex_semaphore const&) = delete;
+    futex_semaphore& operator=(futex_semaphore const&) = delete;
+
+    explicit futex_semaphore(int const init = 0) noexcept :
+        count_{init}
+    {}
+
+    void wait() noexcept
+    {
+        for (;;) {
+            auto count = count_.load(std::memory_order_relaxed);
+            while (count > 0) {
+                if (count_.compare_exchange_weak(count, count - 1,
+                                                 std::memory_order_acquire,
+                                                 std::memory_order_relaxed)) {
+                    return;
+                }
+            }
+            futex_(FUTEX_WAIT_PRIVATE, 0);
+        }
+    }
+
+    void post() noexcept
+    {
+        count_.fetch_add(1, std::memory_order_release);
+        futex_(FUTEX_WAKE_PRIVATE, 1);
+    }
+
+private:
+    static_assert(sizeof(std::atomic<int>) == sizeof(int), "");
+
+    void futex_(int const op, int const val) noexcept
+    {
+        // EAGAIN (the count changed before we slept) and EINTR both just
+        // mean that the caller has to look at the count again.
+        ::syscall(SYS_futex, reinterpret_cast<int*>(&count_), op, val,
+                  nullptr, nullptr, 0);
+    }
+
+    std::atomic<int> count_;
+};
+
+using semaphore = futex_semaphore;
+
+#else   // __linux__
+
+using semaphore = posix_semaphore;
+
+#endif  // __linux__
+#endif  // __APPLE__ && __MACH__
+
 }     // namespace aux
 
 
-class auto_reset_event
+template<typename Semaphore>
+class basic_auto_reset_event
 {
 public:
-    explicit auto_reset_event(int const init = 0) :
+    explicit basic_auto_reset_event(int const init = 0) :
         status_{init}
     {}
 
@@ -93,12 +209,13 @@ public:
     }
 
 private:
-    aux::semaphore sem_;
+    Semaphore sem_;
     std::atomic<int> status_;
 };
 
+using auto_reset_event = basic_auto_reset_event<aux::semaphore>;
+
 }     // namespace amp
 
 
 #endif  // AMP_INCLUDED_3870888E_1AA8_425C_BA52_53A71BD673A4
-
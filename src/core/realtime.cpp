@@ -0,0 +1,147 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// core/realtime.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/stddef.hpp>
+
+#include "core/realtime.hpp"
+
+#include <algorithm>
+#include <cstddef>
+
+#if defined(__APPLE__) && defined(__MACH__)
+# include <mach/mach_init.h>
+# include <mach/mach_time.h>
+# include <mach/thread_act.h>
+# include <mach/thread_policy.h>
+# include <sys/mman.h>
+#elif defined(AMP_HAS_POSIX)
+# include <pthread.h>
+# include <sched.h>
+# include <sys/mman.h>
+# include <sys/resource.h>
+# include <unistd.h>
+# if defined(__linux__)
+#  include <sys/syscall.h>
+# endif
+#endif
+
+
+namespace amp {
+namespace realtime {
+
+#if defined(__APPLE__) && defined(__MACH__)
+
+result promote_current_thread(int32, uint64 const period_ns) noexcept
+{
+    ::mach_timebase_info_data_t tb;
+    if (::mach_timebase_info(&tb) != KERN_SUCCESS) {
+        return result::failed;
+    }
+
+    auto const to_abs = [&](uint64 const ns) {
+        return static_cast<uint32>(ns * tb.denom / tb.numer);
+    };
+
+    // Ask for up to a quarter of each period, to be completed within half.
+    ::thread_time_constraint_policy_data_t policy;
+    policy.period      = to_abs(period_ns);
+    policy.computation = to_abs(period_ns / 4);
+    policy.constraint  = to_abs(period_ns / 2);
+    policy.preemptible = true;
+
+    auto const ret = ::thread_policy_set(
+        ::mach_thread_self(),
+        THREAD_TIME_CONSTRAINT_POLICY,
+        reinterpret_cast<::thread_policy_t>(&policy),
+        THREAD_TIME_CONSTRAINT_POLICY_COUNT);
+    return (ret == KERN_SUCCESS) ? result::succeeded : result::failed;
+}
+
+result pin_current_thread(uint64 const mask) noexcept
+{
+    // Mach only supports affinity tags, which are hints, not CPU sets.
+    return (mask != 0) ? result::failed : result::not_requested;
+}
+
+#elif defined(AMP_HAS_POSIX)
+
+result promote_current_thread(int32 const priority, uint64) noexcept
+{
+    auto const self = ::pthread_self();
+
+    auto try_policy = [&](int const policy, int const max_priority) {
+        ::sched_param param{};
+        // Clamping to `max_priority` last keeps the bounds of std::clamp in
+        // order; a priority the policy does not allow is then refused.
+        param.sched_priority = std::min(
+            std::clamp(priority, ::sched_get_priority_min(policy),
+                                 ::sched_get_priority_max(policy)),
+            max_priority);
+        return ::pthread_setschedparam(self, policy, &param) == 0;
+    };
+
+    if (try_policy(SCHED_FIFO, priority) || try_policy(SCHED_RR, priority)) {
+        return result::succeeded;
+    }
+
+#if defined(__linux__)
+    // Unprivileged processes may raise their soft limit up to the hard one.
+    ::rlimit limit;
+    if (::getrlimit(RLIMIT_RTPRIO, &limit) == 0 && limit.rlim_max != 0) {
+        limit.rlim_cur = limit.rlim_max;
+        if (::setrlimit(RLIMIT_RTPRIO, &limit) == 0) {
+            auto const max_priority = static_cast<int>(
+                std::min<::rlim_t>(limit.rlim_max, 99));
+            if (try_policy(SCHED_FIFO, max_priority) ||
+                try_policy(SCHED_RR, max_priority)) {
+                return result::succeeded;
+            }
+        }
+    }
+
+    // Nice values are per thread on Linux; take whatever RLIMIT_NICE allows.
+    auto const tid = static_cast<::id_t>(::syscall(SYS_gettid));
+    for (auto nice = -20; nice != 0; ++nice) {
+        if (::setpriority(PRIO_PROCESS, tid, nice) == 0) {
+            return result::degraded;
+        }
+    }
+#endif
+    return result::failed;
+}
+
+result pin_current_thread(uint64 const mask) noexcept
+{
+    if (mask == 0) {
+        return result::not_requested;
+    }
+
+#if defined(__linux__)
+    ::cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu = 0; cpu != 64; ++cpu) {
+        if (mask & (uint64{1} << cpu)) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    auto const ret = ::pthread_setaffinity_np(::pthread_self(),
+                                              sizeof(set), &set);
+    return (ret == 0) ? result::succeeded : result::failed;
+#else
+    return result::failed;
+#endif
+}
+
+#endif  // __APPLE__ && __MACH__
+
+
+bool lock_memory(void const* const p, std::size_t const n) noexcept
+{
+    return (n == 0) || (::mlock(p, n) == 0);
+}
+
+}}    // namespace amp::realtime
@@ -0,0 +1,44 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// core/realtime.hpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef AMP_INCLUDED_E4E0C004_2ADE_46B0_A67A_8F7127301BA2
+#define AMP_INCLUDED_E4E0C004_2ADE_46B0_A67A_8F7127301BA2
+
+
+#include <amp/stddef.hpp>
+
+#include <cstddef>
+
+
+namespace amp {
+namespace realtime {
+
+enum class result : uint8 {
+    not_requested,
+    succeeded,
+    degraded,
+    failed,
+};
+
+// Gives the calling thread real-time scheduling. On Linux, tries SCHED_FIFO
+// and then SCHED_RR, raising the soft RLIMIT_RTPRIO to its hard limit if
+// required (the same allowance a desktop rtkit setup grants); if neither is
+// permitted, falls back to the highest nice value available and reports
+// result::degraded. On macOS, uses a time-constraint policy with the given
+// period as a scheduling hint.
+result promote_current_thread(int32 priority, uint64 period_ns) noexcept;
+
+// Restricts the calling thread to the CPUs whose bits are set in `mask`.
+result pin_current_thread(uint64 mask) noexcept;
+
+// Locks the pages overlapping [p, p + n) into physical memory.
+bool lock_memory(void const* p, std::size_t n) noexcept;
+
+}}    // namespace amp::realtime
+
+
+#endif  // AMP_INCLUDED_E4E0C004_2ADE_46B0_A67A_8F7127301BA2
@@ -205,6 +205,18 @@ public:
         tail_ = list_tail;
     }
 
+    // Adds `n` nodes to the cache, so that the producer never allocates as
+    // long as no more than `n` elements are enqueued at any one time.
+    void reserve(size_type n)
+    {
+        while (n-- != 0) {
+            auto const x = node_alloc_traits::allocate(alloc_(), 1);
+            node_alloc_traits::construct(alloc_(), std::addressof(x->next),
+                                         cache_head_());
+            cache_head_() = x;
+        }
+    }
+
     ////////////////////////////////////////////////////////////////////////////
     // Consumer functions
     ////////////////////////////////////////////////////////////////////////////
@@ -51,7 +51,7 @@ struct playlist_header
 };
 
 
-auto pack_playlist_(std::vector<media::track> const& tracks)
+auto pack_playlist_(std::vector<media::track_handle> const& tracks)
 {
     io::buffer buf;
     auto pos = 0_sz;
@@ -71,7 +71,8 @@ auto pack_playlist_(std::vector<media::track> const& tracks)
     };
 
     write_size(tracks.size());
-    for (auto&& t : tracks) {
+    for (auto&& h : tracks) {
+        auto&& t = *h;
         write_data(t.location.data(), t.location.size());
 
         write_size(t.tags.size());
@@ -104,7 +105,7 @@ auto pack_playlist_(std::vector<media::track> const& tracks)
     return buf;
 }
 
-std::vector<media::track> unpack_playlist_(io::reader r)
+std::vector<media::track_handle> unpack_playlist_(io::reader r)
 {
     auto load_dictionary = [&](media::dictionary& d) {
         auto n = r.read<uint32,LE>();
@@ -117,8 +118,9 @@ std::vector<media::track> unpack_playlist_(io::reader r)
         }
     };
 
-    std::vector<media::track> tracks(r.read<uint32,LE>());
-    for (auto&& t : tracks) {
+    std::vector<media::track_handle> tracks(r.read<uint32,LE>());
+    for (auto&& h : tracks) {
+        media::track t;
         t.location = net::uri::from_string(r.read_pascal_string<uint32,LE>());
         load_dictionary(t.tags);
         load_dictionary(t.info);
@@ -128,12 +130,14 @@ std::vector<media::track> unpack_playlist_(io::reader r)
                      t.sample_rate,
                      t.channel_layout,
                      t.chapter);
+        h = media::track_handle{std::move(t)};
     }
     return tracks;
 }
 
 
-void save_playlist_(io::stream& file, std::vector<media::track> const& tracks)
+void save_playlist_(io::stream& file,
+                    std::vector<media::track_handle> const& tracks)
 {
     auto const buf = pack_playlist_(tracks);
     auto const decompressed_size = static_cast<uint32>(buf.size());
@@ -160,7 +164,7 @@ void save_playlist_(io::stream& file, std::vector<media::track> const& tracks)
     file.write(compressed.data(), compressed_size);
 }
 
-std::vector<media::track> load_playlist_(u8string const& path)
+std::vector<media::track_handle> load_playlist_(u8string const& path)
 {
     if (!fs::exists(path)) {
         return {};
@@ -237,8 +241,8 @@ void playlist::sort(std::string_view const key, media::sort_order const order)
     std::stable_sort(
         tracks_.begin(),
         tracks_.end(),
-        [=](media::track const& x, media::track const& y) {
-            auto const ret = tags::compare(x, y, key);
+        [=](media::track_handle const& x, media::track_handle const& y) {
+            auto const ret = tags::compare(*x, *y, key);
             return (sgn(ret) == static_cast<int>(order));
         });
 
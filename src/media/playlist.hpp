@@ -44,10 +44,10 @@ private:
     friend class amp::ref_ptr;
 
 public:
-    using iterator        = std::vector<media::track>::iterator;
-    using const_iterator  = std::vector<media::track>::const_iterator;
-    using difference_type = std::vector<media::track>::difference_type;
-    using size_type       = std::vector<media::track>::size_type;
+    using iterator        = std::vector<media::track_handle>::iterator;
+    using const_iterator  = std::vector<media::track_handle>::const_iterator;
+    using difference_type = std::vector<media::track_handle>::difference_type;
+    using size_type       = std::vector<media::track_handle>::size_type;
 
     auto empty() const noexcept { return tracks_.empty(); }
     auto size()  const noexcept { return tracks_.size(); }
@@ -97,7 +97,7 @@ public:
         unsaved_changes_ = true;
     }
 
-    void push_back(media::track&& t)
+    void push_back(media::track_handle t)
     {
         tracks_.push_back(std::move(t));
         unsaved_changes_ = true;
@@ -161,13 +161,13 @@ private:
         }
     }
 
-    u8string                    path_;
-    std::vector<media::track>   tracks_;
-    size_type                   position_;
-    uint32                      id_;
-    mutable std::atomic<uint32> ref_count_;
-    media::playback_order       gen_order_;
-    bool                        unsaved_changes_;
+    u8string                         path_;
+    std::vector<media::track_handle> tracks_;
+    size_type                        position_;
+    uint32                           id_;
+    mutable std::atomic<uint32>      ref_count_;
+    media::playback_order            gen_order_;
+    bool                             unsaved_changes_;
 };
 
 
@@ -13,9 +13,11 @@
 #include <amp/media/dictionary.hpp>
 #include <amp/net/uri.hpp>
 #include <amp/numeric.hpp>
+#include <amp/ref_ptr.hpp>
 #include <amp/stddef.hpp>
 #include <amp/u8string.hpp>
 
+#include <atomic>
 #include <chrono>
 #include <utility>
 
@@ -62,6 +64,76 @@ AMP_INLINE void swap(track& x, track& y) noexcept
     x.swap(y);
 }
 
+
+// -- Overview --
+//
+// Shared, immutable reference to a track. A track is built up as a plain
+// media::track and then frozen by moving it into a handle; from then on,
+// copying it costs a single atomic increment, however many tags it has. The
+// playlists, the player's queue, undo commands and scanner results all pass
+// tracks around this way.
+
+class track_handle :
+    private equality_comparable<track_handle>
+{
+public:
+    track_handle() noexcept = default;
+
+    explicit track_handle(media::track&& x) :
+        node_{new node_type{std::move(x)}, consume_ref}
+    {}
+
+    AMP_INLINE void swap(track_handle& x) noexcept
+    { node_.swap(x.node_); }
+
+    AMP_INLINE explicit operator bool() const noexcept
+    { return static_cast<bool>(node_); }
+
+    AMP_INLINE media::track const* get() const noexcept
+    { return node_ ? &node_->value : nullptr; }
+
+    AMP_INLINE media::track const& operator*() const noexcept
+    { return node_->value; }
+
+    AMP_INLINE media::track const* operator->() const noexcept
+    { return &node_->value; }
+
+private:
+    struct node_type
+    {
+        media::track value;
+        mutable std::atomic<uint32> ref_count{1};
+
+        void add_ref() const noexcept
+        {
+            ref_count.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void release() const noexcept
+        {
+            auto remain = ref_count.fetch_sub(1, std::memory_order_release) - 1;
+            if (!remain) {
+                std::atomic_thread_fence(std::memory_order_acquire);
+                delete this;
+            }
+        }
+    };
+
+    friend bool operator==(track_handle const& x,
+                           track_handle const& y) noexcept
+    {
+        return (x.node_ == y.node_)
+            || (x.node_ && y.node_ && (x.node_->value == y.node_->value));
+    }
+
+    ref_ptr<node_type const> node_;
+};
+
+AMP_INLINE void swap(track_handle& x, track_handle& y) noexcept
+{
+    x.swap(y);
+}
+
 }}    // namespace amp::media
 
 
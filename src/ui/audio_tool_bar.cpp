@@ -238,7 +238,7 @@ void AudioToolBar::customEvent(QEvent* const ev)
 
             Q_EMIT bitRateChanged(player.bit_rate());
             Q_EMIT positionChanged(player.position());
-            Q_EMIT playerTrackChanged(playlist->at(index));
+            Q_EMIT playerTrackChanged(*playlist->at(index));
             break;
         }
     case AudioEvent::ErrorOccurred:
@@ -312,7 +312,7 @@ void AudioToolBar::onConfigChanged()
 
     updateAvailability();
     if (!isStopped()) {
-        Q_EMIT playerTrackChanged(playlist->playing());
+        Q_EMIT playerTrackChanged(*playlist->playing());
     }
 }
 
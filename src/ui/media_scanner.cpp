@@ -147,7 +147,7 @@ void MediaScanner::loadCueSheet(net::uri const& cue_location,
         track.tags = std::move(cs[i].tags);
         track.tags.merge(info.tags);
         finalizeTrack(track, info);
-        Q_EMIT resultReady(std::move(track));
+        Q_EMIT resultReady(media::track_handle{std::move(track)});
     }
 }
 
@@ -181,12 +181,12 @@ void MediaScanner::loadTracks(net::uri const& location)
             loadCueSheet(location, std::move(text));
         }
         else {
-            Q_EMIT resultReady(std::move(track));
+            Q_EMIT resultReady(media::track_handle{std::move(track)});
         }
     }
     else {
         for (auto const index : xrange(chapter_count)) {
-            Q_EMIT resultReady(get_chapter(index + 1));
+            Q_EMIT resultReady(media::track_handle{get_chapter(index + 1)});
         }
     }
 }
@@ -26,7 +26,7 @@
 #include <QtCore/QStringList>
 
 
-Q_DECLARE_METATYPE(amp::media::track);
+Q_DECLARE_METATYPE(amp::media::track_handle);
 
 
 namespace amp {
@@ -45,7 +45,7 @@ public:
     void cancel();
 
 Q_SIGNALS:
-    void resultReady(media::track);
+    void resultReady(media::track_handle);
     void finished();
     void canceled();
 
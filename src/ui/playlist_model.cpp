@@ -150,7 +150,7 @@ bool PlaylistModel::removeRows(int const start,
         }
 
     private:
-        std::vector<media::track> tracks;
+        std::vector<media::track_handle> tracks;
         PlaylistModel& model;
         int const start;
         int const stop;
@@ -162,13 +162,25 @@ bool PlaylistModel::removeRows(int const start,
 
 QModelIndex PlaylistModel::index(media::track const& x) const
 {
-    auto const row = static_cast<int>(&x - &(*playlist->cbegin()));
-    return QAbstractTableModel::index(row, 0);
+    // Tracks are shared between playlists, the player and the undo stack,
+    // so `x` is looked up by address. It is nearly always the one playing.
+    auto const first = playlist->cbegin();
+    auto const last = playlist->cend();
+    auto pos = first + as_signed(playlist->position());
+    if (pos == last || pos->get() != &x) {
+        pos = std::find_if(first, last, [&](auto&& t) {
+            return t.get() == &x;
+        });
+        if (pos == last) {
+            return QModelIndex{};
+        }
+    }
+    return QAbstractTableModel::index(static_cast<int>(pos - first), 0);
 }
 
 media::track const& PlaylistModel::track(QModelIndex const& index) const
 {
-    return playlist->at(static_cast<std::size_t>(index.row()));
+    return *playlist->at(static_cast<std::size_t>(index.row()));
 }
 
 QModelIndex PlaylistModel::currentIndex() const
@@ -218,7 +230,7 @@ void PlaylistModel::launchScannerTask(std::vector<net::uri> uris,
 
     scanner = new MediaScanner(this);
     connect(scanner, &MediaScanner::resultReady,
-            this, [this](media::track x) {
+            this, [this](media::track_handle x) {
                 {
                     auto const start = rowCount();
                     beginInsertRows(QModelIndex(), start, start + 1);
@@ -0,0 +1,145 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// tests/allocation_guard_test.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/format.hpp>
+#include <amp/audio/packet.hpp>
+#include <amp/range.hpp>
+#include <amp/stddef.hpp>
+
+#include "audio/circular_buffer.hpp"
+#include "audio/packet_queue.hpp"
+#include "core/allocation_guard.hpp"
+#include "core/spsc_queue.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+
+using namespace ::amp;
+
+
+namespace {
+
+std::atomic<std::size_t> violations;
+
+void count_allocation(std::size_t) noexcept
+{
+    violations.fetch_add(1, std::memory_order_relaxed);
+}
+
+class counting_handler
+{
+public:
+    counting_handler() noexcept :
+        previous_{allocation_guard::set_handler(&count_allocation)}
+    {
+        violations.store(0);
+    }
+
+    ~counting_handler()
+    { allocation_guard::set_handler(previous_); }
+
+private:
+    allocation_guard::handler previous_;
+};
+
+void allocate_and_free()
+{
+    ::operator delete(::operator new(16));
+}
+
+}     // namespace <unnamed>
+
+
+TEST(allocation_guard, scope)
+{
+    ASSERT_TRUE(allocation_guard::enabled);
+    counting_handler const handler;
+
+    allocate_and_free();
+    ASSERT_EQ(violations.load(), 0);
+    {
+        allocation_guard::scope const guard;
+        allocate_and_free();
+        ASSERT_EQ(violations.load(), 1);
+        {
+            allocation_guard::suspend const unguarded;
+            allocate_and_free();
+        }
+        ASSERT_EQ(violations.load(), 1);
+
+        audio::packet pkt;
+        pkt.resize(64);
+        ASSERT_EQ(violations.load(), 2);
+    }
+    allocate_and_free();
+    ASSERT_EQ(violations.load(), 2);
+}
+
+TEST(allocation_guard, packet_growth)
+{
+    audio::packet pkt;
+    pkt.reserve(100);
+    ASSERT_EQ(pkt.capacity(), 100);
+    pkt.resize(101);
+    ASSERT_EQ(pkt.capacity(), 150);
+
+    counting_handler const handler;
+    allocation_guard::scope const guard;
+    for (auto const i : xrange(1000)) {
+        pkt.resize(50 + i % 100, uninitialized);
+        pkt.clear();
+    }
+    ASSERT_EQ(violations.load(), 0);
+}
+
+// Runs the decoder and player threads' halves of the packet pipeline in
+// lockstep, with packets of varying sizes, once the pools have been sized.
+TEST(allocation_guard, steady_state)
+{
+    constexpr auto max_frames = 1024_sz;
+
+    audio::packet_queue queue{8};
+    queue.reserve(max_frames * 2);
+
+    spsc::queue<uint64> events;
+    events.reserve(4);
+
+    audio::circular_buffer<float> ring{max_frames * 2};
+    std::vector<float> const source(max_frames * 2, .5f);
+
+    counting_handler const handler;
+    allocation_guard::scope const guard;
+
+    for (auto const i : xrange(uint64{10000})) {
+        while (auto const slot = queue.write_prepare(-1_sz)) {
+            auto const frames = 256 + (i * 37) % (max_frames - 256);
+            slot->pkt.set_channel_layout(audio::channel_layout_stereo, 2);
+            slot->pkt.assign(source.data(), frames * 2);
+            slot->position = i;
+            queue.write_commit();
+        }
+
+        while (auto const slot = queue.read_acquire()) {
+            auto const n = std::min(slot->pkt.size(), ring.write_prepare());
+            std::copy_n(slot->pkt.data(), n, ring.write_cursor());
+            ring.write_commit(n);
+            ring.read_flush();
+            queue.read_release();
+        }
+
+        events.emplace(i);
+        events.emplace(i);
+        events.for_each([](uint64) noexcept {});
+    }
+    ASSERT_EQ(violations.load(), 0);
+}
@@ -0,0 +1,150 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// tests/audio_channel_mixer_test.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/format.hpp>
+#include <amp/audio/packet.hpp>
+#include <amp/numeric.hpp>
+#include <amp/range.hpp>
+#include <amp/stddef.hpp>
+
+#include "audio/channel_mixer.hpp"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+
+using namespace ::amp;
+
+
+namespace {
+
+// Mixes an odd number of frames with the kernel chosen for the layouts, and
+// with the generic one, which must agree.
+void check_kernel(uint32 const src_layout, uint32 const dst_layout)
+{
+    audio::mix_plan plan;
+    audio::build_plan(src_layout, dst_layout, plan);
+
+    auto const frames = 37_sz;
+    std::vector<float> src(frames * plan.src_channels);
+    for (auto const i : xrange(src.size())) {
+        src[i] = static_cast<float>((i * 7919) % 211) / 105.f - 1.f;
+    }
+
+    std::vector<float> expected(frames * plan.dst_channels);
+    std::vector<float> actual(expected.size());
+    audio::mix_sparse(src.data(), expected.data(), frames, plan);
+    audio::select_kernel(plan)(src.data(), actual.data(), frames, plan);
+
+    for (auto const i : xrange(expected.size())) {
+        ASSERT_NEAR(actual[i], expected[i], 1e-6f) << "at sample " << i;
+    }
+}
+
+}     // namespace <unnamed>
+
+
+TEST(audio_channel_mixer, mono_to_stereo)
+{
+    check_kernel(audio::channel_layout_mono, audio::channel_layout_stereo);
+
+    audio::format src{};
+    src.sample_rate = 44100;
+    src.channels = 1;
+    src.channel_layout = audio::channel_layout_mono;
+
+    audio::format dst = src;
+    dst.channels = 2;
+    dst.channel_layout = audio::channel_layout_stereo;
+
+    auto mixer = audio::channel_mixer::make(src, dst);
+    ASSERT_EQ(src.channels, 2);
+
+    audio::packet pkt;
+    pkt.set_channel_layout(audio::channel_layout_mono, 1);
+    pkt.resize(5);
+    for (auto const i : xrange(pkt.size())) {
+        pkt[i] = static_cast<float>(i) / 4;
+    }
+
+    mixer->process(pkt);
+    ASSERT_EQ(pkt.channels(), 2);
+    ASSERT_EQ(pkt.frames(), 5);
+    for (auto const i : xrange(pkt.frames())) {
+        auto const x = static_cast<float>(i) / 4 * sqrt1_2<float>;
+        ASSERT_FLOAT_EQ(pkt[i * 2 + 0], x);
+        ASSERT_FLOAT_EQ(pkt[i * 2 + 1], x);
+    }
+}
+
+TEST(audio_channel_mixer, stereo_to_5_1)
+{
+    check_kernel(audio::channel_layout_stereo, audio::channel_layout_5_1);
+    check_kernel(audio::channel_layout_stereo, audio::channel_layout_5_1_side);
+}
+
+TEST(audio_channel_mixer, surround_to_stereo)
+{
+    check_kernel(audio::channel_layout_5_1, audio::channel_layout_stereo);
+    check_kernel(audio::channel_layout_5_1_side, audio::channel_layout_stereo);
+    check_kernel(audio::channel_layout_7_1, audio::channel_layout_stereo);
+}
+
+TEST(audio_channel_mixer, sparse)
+{
+    // Downmixing to stereo leaves the LFE out altogether.
+    audio::mix_plan plan;
+    audio::build_plan(audio::channel_layout_5_1, audio::channel_layout_stereo,
+                      plan);
+    ASSERT_EQ(plan.src_channels, 6);
+    ASSERT_EQ(plan.dst_channels, 2);
+    ASSERT_EQ(plan.columns & (1 << 3), 0);
+    ASSERT_EQ(plan.rows[0].count, 3);
+    ASSERT_EQ(plan.rows[1].count, 3);
+
+    check_kernel(audio::channel_layout_7_1, audio::channel_layout_5_1);
+}
+
+TEST(audio_channel_mixer, compose)
+{
+    // A channel swap followed by an upmix is one upmix, with the fronts
+    // swapped.
+    float const swap[2][2] {
+        { 0.f, 1.f },
+        { 1.f, 0.f },
+    };
+    audio::mix_plan first, second, fused;
+    audio::build_plan(audio::frame_matrix{2, 2, &swap[0][0], 2}, first);
+    audio::build_plan(audio::channel_layout_stereo, audio::channel_layout_5_1,
+                      second);
+    audio::compose_plan(first, second, fused);
+    ASSERT_EQ(fused.src_channels, 2);
+    ASSERT_EQ(fused.dst_channels, 6);
+
+    auto const frames = 37_sz;
+    std::vector<float> src(frames * 2);
+    for (auto const i : xrange(src.size())) {
+        src[i] = static_cast<float>((i * 7919) % 211) / 105.f - 1.f;
+    }
+
+    std::vector<float> tmp(src.size());
+    std::vector<float> expected(frames * 6);
+    std::vector<float> actual(expected.size());
+    audio::mix_sparse(src.data(), tmp.data(), frames, first);
+    audio::mix_sparse(tmp.data(), expected.data(), frames, second);
+    audio::select_kernel(fused)(src.data(), actual.data(), frames, fused);
+
+    for (auto const i : xrange(expected.size())) {
+        ASSERT_NEAR(actual[i], expected[i], 1e-6f) << "at sample " << i;
+    }
+
+    // Swapping twice does nothing at all.
+    audio::compose_plan(first, first, fused);
+    ASSERT_TRUE(audio::is_identity(fused));
+    ASSERT_FALSE(audio::is_identity(first));
+}
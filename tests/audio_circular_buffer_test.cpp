@@ -0,0 +1,108 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// tests/audio_circular_buffer_test.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/range.hpp>
+#include <amp/stddef.hpp>
+
+#include "audio/circular_buffer.hpp"
+
+#include <cstddef>
+
+#include <gtest/gtest.h>
+
+
+using namespace ::amp;
+
+
+TEST(audio_circular_buffer, capacity)
+{
+    audio::circular_buffer<float> x{1};
+    auto const page = audio::aux::mirror_granularity() / sizeof(float);
+
+    ASSERT_EQ(x.capacity(), page);
+    ASSERT_EQ(x.read_avail(), 0);
+    ASSERT_EQ(x.write_avail(), x.capacity());
+
+    audio::circular_buffer<float> y{page * 3};
+    ASSERT_EQ(y.capacity(), page * 4);
+}
+
+TEST(audio_circular_buffer, mirrored)
+{
+    audio::circular_buffer<int32> x{1};
+    auto const n = x.capacity();
+    auto const p = x.write_cursor();
+
+    for (auto const i : xrange(n)) {
+        p[i] = static_cast<int32>(i);
+    }
+    for (auto const i : xrange(n)) {
+        ASSERT_EQ(p[n + i], static_cast<int32>(i));
+    }
+
+    p[n + 1] = -1;
+    ASSERT_EQ(p[1], -1);
+}
+
+TEST(audio_circular_buffer, wrap_around)
+{
+    audio::circular_buffer<int32> x{1};
+    auto const n = x.capacity();
+
+    // Move the head and tail close to the end of the buffer.
+    x.write_commit(n - 3);
+    x.read_release(n - 3);
+    ASSERT_EQ(x.read_acquire(), 0);
+
+    // A write that straddles the end must be contiguous from the cursor.
+    ASSERT_EQ(x.write_prepare(), n);
+    auto const w = x.write_cursor();
+    for (auto const i : xrange(8)) {
+        w[i] = static_cast<int32>(100 + i);
+    }
+    x.write_commit(8);
+
+    ASSERT_EQ(x.read_acquire(), 8);
+    auto const r = x.read_cursor();
+    for (auto const i : xrange(8)) {
+        ASSERT_EQ(r[i], static_cast<int32>(100 + i));
+    }
+    x.read_release(8);
+
+    // The cursors have wrapped around to the start of the buffer.
+    ASSERT_EQ(x.read_cursor(), x.write_cursor());
+    ASSERT_EQ(x.write_cursor() - w, static_cast<std::ptrdiff_t>(8 - n));
+}
+
+TEST(audio_circular_buffer, flags)
+{
+    auto const flags = audio::mirror_hugepages | audio::mirror_locked;
+    audio::circular_buffer<float> x{1 << 20, flags};
+    ASSERT_EQ(x.capacity(), 1 << 20);
+
+    auto const p = x.write_cursor();
+    p[0] = 1.f;
+    ASSERT_EQ(p[x.capacity()], 1.f);
+}
+
+TEST(audio_circular_buffer, swap)
+{
+    audio::circular_buffer<int32> x{1};
+    audio::circular_buffer<int32> y{x.capacity() * 2};
+    auto const xp = x.write_cursor();
+    auto const yp = y.write_cursor();
+
+    xp[0] = 42;
+    x.write_commit(1);
+    x.swap(y);
+
+    ASSERT_EQ(x.read_avail(), 0);
+    ASSERT_EQ(y.read_avail(), 1);
+    ASSERT_EQ(x.write_cursor(), yp);
+    ASSERT_EQ(y.read_cursor(), xp);
+    ASSERT_EQ(*y.read_cursor(), 42);
+}
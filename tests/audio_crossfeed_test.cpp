@@ -0,0 +1,163 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// tests/audio_crossfeed_test.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/utility.hpp>
+#include <amp/numeric.hpp>
+#include <amp/range.hpp>
+#include <amp/stddef.hpp>
+
+#include "filter/crossfeed_kernel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+
+using namespace ::amp;
+
+
+namespace {
+
+using isa = audio::crossfeed_kernel::isa;
+
+constexpr uint32 rate = 44100;
+constexpr auto frames = 8192_sz;
+
+// Single precision, with the gain folded into the coefficients, strays up to
+// about 2.7e-7 from the double-precision loop on these signals.
+constexpr float tolerance = 3e-7f;
+
+// The crossfeed as it was: one frame at a time, in double precision, with a
+// 700 Hz cutoff and a 4.5 dB feed.
+class scalar_crossfeed
+{
+public:
+    scalar_crossfeed()
+    {
+        auto const level = 4.5;
+        auto const GB_lo = level * -5.0 / 6.0 - 3.0;
+        auto const GB_hi = level        / 6.0 - 3.0;
+        auto const G_lo  =       audio::to_amplitude(GB_lo);
+        auto const G_hi  = 1.0 - audio::to_amplitude(GB_hi);
+        auto const Fc_lo = 700.0;
+        auto const Fc_hi = Fc_lo * std::exp2((GB_lo - audio::to_decibels(G_hi))
+                                             / 12.0);
+        auto const x_lo = std::exp(-2.0 * pi<double> * Fc_lo / rate);
+        auto const x_hi = std::exp(-2.0 * pi<double> * Fc_hi / rate);
+
+        a0_lo = G_lo * (1.0 - x_lo);
+        b1_lo = x_lo;
+        a0_hi = 1.0 - G_hi * (1.0 - x_hi);
+        b1_hi = x_hi;
+        gain  = 1.0 / (1.0 - G_hi + G_lo);
+    }
+
+    void process(float* const p, std::size_t const n) noexcept
+    {
+        for (auto i = 0_sz; i != n * 2; i += 2) {
+            auto const L = static_cast<double>(p[i]);
+            auto const R = static_cast<double>(p[i + 1]);
+
+            lo[0] = (a0_lo * L) + (b1_lo * lo[0]);
+            lo[1] = (a0_lo * R) + (b1_lo * lo[1]);
+            hi[0] = (a0_hi * L) + (b1_hi * hi[0]) - (b1_hi * asis[0]);
+            hi[1] = (a0_hi * R) + (b1_hi * hi[1]) - (b1_hi * asis[1]);
+            asis[0] = L;
+            asis[1] = R;
+
+            p[i+0] = static_cast<float>((hi[0] + lo[1]) * gain);
+            p[i+1] = static_cast<float>((hi[1] + lo[0]) * gain);
+        }
+    }
+
+private:
+    double a0_lo, b1_lo, a0_hi, b1_hi, gain;
+    std::array<double, 2> asis{}, lo{}, hi{};
+};
+
+// Two unrelated tones, one per side, so that the crossfeed has something to
+// mix.
+std::vector<float> make_signal()
+{
+    std::vector<float> x(frames * 2);
+    for (auto const t : xrange(frames)) {
+        x[t * 2 + 0] = std::sin(static_cast<float>(t) * .0331f) * .5f;
+        x[t * 2 + 1] = std::sin(static_cast<float>(t) * .0047f) * .4f;
+    }
+    return x;
+}
+
+std::vector<float> run_scalar()
+{
+    auto x = make_signal();
+    scalar_crossfeed xf;
+    xf.process(x.data(), frames);
+    return x;
+}
+
+// Filters the signal in packets of `packet` frames.
+std::vector<float> run(audio::crossfeed_kernel& xf, std::size_t const packet)
+{
+    auto x = make_signal();
+    for (auto i = 0_sz; i < frames; i += packet) {
+        xf.process(&x[i * 2], std::min(frames - i, packet));
+    }
+    return x;
+}
+
+}     // namespace <unnamed>
+
+
+TEST(audio_crossfeed, matches_scalar)
+{
+    auto const expected = run_scalar();
+
+    for (auto const k : {isa::generic, isa::sse2, isa::avx2}) {
+        audio::crossfeed_kernel xf;
+        if (!xf.select(k)) {
+            break;      // nor any wider kernel
+        }
+
+        for (auto const packet : {1_sz, 3_sz, 4_sz, 5_sz, 4099_sz}) {
+            xf.calibrate(rate, 700, 45);
+            xf.select(k);
+
+            auto const actual = run(xf, packet);
+            for (auto const i : xrange(actual.size())) {
+                ASSERT_NEAR(actual[i], expected[i], tolerance)
+                    << "kernel " << static_cast<int>(k)
+                    << ", packets of " << packet << ", sample " << i;
+            }
+        }
+    }
+}
+
+TEST(audio_crossfeed, flush)
+{
+    auto const expected = run_scalar();
+
+    for (auto const k : {isa::generic, isa::sse2, isa::avx2}) {
+        audio::crossfeed_kernel xf;
+        xf.calibrate(rate, 700, 45);
+        if (!xf.select(k)) {
+            break;
+        }
+
+        // After a flush, the filters start from rest again.
+        run(xf, 5);
+        xf.flush();
+        auto const actual = run(xf, 5);
+        for (auto const i : xrange(actual.size())) {
+            ASSERT_NEAR(actual[i], expected[i], tolerance)
+                << "kernel " << static_cast<int>(k) << ", sample " << i;
+        }
+    }
+}
@@ -0,0 +1,122 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// tests/audio_equalizer_test.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/numeric.hpp>
+#include <amp/range.hpp>
+#include <amp/stddef.hpp>
+
+#include "filter/equalizer.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+
+using namespace ::amp;
+
+
+namespace {
+
+constexpr uint32 rate = 48000;
+
+std::vector<audio::eq_band> make_bands()
+{
+    return {
+        {audio::eq_band_type::low_shelf,  100.f,  4.f, .707f},
+        {audio::eq_band_type::peaking,    250.f, -3.f, 1.41f},
+        {audio::eq_band_type::peaking,   1000.f,  6.f, 1.41f},
+        {audio::eq_band_type::peaking,   4000.f, -2.f, 2.f},
+        {audio::eq_band_type::high_shelf, 8000.f,  3.f, .707f},
+    };
+}
+
+// Filters the same noise on every channel of a `channels` stream.
+std::vector<float> run(uint32 const channels, std::size_t const frames)
+{
+    auto const bands = make_bands();
+    audio::equalizer_kernel eq;
+    eq.calibrate(rate, channels);
+    eq.set_bands(bands.data(), bands.size());
+
+    std::vector<float> buf(frames * channels);
+    for (auto const t : xrange(frames)) {
+        auto const x = static_cast<float>((t * 7919) % 211) / 105.f - 1.f;
+        for (auto const c : xrange(channels)) {
+            buf[t * channels + c] = x;
+        }
+    }
+
+    // Odd packet sizes, so that blocks do not line up with packets.
+    for (auto i = 0_sz; i < frames; i += 301) {
+        eq.process(&buf[i * channels], std::min(frames - i, 301_sz));
+    }
+    return buf;
+}
+
+}     // namespace <unnamed>
+
+
+TEST(audio_equalizer, flat_is_bypassed)
+{
+    audio::eq_band bands[] {
+        {audio::eq_band_type::peaking,   1000.f, 0.f, 1.41f},
+        {audio::eq_band_type::low_shelf,  100.f, 0.f, .707f},
+    };
+
+    audio::equalizer_kernel eq;
+    eq.calibrate(rate, 2);
+    eq.set_bands(bands, 2);
+    ASSERT_EQ(eq.active_bands(), 0);
+
+    float buf[] { .25f, -.5f, .75f, -1.f };
+    eq.process(buf, 2);
+    ASSERT_FLOAT_EQ(buf[0], .25f);
+    ASSERT_FLOAT_EQ(buf[3], -1.f);
+}
+
+TEST(audio_equalizer, peaking_gain)
+{
+    // +6 dB at the centre frequency, once the filter has settled.
+    audio::eq_band band{audio::eq_band_type::peaking, 1000.f, 6.f, 1.41f};
+    audio::equalizer_kernel eq;
+    eq.calibrate(rate, 1);
+    eq.set_bands(&band, 1);
+
+    auto const frames = 48000_sz;
+    std::vector<float> buf(frames);
+    for (auto const t : xrange(frames)) {
+        buf[t] = std::sin(2.f * pi<float> * 1000.f * static_cast<float>(t)
+                          / static_cast<float>(rate)) * .25f;
+    }
+    eq.process(buf.data(), frames);
+
+    auto peak = 0.f;
+    for (auto const t : xrange(frames / 2, frames)) {
+        peak = std::max(peak, std::abs(buf[t]));
+    }
+    ASSERT_NEAR(peak, .25f * std::pow(10.f, 6.f / 20.f), 1e-3f);
+}
+
+TEST(audio_equalizer, channels_agree)
+{
+    // Every vector width and padding must give the mono result on every
+    // channel.
+    auto const frames = 2000_sz;
+    auto const mono = run(1, frames);
+
+    for (auto const channels : {2u, 3u, 6u, 8u, 11u}) {
+        auto const y = run(channels, frames);
+        for (auto const t : xrange(frames)) {
+            for (auto const c : xrange(channels)) {
+                ASSERT_FLOAT_EQ(y[t * channels + c], mono[t])
+                    << channels << " channels, frame " << t;
+            }
+        }
+    }
+}
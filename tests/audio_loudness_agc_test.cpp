@@ -0,0 +1,131 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// tests/audio_loudness_agc_test.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/format.hpp>
+#include <amp/numeric.hpp>
+#include <amp/range.hpp>
+#include <amp/stddef.hpp>
+
+#include "filter/loudness_agc.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+
+using namespace ::amp;
+
+
+namespace {
+
+constexpr uint32 rate = 48000;
+
+// A stereo 1 kHz tone of `amplitude` dBFS.
+std::vector<float> tone(double const amplitude, double const seconds)
+{
+    auto const frames = static_cast<std::size_t>(rate * seconds);
+    auto const gain = std::pow(10., amplitude / 20.);
+
+    std::vector<float> x(frames * 2);
+    for (auto const t : xrange(frames)) {
+        auto const w = 2. * pi<double> * 1000. * static_cast<double>(t) / rate;
+        x[t * 2 + 0] = x[t * 2 + 1] = static_cast<float>(gain * std::sin(w));
+    }
+    return x;
+}
+
+void run(audio::loudness_agc_kernel& agc, std::vector<float>& x,
+         std::size_t const packet_frames = 1024)
+{
+    auto const frames = x.size() / 2;
+    for (auto i = 0_sz; i < frames; i += packet_frames) {
+        agc.process(&x[i * 2], std::min(frames - i, packet_frames));
+    }
+}
+
+audio::loudness_agc_kernel make_agc()
+{
+    audio::loudness_agc_kernel agc;
+    agc.calibrate(rate, 2, audio::channel_layout_stereo);
+    return agc;
+}
+
+}     // namespace <unnamed>
+
+
+TEST(audio_loudness_agc, latency)
+{
+    auto agc = make_agc();
+    ASSERT_EQ(agc.latency(), 2 * rate / 200);
+
+    std::vector<float> x(4096 * 2, 0.f);
+    x[0] = x[1] = .25f;
+    run(agc, x, 333);
+
+    auto const first = std::find_if(x.begin(), x.end(), [](auto s) {
+        return s != 0.f;
+    });
+    ASSERT_EQ(std::size_t(first - x.begin()), agc.latency() * 2);
+}
+
+TEST(audio_loudness_agc, levels_to_reference)
+{
+    // A stereo tone of -28 dBFS reads -28 LUFS, and is raised by 10 dB.
+    auto agc = make_agc();
+    auto x = tone(-28., 30.);
+    run(agc, x);
+    ASSERT_NEAR(agc.gain(), 10.f, .2f);
+
+    // Loud sources are turned down, and quickly.
+    auto y = tone(-6., 5.);
+    run(agc, y);
+    ASSERT_NEAR(agc.gain(), -12.f, .2f);
+}
+
+TEST(audio_loudness_agc, limits_sudden_peaks)
+{
+    auto agc = make_agc();
+    auto x = tone(-40., 20.);
+    auto const loud = tone(0., 2.);
+    x.insert(x.end(), loud.begin(), loud.end());
+    run(agc, x);
+
+    // The boost for the quiet part is still in place when the loud one
+    // comes in; the limiter must catch it.
+    auto const peak = std::abs(*std::max_element(
+        x.begin(), x.end(), [](auto a, auto b) {
+            return std::abs(a) < std::abs(b);
+        }));
+    ASSERT_LE(peak, .8913f);
+    ASSERT_GT(peak, .8f);
+}
+
+TEST(audio_loudness_agc, holds_through_silence)
+{
+    auto agc = make_agc();
+    auto x = tone(-24., 20.);
+    run(agc, x);
+    auto const gain = agc.gain();
+
+    std::vector<float> silence(rate * 2 * 10, 0.f);
+    run(agc, silence);
+    ASSERT_NEAR(agc.gain(), gain, .1f);
+}
+
+TEST(audio_loudness_agc, packet_size_independent)
+{
+    auto a = make_agc();
+    auto b = make_agc();
+    auto x = tone(-30., 3.);
+    auto y = x;
+    run(a, x, 4096);
+    run(b, y, 77);
+    ASSERT_EQ(x, y);
+}
@@ -0,0 +1,193 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// tests/audio_loudness_scanner_test.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/format.hpp>
+#include <amp/audio/input.hpp>
+#include <amp/audio/packet.hpp>
+#include <amp/media/image.hpp>
+#include <amp/media/tags.hpp>
+#include <amp/numeric.hpp>
+#include <amp/range.hpp>
+#include <amp/ref_ptr.hpp>
+#include <amp/stddef.hpp>
+#include <amp/u8string.hpp>
+
+#include "audio/loudness_scanner.hpp"
+#include "media/track.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+
+using namespace ::amp;
+
+
+namespace {
+
+constexpr uint32 tone_rate = 48000;
+
+// Five seconds of a stereo 1 kHz tone, `level` dBFS on both channels.
+class tone_input final :
+    public implement_ref_count<tone_input, audio::input>
+{
+public:
+    explicit tone_input(double const level) noexcept :
+        gain_{std::pow(10., level / 20.)}
+    {}
+
+    void read(audio::packet& pkt) override
+    {
+        auto const n = std::min(uint64{4096}, tone_rate * uint64{5} - pos_);
+        pkt.resize(static_cast<std::size_t>(n) * 2);
+        for (auto const t : xrange(static_cast<std::size_t>(n))) {
+            auto const w = 2. * pi<double> * 1000.
+                         * static_cast<double>(pos_ + t) / tone_rate;
+            pkt[t * 2 + 0] = static_cast<float>(gain_ * std::sin(w));
+            pkt[t * 2 + 1] = static_cast<float>(gain_ * std::sin(w));
+        }
+        pos_ += n;
+    }
+
+    void seek(uint64 const pos) override
+    { pos_ = pos; }
+
+    audio::format get_format() override
+    {
+        audio::format fmt{};
+        fmt.sample_rate = tone_rate;
+        fmt.channels = 2;
+        fmt.channel_layout = audio::channel_layout_stereo;
+        return fmt;
+    }
+
+    audio::stream_info get_info(uint32) override
+    { return audio::stream_info{get_format()}; }
+
+    media::image get_image(media::image::type) override
+    { return media::image{}; }
+
+    uint32 get_chapter_count() override
+    { return 0; }
+
+private:
+    double const gain_;
+    uint64 pos_{};
+};
+
+// The level of a track's tone is in its title; a track without one cannot
+// be decoded.
+ref_ptr<audio::input> open_tone(media::track const& t)
+{
+    auto const title = t.tags.find(tags::title);
+    if (title == t.tags.end()) {
+        throw std::runtime_error("no tone");
+    }
+    return tone_input::make(std::strtod(title->second.c_str(), nullptr));
+}
+
+media::track_handle make_track(char const* const level,
+                               char const* const album,
+                               char const* const album_artist)
+{
+    media::track t;
+    t.location = net::uri::from_string("file:///tone.wav");
+    t.frames = tone_rate * uint64{5};
+    t.sample_rate = tone_rate;
+    if (level) {
+        t.tags.emplace(tags::title, level);
+    }
+    if (album) {
+        t.tags.emplace(tags::album, album);
+        t.tags.emplace(tags::album_artist, album_artist);
+    }
+    return media::track_handle{std::move(t)};
+}
+
+double find_gain(media::track_handle const& t, std::string_view const key)
+{
+    auto const pos = t->info.find(key);
+    if (pos == t->info.end()) {
+        return NAN;
+    }
+    return std::strtod(pos->second.c_str(), nullptr);
+}
+
+}     // namespace <unnamed>
+
+
+TEST(audio_loudness_scanner, albums)
+{
+    std::vector<media::track_handle> tracks{
+        make_track("-23", "Album", "Artist"),
+        make_track("-20", "Album", "Artist"),
+        make_track("-23", "Album", "Other Artist"),
+        make_track("-18", nullptr, nullptr),
+    };
+
+    audio::loudness_scanner scanner{&open_tone};
+    auto const results = scanner.run(tracks, 2);
+    ASSERT_EQ(results.size(), tracks.size());
+    ASSERT_EQ(scanner.progress(), tracks.size());
+    ASSERT_TRUE(scanner.errors().empty());
+
+    for (auto const i : xrange(tracks.size())) {
+        auto const& r = results[i];
+        ASSERT_TRUE(r.measured()) << i;
+        ASSERT_NEAR(r.track_loudness, std::strtod(
+            tracks[i]->tags.find(tags::title)->second.c_str(), nullptr), .1);
+    }
+
+    // The first two tracks are one album, of equal durations: the mean of
+    // -23 and -20 LUFS, in energy. The third is alone in its album, and the
+    // last has none.
+    auto const album = 10. * std::log10((std::pow(10., -2.3)
+                                       + std::pow(10., -2.)) / 2.);
+    ASSERT_NEAR(results[0].album_loudness, album, .1);
+    ASSERT_NEAR(results[1].album_loudness, album, .1);
+    ASSERT_NEAR(results[0].album_peak, results[1].track_peak, 1e-6f);
+    ASSERT_NEAR(results[2].album_loudness, -23., .1);
+    ASSERT_LT(results[3].album_peak, 0.f);
+
+    for (auto const i : xrange(tracks.size())) {
+        tracks[i] = results[i].apply(tracks[i]);
+    }
+    ASSERT_NEAR(find_gain(tracks[0], tags::rg_track_gain), 5., .1);
+    ASSERT_NEAR(find_gain(tracks[0], tags::rg_track_peak),
+                std::pow(10., -23. / 20.), .005);
+    ASSERT_NEAR(find_gain(tracks[1], tags::rg_album_gain), -18. - album, .1);
+    ASSERT_NEAR(find_gain(tracks[1], tags::rg_album_peak), .1, .005);
+    ASSERT_NEAR(find_gain(tracks[3], tags::rg_track_gain), 0., .1);
+    ASSERT_EQ(tracks[3]->info.count(tags::rg_album_gain), 0);
+}
+
+TEST(audio_loudness_scanner, failed_track_voids_album)
+{
+    std::vector<media::track_handle> const tracks{
+        make_track("-23", "Album", "Artist"),
+        make_track(nullptr, "Album", "Artist"),
+    };
+
+    audio::loudness_scanner scanner{&open_tone};
+    auto const results = scanner.run(tracks);
+    ASSERT_EQ(scanner.errors().size(), 1);
+
+    ASSERT_TRUE(results[0].measured());
+    ASSERT_LT(results[0].album_peak, 0.f);
+    ASSERT_FALSE(results[1].measured());
+
+    // Only what was measured is stored; a failed track is left as it was.
+    auto const first = results[0].apply(tracks[0]);
+    ASSERT_EQ(first->info.count(tags::rg_track_gain), 1);
+    ASSERT_EQ(first->info.count(tags::rg_album_gain), 0);
+    ASSERT_EQ(results[1].apply(tracks[1]).get(), tracks[1].get());
+}
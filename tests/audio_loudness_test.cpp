@@ -0,0 +1,165 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// tests/audio_loudness_test.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/format.hpp>
+#include <amp/numeric.hpp>
+#include <amp/range.hpp>
+#include <amp/stddef.hpp>
+
+#include "audio/loudness.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+
+using namespace ::amp;
+
+
+namespace {
+
+// A tone of `amplitude` dBFS on every channel.
+std::vector<float> tone(uint32 const rate, uint32 const channels,
+                        double const freq, double const amplitude,
+                        double const seconds, double const phase = 0.)
+{
+    auto const frames = static_cast<std::size_t>(rate * seconds);
+    auto const gain = std::pow(10., amplitude / 20.);
+
+    std::vector<float> x(frames * channels);
+    for (auto const t : xrange(frames)) {
+        auto const w = 2. * pi<double> * freq * static_cast<double>(t) / rate;
+        auto const y = static_cast<float>(gain * std::sin(w + phase));
+        for (auto const c : xrange(channels)) {
+            x[t * channels + c] = y;
+        }
+    }
+    return x;
+}
+
+// Feeds the meter in uneven packets, as a decoder would.
+void measure(audio::loudness_meter& meter, std::vector<float> const& x,
+             uint32 const channels)
+{
+    auto const frames = x.size() / channels;
+    for (auto i = 0_sz; i < frames; ) {
+        auto const n = std::min(frames - i, 1000 + (i % 3) * 777);
+        meter.process(&x[i * channels], n);
+        i += n;
+    }
+}
+
+}     // namespace <unnamed>
+
+
+TEST(audio_loudness, calibration)
+{
+    // EBU Tech 3341, case 1: a stereo 1 kHz tone at -23 dBFS reads -23 LUFS.
+    audio::format fmt{};
+    fmt.channels = 2;
+    fmt.channel_layout = audio::channel_layout_stereo;
+
+    for (auto const rate : {44100u, 48000u, 96000u}) {
+        fmt.sample_rate = rate;
+        audio::loudness_meter meter{fmt};
+        measure(meter, tone(rate, 2, 1000., -23., 20.), 2);
+        ASSERT_NEAR(meter.integrated(), -23., .1) << rate;
+    }
+}
+
+TEST(audio_loudness, channel_weights)
+{
+    // Five full-range channels of -23 dBFS, two of them surrounds, against
+    // the two of the stereo reference; the LFE channel is ignored.
+    audio::format fmt{};
+    fmt.sample_rate = 48000;
+    fmt.channels = 6;
+    fmt.channel_layout = audio::channel_layout_5_1;
+
+    audio::loudness_meter meter{fmt};
+    measure(meter, tone(48000, 6, 1000., -23., 10.), 6);
+
+    auto const expected = -23. + 10. * std::log10((3. + 2. * 1.41) / 2.);
+    ASSERT_NEAR(meter.integrated(), expected, .1);
+}
+
+TEST(audio_loudness, gating)
+{
+    // EBU Tech 3341, case 3: silence between two tones does not count.
+    auto x = tone(48000, 2, 1000., -36., 10.);
+    x.resize(x.size() + 48000 * 2 * 60, 0.f);
+    auto const loud = tone(48000, 2, 1000., -23., 60.);
+    x.insert(x.end(), loud.begin(), loud.end());
+
+    audio::format fmt{};
+    fmt.sample_rate = 48000;
+    fmt.channels = 2;
+    fmt.channel_layout = audio::channel_layout_stereo;
+
+    audio::loudness_meter meter{fmt};
+    measure(meter, x, 2);
+    ASSERT_NEAR(meter.integrated(), -23., .1);
+
+    audio::loudness_meter quiet{fmt};
+    measure(quiet, std::vector<float>(48000 * 2 * 5, 0.f), 2);
+    ASSERT_TRUE(quiet.histogram().empty());
+    ASSERT_TRUE(std::isinf(quiet.integrated()));
+}
+
+TEST(audio_loudness, album_merge)
+{
+    audio::format stereo{};
+    stereo.sample_rate = 48000;
+    stereo.channels = 2;
+    stereo.channel_layout = audio::channel_layout_stereo;
+
+    audio::format mono{};
+    mono.sample_rate = 44100;
+    mono.channels = 1;
+    mono.channel_layout = audio::channel_layout_mono;
+
+    audio::loudness_meter a{stereo};
+    audio::loudness_meter b{mono};
+    measure(a, tone(48000, 2, 1000., -20., 10.), 2);
+    measure(b, tone(44100, 1, 1000., -20., 10.), 1);
+
+    audio::loudness_histogram album;
+    album.merge(a.histogram());
+    album.merge(b.histogram());
+
+    // Equal durations: the mean of -20 and -23 LUFS, in energy.
+    auto const expected = 10. * std::log10((std::pow(10., -2.)
+                                          + std::pow(10., -2.3)) / 2.);
+    ASSERT_NEAR(album.integrated(), expected, .1);
+}
+
+TEST(audio_loudness, true_peak)
+{
+    // EBU Tech 3341, case 15: at fs/4 and 45 degrees, every sample misses
+    // the crest by 3 dB.
+    audio::format fmt{};
+    fmt.sample_rate = 48000;
+    fmt.channels = 2;
+    fmt.channel_layout = audio::channel_layout_stereo;
+
+    auto const x = tone(48000, 2, 12000., 0., 1., pi<double> / 4.);
+    audio::loudness_meter meter{fmt};
+    measure(meter, x, 2);
+
+    ASSERT_NEAR(20. * std::log10(meter.true_peak()), 0., .2);
+
+    // A sample peak is found as is.
+    fmt.channels = 1;
+    fmt.channel_layout = audio::channel_layout_mono;
+    audio::loudness_meter sample{fmt};
+    std::vector<float> impulse(4800, 0.f);
+    impulse[1234] = -.5f;
+    sample.process(impulse.data(), impulse.size());
+    ASSERT_NEAR(sample.true_peak(), .5f, 1e-6f);
+}
@@ -0,0 +1,169 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// tests/audio_output_stage_test.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/format.hpp>
+#include <amp/range.hpp>
+#include <amp/stddef.hpp>
+
+#include "audio/output_stage.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+
+using namespace ::amp;
+
+
+namespace {
+
+audio::output_stage_policy make_policy(audio::limiter_mode const limiter,
+                                       uint8 const dither_bits = 0,
+                                       int const ramp_ms = 0)
+{
+    audio::output_stage_policy policy;
+    policy.limiter = limiter;
+    policy.dither_bits = dither_bits;
+    policy.volume_ramp = std::chrono::milliseconds{ramp_ms};
+    return policy;
+}
+
+}     // namespace <unnamed>
+
+
+TEST(audio_output_stage, scale)
+{
+    // Odd lengths exercise the scalar tails of the vectorized kernels.
+    std::vector<float> src(37), dst(37);
+    for (auto const i : xrange(src.size())) {
+        src[i] = static_cast<float>(i) / 8;
+    }
+
+    audio::output_stage::scale(0.5f, src.data(), dst.data(), dst.size());
+    for (auto const i : xrange(dst.size())) {
+        ASSERT_FLOAT_EQ(dst[i], src[i] * 0.5f);
+    }
+
+    // Unlike the output stage, scaling does not clip.
+    audio::output_stage::scale(2.f, dst.data(), dst.data(), dst.size());
+    for (auto const i : xrange(dst.size())) {
+        ASSERT_FLOAT_EQ(dst[i], src[i]);
+    }
+}
+
+TEST(audio_output_stage, clip)
+{
+    audio::format fmt{};
+    fmt.sample_rate = 1000;
+    fmt.channels = 1;
+    audio::output_stage stage{fmt,
+                              make_policy(audio::limiter_mode::clip)};
+
+    std::vector<float> x(19);
+    for (auto const i : xrange(x.size())) {
+        x[i] = (static_cast<float>(i) - 9) / 4;
+    }
+    auto const src = x;
+
+    stage.process(x.data(), x.data(), x.size());
+    for (auto const i : xrange(x.size())) {
+        ASSERT_FLOAT_EQ(x[i], std::fmin(std::fmax(src[i], -1.f), 1.f));
+    }
+}
+
+TEST(audio_output_stage, soft_limit)
+{
+    audio::format fmt{};
+    fmt.sample_rate = 1000;
+    fmt.channels = 1;
+    audio::output_stage stage{fmt,
+                              make_policy(audio::limiter_mode::soft)};
+
+    float const src[] = {
+        0.f, 0.5f, -0.5f, 0.89f, -0.89f, 0.95f, -1.f, 1.f, 4.f, -100.f,
+    };
+    float dst[std::size(src)];
+    stage.process(src, dst, std::size(src));
+
+    // Linear below the knee, strictly below full scale above it, and
+    // monotonic throughout.
+    for (auto const i : xrange(5)) {
+        ASSERT_FLOAT_EQ(dst[i], src[i]);
+    }
+    for (auto const i : xrange(5_sz, std::size(src))) {
+        ASSERT_LT(std::fabs(dst[i]), 1.f);
+        ASSERT_LT(std::fabs(dst[i]), std::fabs(src[i]));
+        ASSERT_EQ(std::signbit(dst[i]), std::signbit(src[i]));
+    }
+    ASSERT_LT(dst[7], dst[8]);
+    ASSERT_FLOAT_EQ(dst[6], -dst[7]);
+}
+
+TEST(audio_output_stage, volume_ramp)
+{
+    // 10 ms at 1 kHz stereo is 20 samples.
+    audio::format fmt{};
+    fmt.sample_rate = 1000;
+    fmt.channels = 2;
+    audio::output_stage stage{fmt,
+                              make_policy(audio::limiter_mode::clip, 0, 10)};
+    ASSERT_FLOAT_EQ(stage.volume(), 1.f);
+
+    stage.set_volume(0.5f);
+    std::vector<float> x(13, 1.f);
+    stage.process(x.data(), x.data(), x.size());
+
+    // The ramp starts at the current volume, and falls by the same step
+    // from one sample to the next.
+    ASSERT_FLOAT_EQ(x[0], 1.f);
+    for (auto const i : xrange(1_sz, x.size())) {
+        ASSERT_NEAR(x[i - 1] - x[i], 0.5f / 20, 1e-5f);
+    }
+    ASSERT_GT(stage.volume(), 0.5f);
+
+    x.assign(29, 1.f);
+    stage.process(x.data(), x.data(), x.size());
+    ASSERT_FLOAT_EQ(stage.volume(), 0.5f);
+    for (auto const i : xrange(7_sz, x.size())) {
+        ASSERT_FLOAT_EQ(x[i], 0.5f);
+    }
+
+    // Setting the current target again does not restart the ramp.
+    stage.set_volume(0.5f);
+    x.assign(8, 1.f);
+    stage.process(x.data(), x.data(), x.size());
+    for (auto const y : x) {
+        ASSERT_FLOAT_EQ(y, 0.5f);
+    }
+}
+
+TEST(audio_output_stage, dither)
+{
+    audio::format fmt{};
+    fmt.sample_rate = 1000;
+    fmt.channels = 1;
+    audio::output_stage stage{fmt,
+                              make_policy(audio::limiter_mode::clip, 16)};
+
+    std::vector<float> x(4099, 0.25f);
+    stage.process(x.data(), x.data(), x.size());
+
+    // Triangular noise of at most one LSB either way, centered on the input.
+    auto const lsb = std::ldexp(1.f, -15);
+    auto sum = 0.;
+    auto nonzero = 0;
+    for (auto const y : x) {
+        auto const d = y - 0.25f;
+        ASSERT_LE(std::fabs(d), lsb);
+        sum += d;
+        nonzero += (d != 0.f);
+    }
+    ASSERT_GT(nonzero, 4000);
+    ASSERT_LT(std::fabs(sum / x.size()), lsb / 16);
+}
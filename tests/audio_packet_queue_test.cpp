@@ -0,0 +1,111 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// tests/audio_packet_queue_test.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/packet.hpp>
+#include <amp/range.hpp>
+
+#include "audio/packet_queue.hpp"
+
+#include <cstddef>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+
+using namespace ::amp;
+
+
+TEST(audio_packet_queue, slot_limit)
+{
+    audio::packet_queue q{3};
+    ASSERT_EQ(q.capacity(), 4);
+    ASSERT_EQ(q.read_acquire(), nullptr);
+
+    for (auto const i : xrange(4)) {
+        auto const slot = q.write_prepare(-1_sz);
+        ASSERT_NE(slot, nullptr);
+        slot->pkt.resize(16);
+        slot->position = static_cast<uint64>(i);
+        q.write_commit();
+    }
+    ASSERT_EQ(q.write_prepare(-1_sz), nullptr);
+    ASSERT_EQ(q.samples(), 64);
+
+    for (auto const i : xrange(4)) {
+        auto const slot = q.read_acquire();
+        ASSERT_NE(slot, nullptr);
+        ASSERT_EQ(slot->position, static_cast<uint64>(i));
+        q.read_release();
+    }
+    ASSERT_EQ(q.read_acquire(), nullptr);
+    ASSERT_EQ(q.samples(), 0);
+}
+
+TEST(audio_packet_queue, sample_limit)
+{
+    audio::packet_queue q{16};
+
+    // The first packet is always accepted, however large it is.
+    auto slot = q.write_prepare(8);
+    ASSERT_NE(slot, nullptr);
+    slot->pkt.resize(100);
+    q.write_commit();
+
+    ASSERT_EQ(q.write_prepare(8), nullptr);
+    ASSERT_NE(q.write_prepare(101), nullptr);
+
+    q.read_acquire();
+    q.read_release();
+
+    slot = q.write_prepare(8);
+    ASSERT_NE(slot, nullptr);
+    slot->pkt.resize(4);
+    q.write_commit();
+
+    slot = q.write_prepare(8);
+    ASSERT_NE(slot, nullptr);
+    slot->pkt.resize(4);
+    q.write_commit();
+
+    ASSERT_EQ(q.write_prepare(8), nullptr);
+    ASSERT_EQ(q.samples(), 8);
+}
+
+TEST(audio_packet_queue, producer_consumer)
+{
+    constexpr auto count = uint64{100000};
+    audio::packet_queue q{8};
+
+    std::thread producer{[&]{
+        for (auto i = uint64{}; i != count; ) {
+            if (auto const slot = q.write_prepare(-1_sz)) {
+                slot->pkt.resize(1);
+                slot->position = i++;
+                q.write_commit();
+            }
+            else {
+                std::this_thread::yield();
+            }
+        }
+    }};
+
+    // The producer must be joined before anything is asserted, or a failure
+    // would leave it joinable and terminate the test run.
+    auto out_of_order = uint64{};
+    for (auto i = uint64{}; i != count; ) {
+        if (auto const slot = q.read_acquire()) {
+            out_of_order += (slot->position != i++);
+            q.read_release();
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    ASSERT_EQ(out_of_order, 0);
+    ASSERT_EQ(q.samples(), 0);
+}
@@ -0,0 +1,109 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// tests/audio_playback_stats_test.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include "audio/playback_stats.hpp"
+
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+
+using namespace ::amp;
+using namespace std::chrono_literals;
+
+
+TEST(audio_playback_stats, underruns)
+{
+    audio::playback_monitor m;
+    m.reset(1024);
+
+    // Starting with an empty ring is not an underrun.
+    m.record_callback(0, 256, 1ms);
+    m.record_callback(512, 256, 1ms);
+    m.record_callback(100, 256, 1ms);
+    m.record_callback(0, 256, 1ms);
+    m.record_callback(0, 256, 1ms);
+
+    auto const x = m.snapshot();
+    ASSERT_EQ(x.callbacks, 5);
+    ASSERT_EQ(x.underruns, 2);
+    ASSERT_EQ(x.lost_samples, 156 + 256);
+
+    m.restart();
+    m.record_callback(0, 256, 1ms);
+    ASSERT_EQ(m.snapshot().underruns, 2);
+}
+
+TEST(audio_playback_stats, ring_fill)
+{
+    audio::playback_monitor m;
+    m.reset(800);
+
+    auto x = m.snapshot();
+    ASSERT_EQ(x.ring_capacity, 800);
+    ASSERT_EQ(x.ring_fill_min, 0);
+    ASSERT_EQ(x.ring_fill_avg, 0);
+    ASSERT_EQ(x.ring_fill_max, 0);
+
+    m.record_callback(100, 1, 1ms);
+    m.record_callback(300, 1, 1ms);
+    m.record_callback(800, 1, 1ms);
+
+    x = m.snapshot();
+    ASSERT_EQ(x.ring_fill_min, 100);
+    ASSERT_EQ(x.ring_fill_avg, 400);
+    ASSERT_EQ(x.ring_fill_max, 800);
+    ASSERT_EQ(x.ring_fill_histogram[1], 1);
+    ASSERT_EQ(x.ring_fill_histogram[3], 1);
+    ASSERT_EQ(x.ring_fill_histogram[audio::ring_fill_buckets - 1], 1);
+}
+
+TEST(audio_playback_stats, receive_packet)
+{
+    audio::playback_monitor m;
+    m.reset(1);
+    m.record_receive_packet(10us);
+    m.record_receive_packet(30us);
+
+    auto const x = m.snapshot();
+    ASSERT_EQ(x.packets, 2);
+    ASSERT_EQ(x.receive_packet_avg, 20us);
+    ASSERT_EQ(x.receive_packet_max, 30us);
+    ASSERT_EQ(x.callback_jitter_max, 0ns);
+}
+
+TEST(audio_playback_stats, wakeups)
+{
+    audio::playback_monitor m;
+    m.reset(1);
+    ASSERT_EQ(m.snapshot().wakeups, 0);
+
+    m.record_wakeup();
+    m.record_wakeup();
+
+    auto const x = m.snapshot();
+    ASSERT_EQ(x.wakeups, 2);
+    ASSERT_GE(x.wakeups_per_second, 0.);
+}
+
+TEST(audio_playback_stats, seek_latency)
+{
+    audio::playback_monitor m;
+    m.reset(1);
+    m.record_seek(2ms);
+    m.record_seek(6ms);
+
+    auto x = m.snapshot();
+    ASSERT_EQ(x.seeks, 2);
+    ASSERT_EQ(x.seek_latency_avg, 4ms);
+    ASSERT_EQ(x.seek_latency_max, 6ms);
+
+    m.reset(1);
+    x = m.snapshot();
+    ASSERT_EQ(x.seeks, 0);
+    ASSERT_EQ(x.seek_latency_avg, 0ns);
+}
@@ -0,0 +1,144 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// tests/audio_resampler_test.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/filter.hpp>
+#include <amp/audio/format.hpp>
+#include <amp/audio/packet.hpp>
+#include <amp/numeric.hpp>
+#include <amp/range.hpp>
+#include <amp/stddef.hpp>
+
+#include "audio/resampler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+
+using namespace ::amp;
+
+
+namespace {
+
+double tone(double const freq, double const rate, double const t)
+{
+    return std::sin(2. * pi<double> * freq * t / rate) * .5;
+}
+
+// Resamples a stereo tone in packets of `packet_frames`, and returns the
+// worst error against the ideal tone at the output rate, once the filter
+// has filled.
+double resample_error(uint32 const irate, uint32 const orate,
+                      uint8 const quality, double const freq,
+                      std::size_t const packet_frames)
+{
+    audio::polyphase_resampler rs;
+    rs.set_sample_rate(orate);
+    rs.set_quality(quality);
+
+    audio::format fmt{};
+    fmt.sample_rate = irate;
+    fmt.channels = 2;
+    fmt.channel_layout = audio::channel_layout_stereo;
+    rs.calibrate(fmt);
+    EXPECT_EQ(fmt.sample_rate, orate);
+
+    auto const frames = std::size_t{irate} / 2;
+    std::vector<float> out;
+    audio::packet pkt;
+
+    for (auto i = 0_sz; i < frames; i += packet_frames) {
+        auto const n = std::min(packet_frames, frames - i);
+        pkt.set_channel_layout(audio::channel_layout_stereo, 2);
+        pkt.resize(n * 2);
+        for (auto const t : xrange(n)) {
+            auto const x = static_cast<float>(tone(freq, irate, double(i + t)));
+            pkt[t * 2 + 0] = x;
+            pkt[t * 2 + 1] = -x;
+        }
+        rs.process(pkt);
+        out.insert(out.end(), pkt.begin(), pkt.end());
+    }
+
+    auto const latency = static_cast<double>(rs.taps()) / 2.
+                       * orate / irate;
+    auto const first = static_cast<std::size_t>(latency) * 2;
+    auto const last = out.size() / 2;
+
+    auto error = 0.;
+    for (auto const t : xrange(first, last)) {
+        auto const x = tone(freq, orate, double(t) - latency);
+        error = std::max(error, std::abs(out[t * 2 + 0] - x));
+        error = std::max(error, std::abs(out[t * 2 + 1] + x));
+    }
+    return error;
+}
+
+}     // namespace <unnamed>
+
+
+TEST(audio_resampler, upsample)
+{
+    // -100 dB stop band, relative to a -6 dBFS tone.
+    ASSERT_LT(resample_error(44100, 48000, audio::quality_medium,
+                             1000., 4096), 1e-4);
+    ASSERT_LT(resample_error(44100, 96000, audio::quality_high,
+                             10000., 4096), 1e-4);
+}
+
+TEST(audio_resampler, downsample)
+{
+    ASSERT_LT(resample_error(48000, 44100, audio::quality_medium,
+                             1000., 4096), 1e-4);
+    ASSERT_LT(resample_error(192000, 48000, audio::quality_medium,
+                             5000., 4096), 1e-4);
+}
+
+TEST(audio_resampler, interpolated_branches)
+{
+    // 48001 / 44100 cannot be tabulated exactly.
+    ASSERT_LT(resample_error(44100, 48001, audio::quality_medium,
+                             1000., 4096), 1e-3);
+}
+
+TEST(audio_resampler, packet_size_independent)
+{
+    ASSERT_LT(resample_error(44100, 48000, audio::quality_low,
+                             1000., 37), 1e-3);
+    ASSERT_LT(resample_error(44100, 48000, audio::quality_low,
+                             1000., 10000), 1e-3);
+}
+
+TEST(audio_resampler, length_and_drain)
+{
+    audio::polyphase_resampler rs;
+    rs.set_sample_rate(48000);
+    rs.set_quality(audio::quality_minimum);
+
+    audio::format fmt{};
+    fmt.sample_rate = 44100;
+    fmt.channels = 1;
+    fmt.channel_layout = audio::channel_layout_mono;
+    rs.calibrate(fmt);
+
+    audio::packet pkt;
+    pkt.set_channel_layout(audio::channel_layout_mono, 1);
+    pkt.resize(44100);
+    rs.process(pkt);
+    auto total = pkt.frames();
+
+    pkt.clear();
+    rs.drain(pkt);
+    total += pkt.frames();
+
+    // The whole input comes out, delayed by the filter's latency.
+    ASSERT_GE(total, 48000 + rs.get_latency());
+    ASSERT_LE(total, 48000 + rs.get_latency() * 2 + 2);
+}
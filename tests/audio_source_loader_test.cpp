@@ -0,0 +1,109 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// tests/audio_source_loader_test.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/net/uri.hpp>
+#include <amp/range.hpp>
+#include <amp/stddef.hpp>
+
+#include "audio/source_loader.hpp"
+#include "media/track.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+
+using namespace ::amp;
+
+
+namespace {
+
+std::atomic<int> load_delay_us{0};
+
+// Stands in for a source_context: "opening" a track just remembers it.
+struct fake_source
+{
+    void reset() noexcept
+    { track = nullptr; }
+
+    void reset(media::track const& x)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds{
+            load_delay_us.load(std::memory_order_relaxed)});
+        track = &x;
+    }
+
+    void prime()
+    {}
+
+    media::track const* track{};
+};
+
+media::track_handle make_track(char const* const location)
+{
+    media::track x;
+    x.location = net::uri::from_string(location);
+    return media::track_handle{std::move(x)};
+}
+
+bool wait_idle(audio::basic_source_loader<fake_source> const& loader)
+{
+    auto const deadline = std::chrono::steady_clock::now()
+                        + std::chrono::seconds{5};
+    while (!loader.idle()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+}     // namespace <unnamed>
+
+
+TEST(audio_source_loader, abandon_then_reload)
+{
+    auto const a = make_track("file:///a.flac");
+    auto const b = make_track("file:///b.flac");
+
+    // Without a delay, the load is mostly abandoned before the loader
+    // thread gets to it; with one, while it is running.
+    for (auto const delay : {0, 1000}) {
+        load_delay_us.store(delay, std::memory_order_relaxed);
+        audio::basic_source_loader<fake_source> loader;
+
+        for (auto const i : xrange(delay ? 10 : 500)) {
+            fake_source out;
+            loader.request(a);
+            ASSERT_FALSE(loader.take(b, out)) << i;
+            ASSERT_EQ(out.track, nullptr);
+
+            // Once abandoned, a load is not waited for, even by its own
+            // track; the caller opens it instead.
+            ASSERT_FALSE(loader.take(a, out)) << i;
+            ASSERT_TRUE(wait_idle(loader)) << i;
+
+            loader.request(a);
+            ASSERT_TRUE(loader.take(a, out)) << i;
+            ASSERT_EQ(out.track, a.get());
+            ASSERT_TRUE(loader.idle());
+        }
+    }
+}
+
+TEST(audio_source_loader, take_without_request)
+{
+    auto const a = make_track("file:///a.flac");
+    audio::basic_source_loader<fake_source> loader;
+
+    fake_source out;
+    ASSERT_FALSE(loader.take(a, out));
+    ASSERT_TRUE(loader.idle());
+}
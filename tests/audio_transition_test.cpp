@@ -0,0 +1,168 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// tests/audio_transition_test.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/audio/format.hpp>
+#include <amp/audio/packet.hpp>
+#include <amp/range.hpp>
+
+#include "audio/filter_chain.hpp"
+#include "audio/transition.hpp"
+
+#include <cmath>
+#include <memory>
+
+#include <gtest/gtest.h>
+
+
+using namespace ::amp;
+
+
+namespace {
+
+audio::packet make_packet(std::size_t const frames, float const value)
+{
+    audio::packet pkt;
+    pkt.set_channel_layout(audio::channel_layout_stereo, 2);
+    pkt.resize(frames * 2);
+    std::fill(pkt.begin(), pkt.end(), value);
+    return pkt;
+}
+
+audio::transition_policy make_policy(audio::transition_curve const curve)
+{
+    audio::transition_policy policy;
+    policy.curve = curve;
+    return policy;
+}
+
+}     // namespace <unnamed>
+
+
+TEST(audio_transition, leading_silence)
+{
+    auto pkt = make_packet(8, 0.f);
+    ASSERT_EQ(audio::leading_silence(pkt), 8);
+
+    pkt[7] = 0.5f;
+    ASSERT_EQ(audio::leading_silence(pkt), 3);
+
+    pkt[0] = -0.5f;
+    ASSERT_EQ(audio::leading_silence(pkt), 0);
+}
+
+TEST(audio_transition, linear)
+{
+    audio::transition t;
+    ASSERT_FALSE(t.active());
+
+    t.start(make_policy(audio::transition_curve::linear), 37, 1.f,
+            std::make_unique<audio::filter_chain>());
+    ASSERT_TRUE(t.active());
+    ASSERT_TRUE(t.starved(37));
+
+    // Constant amplitude: two identical signals mix to the same level.
+    t.push(make_packet(37, 1.f));
+    ASSERT_FALSE(t.starved(37));
+
+    auto pkt = make_packet(37, 1.f);
+    t.mix(pkt);
+    for (auto const x : pkt) {
+        ASSERT_NEAR(x, 1.f, 1e-6f);
+    }
+    ASSERT_TRUE(t.done());
+    ASSERT_NE(t.finish(), nullptr);
+    ASSERT_FALSE(t.active());
+}
+
+TEST(audio_transition, fade_out)
+{
+    audio::transition t;
+    t.start(make_policy(audio::transition_curve::linear), 4, 0.5f,
+            std::make_unique<audio::filter_chain>());
+    t.push(make_packet(4, 1.f));
+
+    auto pkt = make_packet(4, 0.f);
+    t.mix(pkt);
+    for (auto const i : xrange(4)) {
+        auto const expected = 0.5f * (1.f - i / 4.f);
+        ASSERT_FLOAT_EQ(pkt[i * 2 + 0], expected);
+        ASSERT_FLOAT_EQ(pkt[i * 2 + 1], expected);
+    }
+}
+
+TEST(audio_transition, outgoing_ended)
+{
+    audio::transition t;
+    t.start(make_policy(audio::transition_curve::equal_power), 16, 1.f,
+            std::make_unique<audio::filter_chain>());
+    t.push(make_packet(2, 1.f));
+    t.push(audio::packet{});
+    ASSERT_FALSE(t.starved(8));
+
+    // The incoming track keeps fading in after the outgoing one has ended.
+    auto pkt = make_packet(8, 1.f);
+    t.mix(pkt);
+    ASSERT_FALSE(t.done());
+    for (auto const i : xrange(2, 8)) {
+        auto const expected = std::sin(i / 16.f * 3.14159265f / 2);
+        ASSERT_NEAR(pkt[i * 2], expected, 1e-6f);
+    }
+
+    pkt = make_packet(8, 1.f);
+    t.mix(pkt);
+    ASSERT_TRUE(t.done());
+}
+
+TEST(audio_transition, trailing_silence_gap)
+{
+    // A quiet passage near the end of a track is held back, and played
+    // after all once more audio follows it.
+    audio::trailing_silence trailing;
+    auto pkt = make_packet(4, 1e-4f);
+    trailing.process(pkt, 100);
+    ASSERT_TRUE(pkt.empty());
+    ASSERT_TRUE(trailing.holding());
+
+    pkt = make_packet(6, 0.f);
+    trailing.process(pkt, 100);
+    ASSERT_TRUE(pkt.empty());
+
+    pkt = make_packet(2, 0.5f);
+    trailing.process(pkt, 100);
+    ASSERT_FALSE(trailing.holding());
+    ASSERT_EQ(pkt.frames(), 12);
+    ASSERT_EQ(pkt.channels(), 2);
+    for (auto const i : xrange(pkt.size())) {
+        auto const expected = (i < 8) ? 1e-4f : (i < 20) ? 0.f : 0.5f;
+        ASSERT_FLOAT_EQ(pkt[i], expected) << "at sample " << i;
+    }
+
+    // Audio that is not silent passes as is.
+    pkt = make_packet(3, 0.5f);
+    trailing.process(pkt, 100);
+    ASSERT_EQ(pkt.frames(), 3);
+}
+
+TEST(audio_transition, trailing_silence_end)
+{
+    // Silence that runs to the end of the track is dropped.
+    audio::trailing_silence trailing;
+    auto pkt = make_packet(4, 0.f);
+    trailing.process(pkt, 10);
+    ASSERT_TRUE(pkt.empty());
+    trailing.clear();
+    ASSERT_FALSE(trailing.holding());
+
+    // Longer than the window, it is not trailing silence after all.
+    pkt = make_packet(6, 0.f);
+    trailing.process(pkt, 10);
+    ASSERT_TRUE(pkt.empty());
+    pkt = make_packet(6, 0.f);
+    trailing.process(pkt, 10);
+    ASSERT_EQ(pkt.frames(), 12);
+    ASSERT_FALSE(trailing.holding());
+}
@@ -0,0 +1,68 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// tests/media_track_test.cpp
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <amp/net/uri.hpp>
+#include <amp/stddef.hpp>
+
+#include "media/track.hpp"
+
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+
+using namespace ::amp;
+
+
+namespace {
+
+media::track make_track(uint32 const chapter)
+{
+    media::track x;
+    x.location = net::uri::from_string("file:///music/album.flac");
+    x.tags.emplace("title", "Title");
+    x.chapter = chapter;
+    return x;
+}
+
+}     // namespace <unnamed>
+
+
+TEST(media_track_test, handle_shares_track)
+{
+    media::track_handle x;
+    ASSERT_FALSE(x);
+    ASSERT_EQ(x.get(), nullptr);
+
+    x = media::track_handle{make_track(1)};
+    ASSERT_TRUE(x);
+    ASSERT_EQ(x->chapter, 1);
+    ASSERT_EQ(x->tags.count("title"), 1);
+
+    auto const y = x;
+    ASSERT_EQ(y.get(), x.get());
+
+    std::vector<media::track_handle> v(3, x);
+    auto z = std::move(v[0]);
+    ASSERT_FALSE(v[0]);
+    ASSERT_EQ(z.get(), x.get());
+}
+
+TEST(media_track_test, handle_equality)
+{
+    media::track_handle const x{make_track(1)};
+    media::track_handle const y{make_track(1)};
+    media::track_handle const z{make_track(2)};
+
+    // Handles to equal tracks compare equal, even if not shared.
+    ASSERT_EQ(x, x);
+    ASSERT_EQ(x, y);
+    ASSERT_NE(x, z);
+    ASSERT_NE(x, media::track_handle{});
+    ASSERT_EQ(media::track_handle{}, media::track_handle{});
+}